@@ -247,6 +247,15 @@ void GET_metrics(HTTPServerRequest& req, HTTPServerResponse& res, spectator::Reg
 	}
 	obj->set("timers", timers);
 
+	Poco::JSON::Array::Ptr percentile_histograms = new Poco::JSON::Array(true);
+	for (auto it : registry.PercentileHistograms())
+	{
+		auto meter = fmt_meter_object((spectator::Meter*)it);
+		meter->set("value", fmt::format("{}", it->TotalCount()));
+		percentile_histograms->add(meter);
+	}
+	obj->set("percentile_histograms", percentile_histograms);
+
 	Object::Ptr stats = new Object(true);
 	auto age_gauges_size = registry.AgeGauges().size();
 	auto counters_size = registry.Counters().size();
@@ -256,8 +265,9 @@ void GET_metrics(HTTPServerRequest& req, HTTPServerResponse& res, spectator::Reg
 	auto mono_counters_size = registry.MonotonicCounters().size();
 	auto mono_counters_uint_size = registry.MonotonicCountersUint().size();
 	auto timers_size = registry.Timers().size();
+	auto percentile_histograms_size = registry.PercentileHistograms().size();
 	auto total = age_gauges_size + counters_size + dist_summaries_size + gauges_size + max_gauges_size +
-	             mono_counters_size + mono_counters_uint_size + timers_size;
+	             mono_counters_size + mono_counters_uint_size + timers_size + percentile_histograms_size;
 	stats->set("age_gauges.size", age_gauges_size);
 	stats->set("counters.size", counters_size);
 	stats->set("dist_summaries.size", dist_summaries_size);
@@ -266,6 +276,7 @@ void GET_metrics(HTTPServerRequest& req, HTTPServerResponse& res, spectator::Reg
 	stats->set("mono_counters.size", mono_counters_size);
 	stats->set("mono_counters_uint.size", mono_counters_uint_size);
 	stats->set("timers.size", timers_size);
+	stats->set("percentile_histograms.size", percentile_histograms_size);
 	stats->set("total.size", total);
 	obj->set("stats", stats);
 
@@ -0,0 +1,110 @@
+#include "../spectator/batch_encoder.h"
+#include <asio/post.hpp>
+#include <asio/thread_pool.hpp>
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+// Measure the codecs available to compress publish payloads, on the smile payloads
+// produced by the batch encoder for a batch of timers. Throughput is reported for
+// the uncompressed payload, and includes the cost of encoding it, which is what the
+// identity codec measures on its own.
+//
+// The parallel benchmark compresses a batch of 100k measurements, over 4MB of smile,
+// with its chunks spread over a pool of the given number of threads.
+
+using spectator::BatchEncoder;
+using spectator::Codec;
+using spectator::Id;
+using spectator::MeasurementColumns;
+using spectator::Tags;
+
+static constexpr int kBatchSize = 10000;
+static constexpr int kLargeBatchSize = 100000;
+
+static auto get_ids() -> const std::vector<Id>&
+{
+	static auto* ids = []()
+	{
+		auto* result = new std::vector<Id>();
+		result->reserve(kLargeBatchSize);
+		const char* stats[] = {"count", "totalTime", "totalOfSquares", "max"};
+		for (auto i = 0; i < kLargeBatchSize; ++i)
+		{
+			result->emplace_back(Id::Of(fmt::format("spectatord_test.timer{}", i / 4),
+			                            {{"statistic", stats[i % 4]},
+			                             {"id", fmt::format("{}", i % 100)},
+			                             {"foo", fmt::format("some-foo-{}", i % 10)}}));
+		}
+		return result;
+	}();
+	return *ids;
+}
+
+static auto get_batch(int size) -> MeasurementColumns
+{
+	MeasurementColumns measurements;
+	const auto& ids = get_ids();
+	for (auto i = 0; i < size; ++i)
+	{
+		const auto& id = ids[i];
+		// counts are small integers, while the other statistics rarely repeat
+		auto value = i % 4 == 0 ? static_cast<double>(i % 7) : 1.3 * i;
+		measurements.emplace_back(id, value);
+	}
+	return measurements;
+}
+
+static auto get_common_tags() -> Tags
+{
+	return Tags{{"nf.app", "spectatord"}, {"nf.cluster", "spectatord-test"}, {"nf.node", "i-0123456789"}};
+}
+
+static void bench_compress(benchmark::State& state)
+{
+	auto codec = static_cast<Codec>(state.range(0));
+	auto ms = get_batch(kBatchSize);
+	BatchEncoder identity{get_common_tags(), Codec::Identity};
+	auto raw_size = identity.Encode(ms).size;
+
+	BatchEncoder encoder{get_common_tags(), codec};
+	size_t size = 0;
+	for (auto _ : state)
+	{
+		size = encoder.Encode(ms).size;
+	}
+	state.SetLabel(AbslUnparseFlag(codec));
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * raw_size));
+	state.counters["ratio"] = static_cast<double>(raw_size) / static_cast<double>(size);
+}
+
+static void bench_compress_parallel(benchmark::State& state)
+{
+	auto ms = get_batch(kLargeBatchSize);
+	BatchEncoder identity{get_common_tags(), Codec::Identity};
+	auto raw_size = identity.Encode(ms).size;
+
+	auto threads = static_cast<size_t>(state.range(0));
+	asio::thread_pool pool{threads};
+	spectator::Executor executor;
+	if (threads > 0)
+	{
+		executor = [&pool](std::function<void()> task) { asio::post(pool, std::move(task)); };
+	}
+	BatchEncoder encoder{get_common_tags(), Codec::Gzip, executor};
+	size_t size = 0;
+	for (auto _ : state)
+	{
+		size = encoder.Encode(ms).size;
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * raw_size));
+	state.counters["ratio"] = static_cast<double>(raw_size) / static_cast<double>(size);
+	pool.join();
+}
+
+BENCHMARK(bench_compress)
+    ->Arg(static_cast<int>(Codec::Identity))
+    ->Arg(static_cast<int>(Codec::Gzip))
+    ->Arg(static_cast<int>(Codec::Libdeflate))
+    ->Arg(static_cast<int>(Codec::Zstd));
+BENCHMARK(bench_compress_parallel)->Arg(0)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+BENCHMARK_MAIN();
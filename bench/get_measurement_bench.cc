@@ -248,7 +248,16 @@ static void bench_get_measurement_strview(benchmark::State& state)
 	bench_get_measurement_fun(state, get_measurement_strview);
 }
 
+// the implementation used by spectatord: from_chars and interning tags only for valid lines
+static void bench_get_measurement_from_chars(benchmark::State& state)
+{
+	bench_get_measurement_fun(state,
+	                          [](const spectator::Registry*, const char* measurement_str, std::string* err_msg)
+	                          { return spectatord::get_measurement('c', measurement_str, err_msg); });
+}
+
 BENCHMARK(bench_get_measurement_ptr);
 BENCHMARK(bench_get_measurement_strchr);
 BENCHMARK(bench_get_measurement_strview);
+BENCHMARK(bench_get_measurement_from_chars);
 BENCHMARK_MAIN();
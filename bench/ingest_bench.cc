@@ -0,0 +1,129 @@
+#include "../server/spectatord.h"
+#include "../server/udp_server.h"
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+// Measure how the number of packets/sec spectatord can parse scales with the number of
+// ingest workers, each one with its own SO_REUSEPORT socket and event loop, and with the
+// number of datagrams received per recvmmsg call.
+
+static constexpr int kBenchPort = 21234;
+static constexpr int kSenderThreads = 4;
+static constexpr int kSocketsPerSender = 4;  // more flows lets the kernel spread packets among workers
+static constexpr int kPacketsPerIteration = 100000;
+
+class dummy_server : public spectatord::Server
+{
+   public:
+	explicit dummy_server(spectator::Registry* registry) : spectatord::Server(false, 0, 0, "", registry) {}
+	auto parse_buffer(char* buffer) { return parse(buffer); }
+};
+
+static auto get_packets() -> std::vector<std::string>
+{
+	std::vector<std::string> packets;
+	packets.reserve(100);
+	for (auto i = 0; i < 100; ++i)
+	{
+		packets.emplace_back(fmt::format(
+		    "c:spectatord_test.counter,id={}:1\nt:spectatord_test.timer,id={},foo=some-foo:0.5\n"
+		    "d:spectatord_test.ds,id={},foo=some-foo:42\nT:spectatord_test.percTimer,id={},tag=bar:{}\n",
+		    i, i, i, i % 10, i % 10));
+	}
+	return packets;
+}
+
+static void send_packets(const std::vector<std::string>& packets, int num_packets)
+{
+	using asio::ip::udp;
+	asio::io_context io_context;
+	udp::endpoint endpoint{asio::ip::address_v4::loopback(), static_cast<unsigned short>(kBenchPort)};
+	std::vector<udp::socket> sockets;
+	for (auto i = 0; i < kSocketsPerSender; ++i)
+	{
+		sockets.emplace_back(io_context);
+		sockets.back().open(udp::v4());
+		sockets.back().connect(endpoint);
+	}
+
+	asio::error_code err;
+	for (auto i = 0; i < num_packets; ++i)
+	{
+		const auto& packet = packets[i % packets.size()];
+		sockets[i % sockets.size()].send(asio::buffer(packet), 0, err);
+	}
+}
+
+static void bench_ingest_workers(benchmark::State& state)
+{
+	auto num_workers = static_cast<size_t>(state.range(0));
+	auto batch_size = static_cast<size_t>(state.range(1));
+	auto logger = spdlog::get("bench");
+	spectator::Registry registry(std::make_unique<spectator::Config>(), logger);
+	dummy_server server{&registry};
+
+	std::atomic<int64_t> received{0};
+	auto handler = [&server, &received](char* buffer)
+	{
+		received.fetch_add(1, std::memory_order_relaxed);
+		return server.parse_buffer(buffer);
+	};
+
+	std::vector<std::unique_ptr<asio::io_context>> contexts;
+	std::vector<std::unique_ptr<spectatord::UdpServer>> udp_servers;
+	for (size_t i = 0; i < num_workers; ++i)
+	{
+		contexts.emplace_back(std::make_unique<asio::io_context>(1));
+		udp_servers.emplace_back(
+		    std::make_unique<spectatord::UdpServer>(*contexts.back(), true, kBenchPort, handler, true));
+		udp_servers.back()->Start(batch_size);
+	}
+	std::vector<std::thread> workers;
+	for (auto& ctx : contexts)
+	{
+		workers.emplace_back([&ctx]() { ctx->run(); });
+	}
+
+	auto packets = get_packets();
+	int64_t total_sent = 0;
+	int64_t total_received = 0;
+	for (auto _ : state)
+	{
+		received = 0;
+		std::vector<std::thread> senders;
+		for (auto i = 0; i < kSenderThreads; ++i)
+		{
+			senders.emplace_back(send_packets, std::cref(packets), kPacketsPerIteration / kSenderThreads);
+		}
+		for (auto& sender : senders)
+		{
+			sender.join();
+		}
+
+		// wait for the workers to drain their sockets, some packets might have been dropped
+		auto last = int64_t{-1};
+		while (received < kPacketsPerIteration && received != last)
+		{
+			last = received;
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+		total_sent += kPacketsPerIteration;
+		total_received += received;
+	}
+
+	for (auto& ctx : contexts)
+	{
+		ctx->stop();
+	}
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+	state.counters["packets"] = benchmark::Counter(static_cast<double>(total_received), benchmark::Counter::kIsRate);
+	state.counters["dropped"] = benchmark::Counter(static_cast<double>(total_sent - total_received));
+}
+
+auto logger = spdlog::stdout_color_mt("bench");
+BENCHMARK(bench_ingest_workers)->ArgsProduct({{1, 2, 4, 8}, {1, 32}})->ArgNames({"workers", "batch"})->UseRealTime();
+BENCHMARK_MAIN();
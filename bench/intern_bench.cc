@@ -0,0 +1,66 @@
+#include "../spectator/string_pool.h"
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+// Measure interning the names and tag values seen by the ingest workers from a number
+// of threads, going straight to a shared pool, and through the per-thread caches that
+// intern_str keeps in front of the global pool.
+
+static constexpr int kNumStrings = 1000;
+
+static auto get_strings() -> const std::vector<std::string>&
+{
+	static auto* strings = []()
+	{
+		auto* result = new std::vector<std::string>();
+		result->reserve(kNumStrings);
+		for (auto i = 0; i < kNumStrings; ++i)
+		{
+			switch (i % 4)
+			{
+				case 0:
+					result->emplace_back(fmt::format("spectatord_test.name{}", i));
+					break;
+				case 1:
+					result->emplace_back(fmt::format("key{}", i % 16));
+					break;
+				case 2:
+					result->emplace_back(fmt::format("{}", i));
+					break;
+				default:
+					result->emplace_back(fmt::format("some-value-{}", i));
+			}
+		}
+		return result;
+	}();
+	return *strings;
+}
+
+static void bench_intern_pool(benchmark::State& state)
+{
+	static spectator::StringPool pool;
+	const auto& strings = get_strings();
+	size_t i = state.thread_index() * kNumStrings / state.threads();
+	for (auto _ : state)
+	{
+		const auto& s = strings[i++ % strings.size()];
+		benchmark::DoNotOptimize(pool.Intern(s.c_str(), s.length()));
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+static void bench_intern_cached(benchmark::State& state)
+{
+	const auto& strings = get_strings();
+	size_t i = state.thread_index() * kNumStrings / state.threads();
+	for (auto _ : state)
+	{
+		const auto& s = strings[i++ % strings.size()];
+		benchmark::DoNotOptimize(spectator::intern_str(s));
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(bench_intern_pool)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(bench_intern_cached)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_MAIN();
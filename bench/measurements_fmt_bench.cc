@@ -21,6 +21,8 @@ bench_get_measurement_new        3951 ns         3947 ns       176396
 */
 
 #include "../server/spectatord.h"
+#include "../spectator/batch_encoder.h"
+#include "../spectator/common_refs.h"
 #include <benchmark/benchmark.h>
 
 using spectator::Id;
@@ -191,6 +193,137 @@ static void bench_get_measurement_new(benchmark::State& state)
 	}
 }
 
+// Encoding a batch of measurements for the aggregator: building a new string table for
+// every batch, like the publisher used to do, vs. the dictionary kept by BatchEncoder
+using spectator::BatchEncoder;
+using spectator::Measurement;
+using spectator::Measurements;
+using spectator::refs;
+using spectator::SmilePayload;
+using spectator::StrRef;
+using spectator::Tags;
+using StrTable = ska::flat_hash_map<StrRef, int>;
+
+static constexpr int kBatchSize = 10000;
+
+static auto get_ids() -> const std::vector<Id>&
+{
+	static auto* ids = []()
+	{
+		auto* result = new std::vector<Id>();
+		result->reserve(kBatchSize);
+		const char* stats[] = {"count", "totalTime", "totalOfSquares", "max"};
+		for (auto i = 0; i < kBatchSize; ++i)
+		{
+			result->emplace_back(Id::Of(fmt::format("spectatord_test.timer{}", i / 4),
+			                            {{"statistic", stats[i % 4]},
+			                             {"id", fmt::format("{}", i % 100)},
+			                             {"foo", fmt::format("some-foo-{}", i % 10)}}));
+		}
+		return result;
+	}();
+	return *ids;
+}
+
+static auto get_batch() -> Measurements
+{
+	Measurements measurements;
+	for (const auto& id : get_ids())
+	{
+		measurements.emplace_back(id, 42.0);
+	}
+	return measurements;
+}
+
+static auto get_common_tags() -> Tags { return Tags{{"nf.app", "spectatord"}, {"nf.cluster", "spectatord-test"}}; }
+
+static void encode_orig(SmilePayload* payload, const Tags& common_tags, const Measurements& ms)
+{
+	payload->Init();
+	StrTable strings{ms.size() * 7};
+	for (const auto& tag : common_tags)
+	{
+		strings[tag.key] = 0;
+		strings[tag.value] = 0;
+	}
+	strings[refs().name()] = 0;
+	for (const auto& m : ms)
+	{
+		strings[m.id.Name()] = 0;
+		for (const auto& tag : m.id.GetTags())
+		{
+			strings[tag.key] = 0;
+			strings[tag.value] = 0;
+		}
+	}
+	auto idx = 0;
+	for (auto& kv : strings)
+	{
+		kv.second = idx++;
+	}
+	payload->Append(strings.size());
+	for (const auto& kv : strings)
+	{
+		payload->Append(kv.first.Get());
+	}
+
+	std::vector<int> common_ids;
+	for (const auto& tag : common_tags)
+	{
+		common_ids.emplace_back(strings.find(tag.key)->second);
+		common_ids.emplace_back(strings.find(tag.value)->second);
+	}
+	for (const auto& m : ms)
+	{
+		const auto& tags = m.id.GetTags();
+		payload->Append(tags.size() + 1 + common_tags.size());
+		for (auto i : common_ids)
+		{
+			payload->Append(i);
+		}
+		for (const auto& tag : tags)
+		{
+			payload->Append(strings.find(tag.key)->second);
+			payload->Append(strings.find(tag.value)->second);
+		}
+		payload->Append(strings.find(refs().name())->second);
+		payload->Append(strings.find(m.id.Name())->second);
+		auto stat = tags.at(refs().statistic());
+		payload->Append(stat == refs().max() ? 10 : 0);
+		payload->Append(m.value);
+	}
+	benchmark::DoNotOptimize(payload->Result());
+}
+
+static void bench_encode_orig(benchmark::State& state)
+{
+	auto common_tags = get_common_tags();
+	auto ms = get_batch();
+	SmilePayload payload;
+	for (auto _ : state)
+	{
+		encode_orig(&payload, common_tags, ms);
+	}
+	state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+static void bench_encode_dictionary(benchmark::State& state)
+{
+	spectator::MeasurementColumns ms;
+	for (const auto& m : get_batch())
+	{
+		ms.emplace_back(m.id, m.value);
+	}
+	BatchEncoder encoder{get_common_tags()};
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(encoder.Encode(ms));
+	}
+	state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
 BENCHMARK(bench_get_measurement_orig);
 BENCHMARK(bench_get_measurement_new);
+BENCHMARK(bench_encode_orig);
+BENCHMARK(bench_encode_dictionary);
 BENCHMARK_MAIN();
\ No newline at end of file
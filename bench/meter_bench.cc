@@ -0,0 +1,99 @@
+#include "../spectator/registry.h"
+#include <benchmark/benchmark.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+// Measure the cost of updating each type of meter, from one thread and from several
+// threads updating the same meter, which is what happens with hot meters in the
+// ingest workers. Every update also refreshes the timestamp of the meter.
+
+static auto registry() -> spectator::Registry&
+{
+	static auto* registry =
+	    new spectator::Registry(std::make_unique<spectator::Config>(), spdlog::stdout_color_mt("bench"));
+	return *registry;
+}
+
+static void bench_counter(benchmark::State& state)
+{
+	static auto counter = registry().GetCounter("bench.counter");
+	for (auto _ : state)
+	{
+		counter->Add(1.0);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+static void bench_dist_summary(benchmark::State& state)
+{
+	static auto ds = registry().GetDistributionSummary("bench.ds");
+	int64_t i = 0;
+	for (auto _ : state)
+	{
+		ds->Record(++i);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+static void bench_timer(benchmark::State& state)
+{
+	static auto timer = registry().GetTimer("bench.timer");
+	int64_t i = 0;
+	for (auto _ : state)
+	{
+		timer->Record(std::chrono::nanoseconds(++i));
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+static void bench_gauge(benchmark::State& state)
+{
+	static auto gauge = registry().GetGauge("bench.gauge");
+	auto i = 0.0;
+	for (auto _ : state)
+	{
+		gauge->Set(++i);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+static void bench_max_gauge(benchmark::State& state)
+{
+	static auto max_gauge = registry().GetMaxGauge("bench.max_gauge");
+	auto i = 0.0;
+	for (auto _ : state)
+	{
+		max_gauge->Update(++i);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+static void bench_mono_counter(benchmark::State& state)
+{
+	static auto mono_counter = registry().GetMonotonicCounter("bench.mono_counter");
+	auto i = 0.0;
+	for (auto _ : state)
+	{
+		mono_counter->Set(++i);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+static void bench_timer_histogram(benchmark::State& state)
+{
+	static auto histogram = registry().GetTimerHistogram(spectator::Id::Of("bench.histogram"));
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		histogram->Increment(++i % spectator::PercentileBucketsLength());
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(bench_counter)->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK(bench_dist_summary)->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK(bench_timer)->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK(bench_gauge)->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK(bench_max_gauge)->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK(bench_mono_counter)->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK(bench_timer_histogram)->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK_MAIN();
@@ -9,11 +9,11 @@ static std::vector<std::string> get_measurements()
 	measurements.reserve(500);
 	for (auto i = 0; i < 100; ++i)
 	{
-		measurements.emplace_back(fmt::format("1:c:spectatord_test.counter{}:42.0\n", i));
-		measurements.emplace_back(fmt::format("1:t:spectatord_test.timer,id={},foo=some-foo:0.5\n", i));
-		measurements.emplace_back(fmt::format("1:d:spectatord_test.ds,id={},foo=some-foo:42\n", i));
-		measurements.emplace_back(fmt::format("1:m:spectatord_test.max,id={},foo=some-foo:{}\n", i, i));
-		measurements.emplace_back(fmt::format("1:T:spectatord_test.percTimer,id={},tag=bar:{}\n", i, i % 10));
+		measurements.emplace_back(fmt::format("c:spectatord_test.counter{}:42.0\n", i));
+		measurements.emplace_back(fmt::format("t:spectatord_test.timer,id={},foo=some-foo:0.5\n", i));
+		measurements.emplace_back(fmt::format("d:spectatord_test.ds,id={},foo=some-foo:42\n", i));
+		measurements.emplace_back(fmt::format("m:spectatord_test.max,id={},foo=some-foo:{}\n", i, i));
+		measurements.emplace_back(fmt::format("T:spectatord_test.percTimer,id={},tag=bar:{}\n", i, i % 10));
 	}
 	return measurements;
 }
@@ -25,11 +25,19 @@ class dummy_server : public spectatord::Server
 	void do_it()
 	{
 		auto measurements = get_measurements();
-		for (const auto& s : measurements)
+		parse_all(&measurements);
+	}
+
+	void parse_all(std::vector<std::string>* measurements)
+	{
+		for (auto& s : *measurements)
 		{
-			parse(const_cast<char*>(s.c_str()));
+			parse(s.data());
 		}
 	}
+
+	void parse_datagram(char* buffer) { parse(buffer); }
+	void parse_statsd_datagram(char* buffer) { parse_statsd(buffer); }
 };
 
 static void bench_process_measurements(benchmark::State& state)
@@ -43,6 +51,144 @@ static void bench_process_measurements(benchmark::State& state)
 	}
 }
 
+// parse lines for meters that already exist, which is what we do most of the time
+static void bench_process_existing_measurements(benchmark::State& state)
+{
+	auto logger = spdlog::get("bench");
+	spectator::Registry registry(std::make_unique<spectator::Config>(), logger);
+	dummy_server s{&registry};
+	auto measurements = get_measurements();
+	s.parse_all(&measurements);
+	for (auto _ : state)
+	{
+		s.parse_all(&measurements);
+	}
+}
+
+// parse datagrams of 400 lines spread over the given number of meters of each type, where
+// updates to the same meter are coalesced before they are applied to the registry
+static void bench_process_datagram(benchmark::State& state)
+{
+	auto logger = spdlog::get("bench");
+	spectator::Registry registry(std::make_unique<spectator::Config>(), logger);
+	dummy_server s{&registry};
+	auto distinct = state.range(0);
+	std::string datagram;
+	for (auto i = 0; i < 100; ++i)
+	{
+		auto id = i % distinct;
+		datagram += fmt::format("c:spectatord_test.counter,id={}:1\n", id);
+		datagram += fmt::format("t:spectatord_test.timer,id={},foo=some-foo:0.5\n", id);
+		datagram += fmt::format("d:spectatord_test.ds,id={},foo=some-foo:42\n", id);
+		datagram += fmt::format("m:spectatord_test.max,id={},foo=some-foo:{}\n", id, i);
+	}
+	std::string buffer;
+	for (auto _ : state)
+	{
+		// parsing replaces the newlines
+		buffer = datagram;
+		s.parse_datagram(buffer.data());
+	}
+	state.SetItemsProcessed(state.iterations() * 400);
+}
+
+// lines with a long list of tags, so most of the time goes into finding the delimiters
+static auto long_tags_line(bool statsd) -> std::string
+{
+	std::string line = statsd ? "spectatord_test.long_tags:1|c|#" : "c:spectatord_test.long_tags";
+	for (auto i = 0; i < 30; ++i)
+	{
+		line += fmt::format(statsd ? "{}tag_key_{}:some_tag_value_{}" : ",tag_key_{}=some_tag_value_{}",
+		                    statsd && i > 0 ? "," : "", i, i);
+	}
+	if (!statsd)
+	{
+		line += ":1";
+	}
+	return line;
+}
+
+// fill a datagram of close to 64KiB with lines from get_line
+template <typename F>
+static auto full_datagram(F get_line) -> std::string
+{
+	std::string datagram;
+	for (auto i = 0;; ++i)
+	{
+		auto line = get_line(i);
+		if (datagram.size() + line.size() + 1 > 65000)
+		{
+			break;
+		}
+		datagram += line;
+		datagram += '\n';
+	}
+	return datagram;
+}
+
+static void bench_parse(benchmark::State& state, const std::string& datagram, bool statsd)
+{
+	auto logger = spdlog::get("bench");
+	spectator::Registry registry(std::make_unique<spectator::Config>(), logger);
+	dummy_server s{&registry};
+	std::string buffer;
+	for (auto _ : state)
+	{
+		buffer = datagram;
+		if (statsd)
+		{
+			s.parse_statsd_datagram(buffer.data());
+		}
+		else
+		{
+			s.parse_datagram(buffer.data());
+		}
+	}
+	state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(datagram.size()));
+}
+
+static void bench_parse_long_tags(benchmark::State& state) { bench_parse(state, long_tags_line(false), false); }
+
+static void bench_parse_statsd_long_tags(benchmark::State& state) { bench_parse(state, long_tags_line(true), true); }
+
+static void bench_parse_64k_datagram(benchmark::State& state)
+{
+	static auto datagram = full_datagram([](int i) {
+		return fmt::format("t:spectatord_test.timer,id={},foo=some-foo,bar=some-bar:0.{}", i % 100, i % 10);
+	});
+	bench_parse(state, datagram, false);
+}
+
+static void bench_parse_statsd_64k_datagram(benchmark::State& state)
+{
+	static auto datagram = full_datagram([](int i) {
+		return fmt::format("spectatord_test.timer:{}|ms|#id:{},foo:some-foo,bar:some-bar", i % 10, i % 100);
+	});
+	bench_parse(state, datagram, true);
+}
+
+// only find the delimiters of a 64KiB datagram, which the parsers used to look for one byte at a time
+static void bench_scan_delimiters(benchmark::State& state)
+{
+	static auto datagram = full_datagram([](int i) {
+		return fmt::format("t:spectatord_test.timer,id={},foo=some-foo,bar=some-bar:0.{}", i % 100, i % 10);
+	});
+	spectatord::delimiter_index index;
+	for (auto _ : state)
+	{
+		index.scan(datagram.data(), datagram.size());
+		benchmark::DoNotOptimize(index.next(0));
+	}
+	state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(datagram.size()));
+}
+
 auto logger = spdlog::stdout_color_mt("bench");
 BENCHMARK(bench_process_measurements);
+BENCHMARK(bench_process_existing_measurements);
+BENCHMARK(bench_process_datagram)->Arg(1)->Arg(10)->Arg(100);
+BENCHMARK(bench_parse_long_tags);
+BENCHMARK(bench_parse_statsd_long_tags);
+BENCHMARK(bench_parse_64k_datagram);
+BENCHMARK(bench_parse_statsd_64k_datagram);
+BENCHMARK(bench_scan_delimiters);
 BENCHMARK_MAIN();
@@ -0,0 +1,115 @@
+#include "../spectator/registry.h"
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <thread>
+
+// Measure the contention on the registry tables: a number of threads getting
+// counters and timers, as the ingest workers do, optionally with another thread
+// taking measurements in a loop like the publisher. Also measure how long it takes
+// to take the measurements when only a few of the meters were updated.
+
+static constexpr int kMetersPerType = 10000;
+static constexpr int kLookupsPerThread = 100000;
+
+static auto get_ids() -> std::vector<spectator::Id>
+{
+	std::vector<spectator::Id> ids;
+	ids.reserve(kMetersPerType);
+	for (auto i = 0; i < kMetersPerType; ++i)
+	{
+		ids.emplace_back(spectator::Id::Of("bench.meter", {{"id", fmt::format("{}", i)}, {"foo", "some-foo"}}));
+	}
+	return ids;
+}
+
+static void get_meters(spectator::Registry* registry, const std::vector<spectator::Id>& ids, int offset)
+{
+	for (auto i = 0; i < kLookupsPerThread; ++i)
+	{
+		const auto& id = ids[(i + offset) % ids.size()];
+		if (i % 2 == 0)
+		{
+			registry->GetCounter(id)->Increment();
+		}
+		else
+		{
+			registry->GetTimer(id)->Record(std::chrono::microseconds(i));
+		}
+	}
+}
+
+static void bench_registry_contention(benchmark::State& state)
+{
+	auto num_threads = static_cast<int>(state.range(0));
+	auto with_publisher = state.range(1) != 0;
+	auto logger = spdlog::get("bench");
+	spectator::Registry registry(std::make_unique<spectator::Config>(), logger);
+	auto ids = get_ids();
+
+	std::atomic<bool> done{false};
+	std::thread publisher;
+	if (with_publisher)
+	{
+		publisher = std::thread(
+		    [&registry, &done]()
+		    {
+			    while (!done)
+			    {
+				    benchmark::DoNotOptimize(registry.Measurements());
+			    }
+		    });
+	}
+
+	for (auto _ : state)
+	{
+		std::vector<std::thread> threads;
+		for (auto i = 0; i < num_threads; ++i)
+		{
+			threads.emplace_back(get_meters, &registry, std::cref(ids), i * kMetersPerType / num_threads);
+		}
+		for (auto& t : threads)
+		{
+			t.join();
+		}
+	}
+
+	done = true;
+	if (publisher.joinable())
+	{
+		publisher.join();
+	}
+	state.SetItemsProcessed(state.iterations() * num_threads * kLookupsPerThread);
+}
+
+// a registry with 100k counters, where only some of them are updated between measurements
+static void bench_measure_updated(benchmark::State& state)
+{
+	auto num_updated = static_cast<int>(state.range(0));
+	auto logger = spdlog::get("bench");
+	spectator::Registry registry(std::make_unique<spectator::Config>(), logger);
+	std::vector<std::shared_ptr<spectator::Counter>> counters;
+	for (auto i = 0; i < 10 * kMetersPerType; ++i)
+	{
+		counters.emplace_back(registry.GetCounter(spectator::Id::Of("bench.counter", {{"id", fmt::format("{}", i)}})));
+	}
+	registry.Measurements();
+
+	auto n = 0;
+	for (auto _ : state)
+	{
+		for (auto i = 0; i < num_updated; ++i)
+		{
+			counters[n++ % counters.size()]->Increment();
+		}
+		benchmark::DoNotOptimize(registry.Measurements());
+	}
+}
+
+auto logger = spdlog::stdout_color_mt("bench");
+BENCHMARK(bench_registry_contention)
+    ->ArgsProduct({{1, 2, 4, 8}, {0, 1}})
+    ->ArgNames({"threads", "publisher"})
+    ->UseRealTime();
+BENCHMARK(bench_measure_updated)->Arg(0)->Arg(100)->Arg(10000)->Arg(100000)->ArgName("updated");
+BENCHMARK_MAIN();
@@ -0,0 +1,149 @@
+#include "../server/local_server.h"
+#include "../server/shm_server.h"
+#include "../server/spectatord.h"
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <unistd.h>
+
+// Compare the cost of sending metrics from co-located clients through the unix domain
+// socket, received by a LocalServer, with writing them to the shared memory ring drained
+// by a ShmServer. Each message is a single line, which is what most clients send.
+
+static constexpr int kMessagesPerIteration = 100000;
+
+class dummy_server : public spectatord::Server
+{
+   public:
+	explicit dummy_server(spectator::Registry* registry) : spectatord::Server(false, 0, 0, "", registry) {}
+	auto parse_buffer(char* buffer) { return parse(buffer); }
+};
+
+static auto get_messages() -> std::vector<std::string>
+{
+	std::vector<std::string> messages;
+	messages.reserve(100);
+	for (auto i = 0; i < 100; ++i)
+	{
+		messages.emplace_back(fmt::format("c:spectatord_test.counter,id={}:1", i));
+	}
+	return messages;
+}
+
+// wait for the server to handle every message sent in an iteration
+static void wait_for(const std::atomic<int64_t>& received, int64_t expected)
+{
+	while (received.load(std::memory_order_relaxed) < expected)
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+}
+
+// run the clients for an iteration, each one sending its share of the messages with send_fn
+template <typename F>
+static void run_clients(int num_clients, F send_fn)
+{
+	std::vector<std::thread> clients;
+	for (auto i = 0; i < num_clients; ++i)
+	{
+		clients.emplace_back(send_fn, kMessagesPerIteration / num_clients);
+	}
+	for (auto& client : clients)
+	{
+		client.join();
+	}
+}
+
+static void bench_local_server(benchmark::State& state)
+{
+	auto num_clients = static_cast<int>(state.range(0));
+	auto logger = spdlog::get("bench");
+	spectator::Registry registry(std::make_unique<spectator::Config>(), logger);
+	dummy_server server{&registry};
+	std::atomic<int64_t> received{0};
+	auto handler = [&server, &received](char* buffer)
+	{
+		received.fetch_add(1, std::memory_order_relaxed);
+		return server.parse_buffer(buffer);
+	};
+
+	auto path = fmt::format("/tmp/spectatord-bench-{}.unix", getpid());
+	::unlink(path.c_str());
+	asio::io_context io_context{1};
+	spectatord::LocalServer local_server{io_context, path, handler};
+	local_server.Start();
+	std::thread worker{[&io_context]() { io_context.run(); }};
+
+	auto messages = get_messages();
+	auto send = [&path, &messages](int num_messages)
+	{
+		using endpoint_t = asio::local::datagram_protocol::endpoint;
+		asio::io_context ctx;
+		asio::local::datagram_protocol::socket socket{ctx};
+		socket.open();
+		socket.connect(endpoint_t{path});
+		asio::error_code err;
+		for (auto i = 0; i < num_messages; ++i)
+		{
+			socket.send(asio::buffer(messages[i % messages.size()]), 0, err);
+		}
+	};
+	for (auto _ : state)
+	{
+		received = 0;
+		run_clients(num_clients, send);
+		wait_for(received, kMessagesPerIteration);
+	}
+
+	io_context.stop();
+	worker.join();
+	::unlink(path.c_str());
+	state.SetItemsProcessed(state.iterations() * kMessagesPerIteration);
+}
+
+static void bench_shm_server(benchmark::State& state)
+{
+	auto num_clients = static_cast<int>(state.range(0));
+	auto logger = spdlog::get("bench");
+	spectator::Registry registry(std::make_unique<spectator::Config>(), logger);
+	dummy_server server{&registry};
+	std::atomic<int64_t> received{0};
+	auto handler = [&server, &received](char* buffer)
+	{
+		received.fetch_add(1, std::memory_order_relaxed);
+		return server.parse_buffer(buffer);
+	};
+
+	auto path = fmt::format("/tmp/spectatord-bench-{}.shm", getpid());
+	spectatord::ShmServer shm_server{spectatord::ShmRing::Create(path), handler, &registry};
+	shm_server.Start();
+
+	auto messages = get_messages();
+	auto send = [&path, &messages](int num_messages)
+	{
+		auto ring = spectatord::ShmRing::Open(path);
+		for (auto i = 0; i < num_messages; ++i)
+		{
+			// like a blocking socket, wait for room when the ring is full
+			while (!ring->Write(messages[i % messages.size()]))
+			{
+				std::this_thread::yield();
+			}
+		}
+	};
+	for (auto _ : state)
+	{
+		received = 0;
+		run_clients(num_clients, send);
+		wait_for(received, kMessagesPerIteration);
+	}
+
+	shm_server.Stop();
+	::unlink(path.c_str());
+	state.SetItemsProcessed(state.iterations() * kMessagesPerIteration);
+}
+
+auto logger = spdlog::stdout_color_mt("bench");
+BENCHMARK(bench_local_server)->Arg(1)->Arg(4)->ArgName("clients")->UseRealTime();
+BENCHMARK(bench_shm_server)->Arg(1)->Arg(4)->ArgName("clients")->UseRealTime();
+BENCHMARK_MAIN();
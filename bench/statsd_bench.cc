@@ -56,10 +56,18 @@ static void bench_sampled_hist_100x(benchmark::State& state)
 	free(line);
 }
 
+static void bench_sampled_timer_1000x(benchmark::State& state)
+{
+	char* line = strdup("timer.name:2|ms|@0.001|#system-agent,country=ar");
+	bench(state, line);
+	free(line);
+}
+
 auto logger = spdlog::stdout_color_mt("bench");
 BENCHMARK(bench_counter_tags);
 BENCHMARK(bench_counter_notags);
 BENCHMARK(bench_sampled_hist);
 BENCHMARK(bench_sampled_hist_100x);
 BENCHMARK(bench_sampled_timer);
+BENCHMARK(bench_sampled_timer_1000x);
 BENCHMARK_MAIN();
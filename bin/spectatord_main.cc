@@ -1,4 +1,5 @@
 #include "../admin/admin_server.h"
+#include "../server/local.h"
 #include "../server/spectatord.h"
 #include "../spectator/version.h"
 #include "absl/flags/flag.h"
@@ -67,7 +68,13 @@ ABSL_FLAG(bool, enable_socket, false,
           "Enable UNIX domain socket support. Default is true on Linux and false "
           "on MacOS and Windows.");
 #endif
+ABSL_FLAG(bool, enable_shm, false,
+          "Enable the shared memory ring, which co-located clients can write metrics to without "
+          "a syscall per update.");
 ABSL_FLAG(bool, enable_statsd, false, "Enable statsd support.");
+ABSL_FLAG(size_t, ingest_workers, 1,
+          "Number of threads parsing metrics received over UDP. Each worker owns a socket bound with "
+          "SO_REUSEPORT for every UDP port, and is pinned to a cpu when more than one worker is used.");
 ABSL_FLAG(bool, ipv4_only, false,
           "Enable IPv4-only UDP listeners. This option should only be used in environments "
           "where it is impossible to run IPv6.");
@@ -83,11 +90,29 @@ ABSL_FLAG(bool, no_common_tags, false,
           "internal status metrics will be recorded. Only use this feature for special cases "
           "where it is absolutely necessary to override common tags such as nf.app, and only "
           "use it with a secondary spectatord process.");
+ABSL_FLAG(bool, parallel_compression, false,
+          "Compress large publish payloads in parallel on the sender threads, as a gzip stream made "
+          "of several members, or several zstd frames. Reduces the time to publish with a large "
+          "batch_size on hosts with many cores.");
 ABSL_FLAG(PortNumber, port, PortNumber(1234), "Port number for the UDP socket.");
 ABSL_FLAG(std::string, process_name, "spectatord",
           "The nf.process tag value that will be added to internal status metrics. We do not "
           "set the corresponding environment value, because only the internal status metrics "
           "should have this tag, and all other metrics should be exempt.");
+ABSL_FLAG(size_t, publish_connections, 8,
+          "Maximum number of connections to the aggregator used to publish metrics. Requests are "
+          "multiplexed over each connection when the aggregator supports HTTP/2.");
+ABSL_FLAG(spectator::Codec, publish_compression, spectator::Codec::Gzip,
+          "Compression used for the payloads sent to the aggregator: gzip, identity, libdeflate or "
+          "zstd. libdeflate sends gzip using less CPU than zlib, zstd needs an aggregator that "
+          "accepts it, and sending payloads uncompressed is meant for local aggregators.");
+ABSL_FLAG(bool, reclaim_strings, false,
+          "Free the interned names and tag values received from clients once the meters using them "
+          "expire, so high cardinality tags do not grow the string pool forever.");
+ABSL_FLAG(size_t, recv_batch_size, 1,
+          "Maximum number of datagrams read with a single recvmmsg call, for the UDP and UNIX domain "
+          "sockets. A value of 1 receives one datagram per call.");
+ABSL_FLAG(std::string, shm_path, spectatord::kShmRingPath, "Path to the shared memory ring.");
 ABSL_FLAG(std::string, socket_path, "/run/spectatord/spectatord.unix", "Path to the UNIX domain socket.");
 ABSL_FLAG(PortNumber, statsd_port, PortNumber(8125), "Port number for the statsd socket.");
 ABSL_FLAG(std::string, uri, "", "Optional override URI for the aggregator.");
@@ -142,6 +167,13 @@ auto main(int argc, char** argv) -> int
 
 	cfg->meter_ttl = absl::GetFlag(FLAGS_meter_ttl);
 
+	cfg->reclaim_strings = absl::GetFlag(FLAGS_reclaim_strings);
+
+	cfg->publish_connections = absl::GetFlag(FLAGS_publish_connections);
+
+	cfg->compression = absl::GetFlag(FLAGS_publish_compression);
+	cfg->parallel_compression = absl::GetFlag(FLAGS_parallel_compression);
+
 	cfg->frequency = absl::GetFlag(FLAGS_frequency);
 
 	cfg->age_gauge_limit = absl::GetFlag(FLAGS_age_gauge_limit);
@@ -186,6 +218,12 @@ auto main(int argc, char** argv) -> int
 		socket_path = absl::GetFlag(FLAGS_socket_path);
 	}
 
+	std::optional<std::string> shm_path;
+	if (absl::GetFlag(FLAGS_enable_shm))
+	{
+		shm_path = absl::GetFlag(FLAGS_shm_path);
+	}
+
 	std::optional<int> statsd_port;
 	if (absl::GetFlag(FLAGS_enable_statsd))
 	{
@@ -197,7 +235,8 @@ auto main(int argc, char** argv) -> int
 	admin_server.Start();
 
 	spectatord::Server server{absl::GetFlag(FLAGS_ipv4_only), absl::GetFlag(FLAGS_port).port, statsd_port, socket_path,
-	                          &registry};
+	                          &registry, absl::GetFlag(FLAGS_ingest_workers), absl::GetFlag(FLAGS_recv_batch_size),
+	                          shm_path};
 	server.Start();
 
 	return 0;
@@ -25,6 +25,7 @@ class SpectatorDConan(ConanFile):
         "fmt/11.0.2",
         "gtest/1.15.0",
         "libcurl/8.10.1",
+        "libdeflate/1.19",
         "openssl/3.3.2",
         "poco/1.13.3",
         "protobuf/5.27.0",
@@ -33,6 +34,7 @@ class SpectatorDConan(ConanFile):
         "tsl-hopscotch-map/2.3.1",
         "xxhash/0.8.2",
         "zlib/1.3.1",
+        "zstd/1.5.5",
     )
     tool_requires = (
         "protobuf/5.27.0",
@@ -0,0 +1,106 @@
+#include "batch_receiver.h"
+#include "../util/logger.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+
+namespace spectatord
+{
+
+BatchReceiver::BatchReceiver(size_t batch_size)
+    : batch_size_{batch_size == 0 ? 1 : batch_size},
+      buffers_(batch_size_ * kBufferSize),
+      sizes_(batch_size_),
+      truncated_(batch_size_)
+{
+#ifdef __linux__
+	iovecs_.resize(batch_size_);
+	msgs_.resize(batch_size_);
+	for (size_t i = 0; i < batch_size_; ++i)
+	{
+		// leave room for the null terminator
+		iovecs_[i].iov_base = Datagram(i);
+		iovecs_[i].iov_len = kBufferSize - 1;
+		std::memset(&msgs_[i], 0, sizeof msgs_[i]);
+		msgs_[i].msg_hdr.msg_iov = &iovecs_[i];
+		msgs_[i].msg_hdr.msg_iovlen = 1;
+	}
+#endif
+}
+
+#ifdef __linux__
+auto BatchReceiver::Receive(int fd) -> int
+{
+	int n;
+	do
+	{
+		n = recvmmsg(fd, msgs_.data(), static_cast<unsigned int>(batch_size_), MSG_DONTWAIT, nullptr);
+	} while (n < 0 && errno == EINTR);
+
+	for (auto i = 0; i < n; ++i)
+	{
+		auto len = static_cast<size_t>(msgs_[i].msg_len);
+		sizes_[i] = len;
+		truncated_[i] = (msgs_[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+		Datagram(i)[len] = '\0';
+		// recvmmsg updates the flags on return
+		msgs_[i].msg_hdr.msg_flags = 0;
+	}
+	return n;
+}
+#else
+auto BatchReceiver::Receive(int fd) -> int
+{
+	int n = 0;
+	while (static_cast<size_t>(n) < batch_size_)
+	{
+		auto* buffer = Datagram(n);
+		// leave room for the null terminator, and let the kernel tell us about truncation,
+		// since a datagram that exactly fills the buffer has the same length as one cut short
+		iovec iov{buffer, kBufferSize - 1};
+		msghdr msg{};
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		auto len = recvmsg(fd, &msg, MSG_DONTWAIT);
+		if (len < 0)
+		{
+			if (errno == EINTR) continue;
+			return n > 0 ? n : -1;
+		}
+		sizes_[n] = static_cast<size_t>(len);
+		truncated_[n] = (msg.msg_flags & MSG_TRUNC) != 0;
+		buffer[sizes_[n]] = '\0';
+		++n;
+	}
+	return n;
+}
+#endif
+
+auto BatchReceiver::Dispatch(int fd, const handler_t& handler) -> int
+{
+	auto n = Receive(fd);
+	if (n < 0)
+	{
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+		{
+			Logger()->error("Error receiving: {}: {}", errno, std::strerror(errno));
+		}
+		return n;
+	}
+
+	for (auto i = 0; i < n; ++i)
+	{
+		if (Truncated(i))
+		{
+			Logger()->error("too many bytes transferred: {} >= {}", Size(i), kBufferSize - 1);
+		}
+		if (Size(i) > 0)
+		{
+			handler(Datagram(i));
+		}
+	}
+	return n;
+}
+
+}  // namespace spectatord
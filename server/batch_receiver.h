@@ -0,0 +1,54 @@
+#pragma once
+
+#include "handler.h"
+#include <cstddef>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+
+namespace spectatord
+{
+
+// Reads a batch of datagrams from a socket with a single recvmmsg call into a ring of
+// preallocated buffers, amortizing the cost of the syscall and the completion handler
+// over many packets. On platforms without recvmmsg we fall back to a recv per datagram.
+class BatchReceiver
+{
+   public:
+	static constexpr size_t kBufferSize = 65536;
+
+	explicit BatchReceiver(size_t batch_size);
+	BatchReceiver(const BatchReceiver&) = delete;
+	BatchReceiver(BatchReceiver&&) = delete;
+	auto operator=(const BatchReceiver&) -> BatchReceiver& = delete;
+	auto operator=(BatchReceiver&&) -> BatchReceiver& = delete;
+	~BatchReceiver() = default;
+
+	// Receive up to batch_size datagrams without blocking. Returns the number of
+	// datagrams received, or -1 with errno set (EAGAIN when nothing is available)
+	auto Receive(int fd) -> int;
+
+	// Receive a batch of datagrams and pass each one of them to the handler. Returns the
+	// number of datagrams received, like Receive
+	auto Dispatch(int fd, const handler_t& handler) -> int;
+
+	// The datagram at index i of the last batch received, terminated with a '\0'
+	auto Datagram(size_t i) -> char* { return &buffers_[i * kBufferSize]; }
+	[[nodiscard]] auto Size(size_t i) const -> size_t { return sizes_[i]; }
+	[[nodiscard]] auto Truncated(size_t i) const -> bool { return truncated_[i]; }
+	[[nodiscard]] auto BatchSize() const -> size_t { return batch_size_; }
+
+   private:
+	size_t batch_size_;
+	std::vector<char> buffers_;
+	std::vector<size_t> sizes_;
+	std::vector<bool> truncated_;
+#ifdef __linux__
+	std::vector<iovec> iovecs_;
+	std::vector<mmsghdr> msgs_;
+#endif
+};
+
+}  // namespace spectatord
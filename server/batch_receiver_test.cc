@@ -0,0 +1,88 @@
+#include "gtest/gtest.h"
+#include "batch_receiver.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+using spectatord::BatchReceiver;
+
+class socket_pair
+{
+   public:
+	socket_pair() { socketpair(AF_UNIX, SOCK_DGRAM, 0, fds_); }
+	~socket_pair()
+	{
+		close(fds_[0]);
+		close(fds_[1]);
+	}
+	void send(const std::string& msg) const { ::send(fds_[0], msg.data(), msg.size(), 0); }
+	[[nodiscard]] auto receiver() const -> int { return fds_[1]; }
+
+   private:
+	int fds_[2]{-1, -1};
+};
+
+TEST(BatchReceiver, Empty)
+{
+	socket_pair sockets;
+	BatchReceiver receiver{8};
+	EXPECT_EQ(receiver.Receive(sockets.receiver()), -1);
+	EXPECT_TRUE(errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+TEST(BatchReceiver, Receive)
+{
+	socket_pair sockets;
+	sockets.send("c:counter:1");
+	sockets.send("c:counter:2\nc:counter:3");
+	sockets.send("g:gauge:42");
+
+	BatchReceiver receiver{8};
+	ASSERT_EQ(receiver.Receive(sockets.receiver()), 3);
+	EXPECT_STREQ(receiver.Datagram(0), "c:counter:1");
+	EXPECT_EQ(receiver.Size(0), 11);
+	EXPECT_STREQ(receiver.Datagram(1), "c:counter:2\nc:counter:3");
+	EXPECT_STREQ(receiver.Datagram(2), "g:gauge:42");
+	EXPECT_FALSE(receiver.Truncated(2));
+}
+
+TEST(BatchReceiver, ReceiveUpToBatchSize)
+{
+	socket_pair sockets;
+	for (auto i = 0; i < 5; ++i)
+	{
+		sockets.send(std::to_string(i));
+	}
+
+	BatchReceiver receiver{2};
+	ASSERT_EQ(receiver.Receive(sockets.receiver()), 2);
+	EXPECT_STREQ(receiver.Datagram(1), "1");
+	ASSERT_EQ(receiver.Receive(sockets.receiver()), 2);
+	EXPECT_STREQ(receiver.Datagram(0), "2");
+	ASSERT_EQ(receiver.Receive(sockets.receiver()), 1);
+	EXPECT_STREQ(receiver.Datagram(0), "4");
+}
+
+TEST(BatchReceiver, Dispatch)
+{
+	socket_pair sockets;
+	sockets.send("first");
+	sockets.send("");
+	sockets.send("second");
+
+	std::vector<std::string> received;
+	spectatord::handler_t handler = [&received](char* buffer) -> std::optional<std::string>
+	{
+		received.emplace_back(buffer);
+		return {};
+	};
+	BatchReceiver receiver{8};
+	EXPECT_EQ(receiver.Dispatch(sockets.receiver(), handler), 3);
+
+	// empty datagrams are skipped
+	std::vector<std::string> expected{"first", "second"};
+	EXPECT_EQ(received, expected);
+}
+}  // namespace
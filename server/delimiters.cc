@@ -0,0 +1,116 @@
+#include "delimiters.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SPECTATORD_X86 1
+#endif
+
+namespace spectatord
+{
+
+static constexpr auto is_delimiter(char c) noexcept -> bool
+{
+	return c == '\n' || c == ',' || c == ':' || c == '=' || c == '|' || c == '#';
+}
+
+// the bits for the 64 bytes starting at p, of which only n are valid
+static auto scan_scalar(const char* p, size_t n) noexcept -> uint64_t
+{
+	uint64_t bits = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		bits |= static_cast<uint64_t>(is_delimiter(p[i])) << i;
+	}
+	return bits;
+}
+
+#ifdef SPECTATORD_X86
+static auto scan_sse2(const char* p) noexcept -> uint64_t
+{
+	const auto newline = _mm_set1_epi8('\n');
+	const auto comma = _mm_set1_epi8(',');
+	const auto colon = _mm_set1_epi8(':');
+	const auto equals = _mm_set1_epi8('=');
+	const auto pipe = _mm_set1_epi8('|');
+	const auto hash = _mm_set1_epi8('#');
+	uint64_t bits = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 16));
+		auto m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, newline), _mm_cmpeq_epi8(v, comma)),
+		                      _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, equals)));
+		m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, pipe), _mm_cmpeq_epi8(v, hash)));
+		bits |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(m))) << (i * 16);
+	}
+	return bits;
+}
+
+__attribute__((target("avx2"))) static auto scan_avx2(const char* p) noexcept -> uint64_t
+{
+	const auto newline = _mm256_set1_epi8('\n');
+	const auto comma = _mm256_set1_epi8(',');
+	const auto colon = _mm256_set1_epi8(':');
+	const auto equals = _mm256_set1_epi8('=');
+	const auto pipe = _mm256_set1_epi8('|');
+	const auto hash = _mm256_set1_epi8('#');
+	uint64_t bits = 0;
+	for (int i = 0; i < 2; ++i)
+	{
+		auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i * 32));
+		auto m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, newline), _mm256_cmpeq_epi8(v, comma)),
+		                         _mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, equals)));
+		m = _mm256_or_si256(m, _mm256_or_si256(_mm256_cmpeq_epi8(v, pipe), _mm256_cmpeq_epi8(v, hash)));
+		bits |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(m))) << (i * 32);
+	}
+	return bits;
+}
+#endif
+
+using scan_fn = uint64_t (*)(const char*) noexcept;
+
+static auto scan_full_words() noexcept -> scan_fn
+{
+#ifdef SPECTATORD_X86
+	static const scan_fn fn = __builtin_cpu_supports("avx2") ? scan_avx2 : scan_sse2;
+	return fn;
+#else
+	return [](const char* p) noexcept { return scan_scalar(p, 64); };
+#endif
+}
+
+void delimiter_index::scan(const char* buffer, size_t size)
+{
+	buffer_ = buffer;
+	size_ = size;
+	bits_.resize(size / 64 + 1);
+
+	auto scan_word = scan_full_words();
+	size_t word = 0;
+	for (; word < size / 64; ++word)
+	{
+		bits_[word] = scan_word(buffer + word * 64);
+	}
+	// the tail is shorter than a word, and reading past the end of the buffer is not allowed
+	bits_[word] = scan_scalar(buffer + word * 64, size % 64);
+}
+
+auto delimiter_index::next(size_t pos) const noexcept -> size_t
+{
+	if (pos >= size_)
+	{
+		return std::string_view::npos;
+	}
+	auto word = pos / 64;
+	auto bits = bits_[word] & (~uint64_t{0} << (pos % 64));
+	while (bits == 0)
+	{
+		if (++word == bits_.size())
+		{
+			return std::string_view::npos;
+		}
+		bits = bits_[word];
+	}
+	return word * 64 + static_cast<size_t>(__builtin_ctzll(bits));
+}
+
+}  // namespace spectatord
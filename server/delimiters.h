@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace spectatord
+{
+
+class delimiters;
+
+// The positions of the characters that separate the fields of the lines in a buffer
+// ('\n' ',' ':' '=' '|' '#'), found with a single pass over the whole buffer, 16 or 32
+// bytes at a time when the cpu supports it, and kept as a bitmap with a bit per byte.
+// The parsers then jump from one delimiter to the next instead of looking at every byte.
+class delimiter_index
+{
+   public:
+	// index the delimiters in [buffer, buffer + size). The buffer can be modified
+	// afterwards, as long as the parsers do not look for the characters replaced
+	void scan(const char* buffer, size_t size);
+
+	// position of the first delimiter at or after pos, or npos
+	[[nodiscard]] auto next(size_t pos) const noexcept -> size_t;
+
+	// the delimiters between positions begin and end, relative to begin
+	[[nodiscard]] auto view(size_t begin, size_t end) const noexcept -> delimiters;
+
+	[[nodiscard]] auto data() const noexcept -> const char* { return buffer_; }
+	[[nodiscard]] auto size() const noexcept -> size_t { return size_; }
+
+   private:
+	const char* buffer_ = nullptr;
+	size_t size_ = 0;
+	std::vector<uint64_t> bits_;
+};
+
+// The delimiters of a line, or part of it, with positions relative to its start
+class delimiters
+{
+   public:
+	static constexpr auto npos = std::string_view::npos;
+
+	delimiters(const delimiter_index* index, size_t begin, size_t end) noexcept
+	    : index_{index}, begin_{begin}, end_{end}
+	{
+	}
+
+	// position of the first c at or after pos, or npos. c must be one of the delimiters
+	[[nodiscard]] auto find(char c, size_t pos) const noexcept -> size_t
+	{
+		return find_first_of(c, c, pos);
+	}
+
+	// position of the first a or b at or after pos, or npos
+	[[nodiscard]] auto find_first_of(char a, char b, size_t pos) const noexcept -> size_t
+	{
+		const auto* data = index_->data();
+		for (auto p = index_->next(begin_ + pos); p < end_; p = index_->next(p + 1))
+		{
+			if (data[p] == a || data[p] == b)
+			{
+				return p - begin_;
+			}
+		}
+		return npos;
+	}
+
+	// the delimiters from pos to the end
+	[[nodiscard]] auto from(size_t pos) const noexcept -> delimiters { return {index_, begin_ + pos, end_}; }
+
+	[[nodiscard]] auto size() const noexcept -> size_t { return end_ - begin_; }
+
+   private:
+	const delimiter_index* index_;
+	size_t begin_;
+	size_t end_;
+};
+
+inline auto delimiter_index::view(size_t begin, size_t end) const noexcept -> delimiters
+{
+	return {this, begin, end};
+}
+
+}  // namespace spectatord
@@ -0,0 +1,77 @@
+#include "delimiters.h"
+#include "gtest/gtest.h"
+
+#include <random>
+#include <string>
+
+namespace
+{
+using spectatord::delimiter_index;
+using spectatord::delimiters;
+
+TEST(Delimiters, Next)
+{
+	std::string buffer{"c:name,foo=bar:1\nd:x|y#z"};
+	delimiter_index index;
+	index.scan(buffer.data(), buffer.size());
+	std::vector<size_t> found;
+	for (auto p = index.next(0); p != delimiters::npos; p = index.next(p + 1))
+	{
+		found.push_back(p);
+	}
+	std::vector<size_t> expected{1, 6, 10, 14, 16, 18, 20, 22};
+	EXPECT_EQ(found, expected);
+}
+
+TEST(Delimiters, Empty)
+{
+	delimiter_index index;
+	index.scan("", 0);
+	EXPECT_EQ(index.next(0), delimiters::npos);
+	EXPECT_EQ(index.view(0, 0).find(':', 0), delimiters::npos);
+}
+
+// compare with a byte by byte search, across the boundaries of the words of the bitmap
+TEST(Delimiters, MatchesScalar)
+{
+	const std::string chars{"ab,:=|#\n"};
+	std::mt19937 gen{42};
+	std::uniform_int_distribution<size_t> pick{0, chars.size() - 1};
+	for (size_t size : {1, 15, 16, 31, 32, 63, 64, 65, 127, 128, 200, 1000})
+	{
+		std::string buffer;
+		for (size_t i = 0; i < size; ++i)
+		{
+			buffer += chars[pick(gen)];
+		}
+		delimiter_index index;
+		index.scan(buffer.data(), buffer.size());
+		for (size_t pos = 0; pos <= size; ++pos)
+		{
+			auto expected = buffer.find_first_of(",:=|#\n", pos);
+			EXPECT_EQ(index.next(pos), expected) << "size=" << size << " pos=" << pos;
+		}
+		auto view = index.view(size / 3, 2 * size / 3);
+		auto line = std::string_view{buffer}.substr(size / 3, 2 * size / 3 - size / 3);
+		for (size_t pos = 0; pos < line.size(); ++pos)
+		{
+			EXPECT_EQ(view.find('=', pos), line.find('=', pos));
+			EXPECT_EQ(view.find_first_of(',', ':', pos), line.find_first_of(",:", pos));
+		}
+	}
+}
+
+TEST(Delimiters, View)
+{
+	std::string buffer{"a:1\nb,c=d:2\n"};
+	delimiter_index index;
+	index.scan(buffer.data(), buffer.size());
+	auto line = index.view(4, 11);
+	EXPECT_EQ(line.size(), 7);
+	EXPECT_EQ(line.find(':', 0), 5);
+	EXPECT_EQ(line.find('\n', 0), delimiters::npos);
+	EXPECT_EQ(line.find_first_of(',', ':', 0), 1);
+	EXPECT_EQ(line.from(2).find_first_of(',', ':', 0), 3);
+}
+
+}  // namespace
@@ -2,8 +2,10 @@
 
 #include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
+#include "../spectator/coarse_clock.h"
 #include "../spectator/registry.h"
-#include <chrono>
+#include <array>
+#include <atomic>
 #include <memory>
 
 namespace spectatord
@@ -13,67 +15,190 @@ namespace detail
 template <typename V>
 struct cache_entry
 {
-	mutable std::chrono::steady_clock::time_point updated;
+	cache_entry(spectator::Id id_param, std::unique_ptr<V> v_param, int64_t now)
+	    : id{std::move(id_param)}, v{std::move(v_param)}, touched{now}
+	{
+	}
+
+	spectator::Id id;
 	std::unique_ptr<V> v;
+	// when the entry was last moved to the back of the expiry list
+	std::atomic<int64_t> touched;
+	cache_entry* prev{nullptr};
+	cache_entry* next{nullptr};
+};
+
+// the tables are keyed by the id owned by each entry, so the entries can be
+// found from the expiry lists without keeping another copy of the id
+struct id_ptr_hash
+{
+	auto operator()(const spectator::Id* id) const noexcept -> size_t { return std::hash<spectator::Id>()(*id); }
+};
+
+struct id_ptr_equal
+{
+	auto operator()(const spectator::Id* a, const spectator::Id* b) const noexcept -> bool { return *a == *b; }
 };
 }  // namespace detail
 
+// Entries are spread over shards, each with its own lock, and kept in a list ordered by
+// the last time they were used, so expiring them only needs to look at the front of
+// the lists. To keep lookups cheap, the time is read from a coarse clock, and an entry
+// is only moved to the back of its list when it was last moved kTouchInterval ago, so
+// entries expire after being idle between kExpireAfter and kExpireAfter + kTouchInterval.
 template <typename V>
 class expiring_cache
 {
    public:
 	using supplier_t = std::unique_ptr<V> (*)(spectator::Registry*, spectator::Id);
-	explicit expiring_cache(supplier_t supplier) : supplier_{supplier} {}
+	// returns the current time in seconds
+	using clock_fn_t = int64_t (*)();
+	static constexpr int64_t kExpireAfter = 120;
+	static constexpr int64_t kTouchInterval = 10;
 
-	V* get_or_create(spectator::Registry* registry, spectator::Id k)
+	explicit expiring_cache(supplier_t supplier, clock_fn_t clock = spectator::coarse_monotonic_seconds)
+	    : supplier_{supplier}, clock_{clock}
 	{
-		absl::MutexLock lock{&cache_mutex_};
+	}
 
-		auto it = cache_.find(k);
-		if (it != cache_.end())
+	V* get_or_create(spectator::Registry* registry, spectator::Id k)
+	{
+		auto now = clock_();
+		auto& s = shard_for(k);
 		{
-			auto& entry = it->second;
-			entry.updated = std::chrono::steady_clock::now();
-			return entry.v.get();
+			absl::ReaderMutexLock lock{&s.mutex};
+			auto it = s.entries.find(&k);
+			if (it != s.entries.end())
+			{
+				auto* entry = it->second.get();
+				touch(&s, entry, now);
+				return entry->v.get();
+			}
 		}
 
-		detail::cache_entry<V> entry{std::chrono::steady_clock::now(), supplier_(registry, k)};
-		auto* ret = entry.v.get();
-		cache_.emplace(std::make_pair(std::move(k), std::move(entry)));
-		return ret;
+		auto v = supplier_(registry, k);
+		auto entry = std::make_unique<entry_t>(std::move(k), std::move(v), now);
+		absl::MutexLock lock{&s.mutex};
+		const auto* id = &entry->id;
+		auto insert_result = s.entries.emplace(id, std::move(entry));
+		auto* inserted = insert_result.first->second.get();
+		if (insert_result.second)
+		{
+			absl::MutexLock list_lock{&s.list_mutex};
+			push_back(&s, inserted);
+		}
+		return inserted->v.get();
 	}
 
+	// returns the number of entries before expiring, and the number of entries expired
 	std::pair<size_t, size_t> expire()
 	{
-		static constexpr auto kExpireAfter = std::chrono::seconds{120};
-		absl::MutexLock lock{&cache_mutex_};
-		auto size = cache_.size();
-		auto expired = 0U;
-		auto now = std::chrono::steady_clock::now();
-		auto it = cache_.begin();
-		auto end = cache_.end();
-		while (it != end)
+		auto now = clock_();
+		size_t size = 0;
+		size_t expired = 0;
+		for (auto& s : shards_)
 		{
-			auto& entry = it->second;
-			auto age = now - entry.updated;
-			if (age > kExpireAfter)
+			absl::MutexLock lock{&s.mutex};
+			absl::MutexLock list_lock{&s.list_mutex};
+			size += s.entries.size();
+			while (s.oldest != nullptr && now - s.oldest->touched.load(std::memory_order_relaxed) > kExpireAfter)
 			{
-				it = cache_.erase(it);
+				auto* entry = s.oldest;
+				unlink(&s, entry);
+				s.entries.erase(&entry->id);
 				++expired;
 			}
-			else
-			{
-				++it;
-			}
 		}
 		return std::make_pair(size, expired);
 	}
 
    private:
-	using table_t = tsl::hopscotch_map<spectator::Id, detail::cache_entry<V>>;
-	absl::Mutex cache_mutex_;
-	table_t cache_ ABSL_GUARDED_BY(cache_mutex_);
+	using entry_t = detail::cache_entry<V>;
+	using table_t =
+	    tsl::hopscotch_map<const spectator::Id*, std::unique_ptr<entry_t>, detail::id_ptr_hash, detail::id_ptr_equal>;
+	static constexpr size_t kShardBits = 4;
+	static constexpr size_t kShards = size_t{1} << kShardBits;
+
+	struct alignas(64) shard
+	{
+		absl::Mutex mutex;
+		table_t entries ABSL_GUARDED_BY(mutex);
+		// entries are moved in the list while holding the shard lock for reading
+		absl::Mutex list_mutex;
+		entry_t* oldest ABSL_GUARDED_BY(list_mutex){nullptr};
+		entry_t* newest ABSL_GUARDED_BY(list_mutex){nullptr};
+	};
+	std::array<shard, kShards> shards_;
 	supplier_t supplier_;
+	clock_fn_t clock_;
+
+	auto shard_for(const spectator::Id& id) noexcept -> shard&
+	{
+		auto h = static_cast<uint64_t>(std::hash<spectator::Id>()(id)) * UINT64_C(0x9E3779B97F4A7C15);
+		return shards_[h >> (64 - kShardBits)];
+	}
+
+	static void touch(shard* s, entry_t* entry, int64_t now)
+	{
+		if (now - entry->touched.load(std::memory_order_relaxed) < kTouchInterval)
+		{
+			return;
+		}
+		absl::MutexLock list_lock{&s->list_mutex};
+		// another thread could have moved it while we waited for the lock
+		if (now - entry->touched.load(std::memory_order_relaxed) < kTouchInterval)
+		{
+			return;
+		}
+		entry->touched.store(now, std::memory_order_relaxed);
+		unlink(s, entry);
+		push_back(s, entry);
+	}
+
+	// the time of an entry is never less than the time of the ones before it in the
+	// list, even if the clock was read by threads racing for the list lock
+	static void push_back(shard* s, entry_t* entry) ABSL_EXCLUSIVE_LOCKS_REQUIRED(s->list_mutex)
+	{
+		auto now = entry->touched.load(std::memory_order_relaxed);
+		if (s->newest != nullptr)
+		{
+			now = std::max(now, s->newest->touched.load(std::memory_order_relaxed));
+		}
+		entry->touched.store(now, std::memory_order_relaxed);
+		entry->prev = s->newest;
+		entry->next = nullptr;
+		if (s->newest != nullptr)
+		{
+			s->newest->next = entry;
+		}
+		else
+		{
+			s->oldest = entry;
+		}
+		s->newest = entry;
+	}
+
+	static void unlink(shard* s, entry_t* entry) ABSL_EXCLUSIVE_LOCKS_REQUIRED(s->list_mutex)
+	{
+		if (entry->prev != nullptr)
+		{
+			entry->prev->next = entry->next;
+		}
+		else
+		{
+			s->oldest = entry->next;
+		}
+		if (entry->next != nullptr)
+		{
+			entry->next->prev = entry->prev;
+		}
+		else
+		{
+			s->newest = entry->prev;
+		}
+		entry->prev = nullptr;
+		entry->next = nullptr;
+	}
 };
 
 }  // namespace spectatord
@@ -0,0 +1,84 @@
+#include "expiring_cache.h"
+#include "gtest/gtest.h"
+#include "../spectator/test_utils.h"
+
+namespace
+{
+using spectatord::expiring_cache;
+
+int64_t fake_now = 0;
+int supplied = 0;
+
+int64_t fake_clock() { return fake_now; }
+
+std::unique_ptr<spectator::Id> supply_id(spectator::Registry* /* registry */, spectator::Id id)
+{
+	++supplied;
+	return std::make_unique<spectator::Id>(std::move(id));
+}
+
+using cache_t = expiring_cache<spectator::Id>;
+
+TEST(ExpiringCache, GetOrCreate)
+{
+	fake_now = 1000;
+	supplied = 0;
+	cache_t cache{supply_id, fake_clock};
+	auto* foo = cache.get_or_create(nullptr, spectator::Id::Of("foo"));
+	EXPECT_EQ(*foo, spectator::Id::Of("foo"));
+	EXPECT_EQ(cache.get_or_create(nullptr, spectator::Id::Of("foo")), foo);
+	EXPECT_NE(cache.get_or_create(nullptr, spectator::Id::Of("bar")), foo);
+	EXPECT_EQ(supplied, 2);
+}
+
+TEST(ExpiringCache, Expire)
+{
+	fake_now = 1000;
+	cache_t cache{supply_id, fake_clock};
+	for (auto i = 0; i < 100; ++i)
+	{
+		cache.get_or_create(nullptr, spectator::Id::Of(fmt::format("id.{}", i)));
+	}
+
+	// keep using the even ones
+	auto last_used = fake_now;
+	for (auto t = 1; t <= 6; ++t)
+	{
+		last_used = 1000 + t * cache_t::kExpireAfter / 6;
+		fake_now = last_used;
+		for (auto i = 0; i < 100; i += 2)
+		{
+			cache.get_or_create(nullptr, spectator::Id::Of(fmt::format("id.{}", i)));
+		}
+	}
+	fake_now += cache_t::kTouchInterval;
+	auto result = cache.expire();
+	EXPECT_EQ(result.first, 100);
+	EXPECT_EQ(result.second, 50);
+
+	result = cache.expire();
+	EXPECT_EQ(result.first, 50);
+	EXPECT_EQ(result.second, 0);
+
+	// the remaining ones expire after being idle for long enough
+	fake_now = last_used + cache_t::kExpireAfter;
+	EXPECT_EQ(cache.expire().second, 0);
+	fake_now += 1;
+	EXPECT_EQ(cache.expire().second, 50);
+	EXPECT_EQ(cache.expire().first, 0);
+}
+
+TEST(ExpiringCache, TouchedOnlyAfterInterval)
+{
+	fake_now = 1000;
+	cache_t cache{supply_id, fake_clock};
+	auto id = spectator::Id::Of("foo");
+	cache.get_or_create(nullptr, id);
+
+	// used again before the touch interval elapsed, so it still expires from the first use
+	fake_now += cache_t::kTouchInterval - 1;
+	cache.get_or_create(nullptr, id);
+	fake_now = 1000 + cache_t::kExpireAfter + 1;
+	EXPECT_EQ(cache.expire().second, 1);
+}
+}  // namespace
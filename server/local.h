@@ -3,5 +3,6 @@
 namespace spectatord {
 
 static constexpr auto kSocketNameDgram = "/run/spectatord/spectatord.unix";
+static constexpr auto kShmRingPath = "/run/spectatord/spectatord.shm";
 
 }  // namespace spectatord
\ No newline at end of file
@@ -10,7 +10,35 @@ LocalServer::LocalServer(asio::io_context& io_context, std::string_view path, ha
 {
 }
 
-void LocalServer::Start() { start_local_receive(); }
+void LocalServer::Start(size_t batch_size)
+{
+	if (batch_size > 1)
+	{
+		batch_receiver_ = std::make_unique<BatchReceiver>(batch_size);
+		start_batch_receive();
+	}
+	else
+	{
+		start_local_receive();
+	}
+}
+
+void LocalServer::start_batch_receive()
+{
+	socket_.async_wait(asio::socket_base::wait_read,
+	                   [this](const std::error_code& err)
+	                   {
+		                   if (err)
+		                   {
+			                   Logger()->error("Error waiting to receive: {}: {}", err.value(), err.message());
+		                   }
+		                   else
+		                   {
+			                   batch_receiver_->Dispatch(socket_.native_handle(), handler_);
+		                   }
+		                   start_batch_receive();
+	                   });
+}
 
 void LocalServer::start_local_receive()
 {
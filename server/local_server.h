@@ -1,7 +1,9 @@
 #pragma once
 
+#include "batch_receiver.h"
 #include "handler.h"
 #include <asio.hpp>
+#include <memory>
 
 namespace spectatord
 {
@@ -11,13 +13,17 @@ class LocalServer
    public:
 	// NOLINTNEXTLINE(google-runtime-references)
 	LocalServer(asio::io_context& io_context, std::string_view path, handler_t handler);
-	void Start();
+	// Start receiving datagrams. With a batch_size greater than 1, up to batch_size datagrams
+	// are read with a single recvmmsg call every time the socket becomes readable
+	void Start(size_t batch_size = 1);
 
    private:
 	handler_t handler_;
 	asio::local::datagram_protocol::socket socket_;
 	std::array<char, 65536> recv_buffer_{};
+	std::unique_ptr<BatchReceiver> batch_receiver_;
 	void start_local_receive();
+	void start_batch_receive();
 };
 
 }  // namespace spectatord
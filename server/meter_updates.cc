@@ -0,0 +1,71 @@
+#include "meter_updates.h"
+
+namespace spectatord
+{
+
+template <typename Table, typename T>
+static void merge_into(Table* table, spectator::Id id, const T& totals)
+{
+	(*table)[std::move(id)].merge(totals);
+}
+
+void meter_updates::add_counter(spectator::Id id, double delta)
+{
+	// negative deltas are ignored by the counter
+	merge_into(&counters_, std::move(id), detail::counter_totals{delta < 0 ? 0.0 : delta});
+}
+
+void meter_updates::record_timer(spectator::Id id, int64_t nanos, int64_t count)
+{
+	detail::dist_totals<int64_t> totals;
+	if (nanos >= 0 && count > 0)
+	{
+		totals = {count, nanos * count, static_cast<double>(nanos) * nanos * count, nanos};
+	}
+	merge_into(&timers_, std::move(id), totals);
+}
+
+void meter_updates::record_dist_summary(spectator::Id id, double amount, int64_t count)
+{
+	detail::dist_totals<double> totals;
+	if (amount >= 0 && count > 0)
+	{
+		totals = {count, amount * count, amount * amount * count, amount};
+	}
+	merge_into(&dist_summaries_, std::move(id), totals);
+}
+
+void meter_updates::update_max_gauge(spectator::Id id, double value)
+{
+	merge_into(&max_gauges_, std::move(id), detail::max_totals{value});
+}
+
+// meters are still created, and their timestamps refreshed, for updates that were
+// ignored, the same as when the updates are applied one at a time
+void meter_updates::apply(spectator::Registry* registry)
+{
+	for (const auto& kv : counters_)
+	{
+		registry->GetCounter(kv.first)->Add(kv.second.delta);
+	}
+	for (const auto& kv : timers_)
+	{
+		const auto& t = kv.second;
+		registry->GetTimer(kv.first)->RecordTotals(t.count, t.total, t.total_sq, t.max);
+	}
+	for (const auto& kv : dist_summaries_)
+	{
+		const auto& t = kv.second;
+		registry->GetDistributionSummary(kv.first)->RecordTotals(t.count, t.total, t.total_sq, t.max);
+	}
+	for (const auto& kv : max_gauges_)
+	{
+		registry->GetMaxGauge(kv.first)->Update(kv.second.max);
+	}
+	counters_.clear();
+	timers_.clear();
+	dist_summaries_.clear();
+	max_gauges_.clear();
+}
+
+}  // namespace spectatord
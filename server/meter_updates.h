@@ -0,0 +1,83 @@
+#pragma once
+
+#include "../spectator/registry.h"
+#include <tsl/hopscotch_map.h>
+
+namespace spectatord
+{
+
+namespace detail
+{
+struct counter_totals
+{
+	double delta = 0.0;
+
+	void merge(const counter_totals& other) noexcept { delta += other.delta; }
+};
+
+template <typename T>
+struct dist_totals
+{
+	int64_t count = 0;
+	T total{};
+	double total_sq = 0.0;
+	T max{};
+
+	void merge(const dist_totals& other) noexcept
+	{
+		count += other.count;
+		total += other.total;
+		total_sq += other.total_sq;
+		if (other.max > max)
+		{
+			max = other.max;
+		}
+	}
+};
+
+struct max_totals
+{
+	double max = std::numeric_limits<double>::lowest();
+
+	void merge(const max_totals& other) noexcept
+	{
+		// like MaxGauge::Update, a NaN never replaces the current value
+		if (other.max > max)
+		{
+			max = other.max;
+		}
+	}
+};
+}  // namespace detail
+
+// Updates parsed from a single buffer, added up per meter, so lines updating the same meter
+// only look it up in the registry, and touch its atomics, once when the buffer is applied.
+// Each update is checked the same way the meter would check it, so applying them leaves
+// the registry as if every line had been applied on its own.
+class meter_updates
+{
+   public:
+	void add_counter(spectator::Id id, double delta);
+	void record_timer(spectator::Id id, int64_t nanos, int64_t count);
+	void record_dist_summary(spectator::Id id, double amount, int64_t count);
+	void update_max_gauge(spectator::Id id, double value);
+
+	// apply the updates to the registry, and start again from an empty set
+	void apply(spectator::Registry* registry);
+
+	[[nodiscard]] auto empty() const noexcept -> bool
+	{
+		return counters_.empty() && timers_.empty() && dist_summaries_.empty() && max_gauges_.empty();
+	}
+
+   private:
+	template <typename T>
+	using table_t = tsl::hopscotch_map<spectator::Id, T>;
+
+	table_t<detail::counter_totals> counters_;
+	table_t<detail::dist_totals<int64_t>> timers_;
+	table_t<detail::dist_totals<double>> dist_summaries_;
+	table_t<detail::max_totals> max_gauges_;
+};
+
+}  // namespace spectatord
@@ -1,6 +1,8 @@
 #include "proc_utils.h"
 #include "../util/files.h"
 #include <fcntl.h>
+#include <pthread.h>
+#include <thread>
 #include <unistd.h>
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_split.h"
@@ -50,10 +52,12 @@ auto udp_info(int port, const char* proc_file) -> std::optional<udp_info_t>
 	if (udp == nullptr) return {};
 
 	udp_info_t res{};
+	auto found = false;
 	char line[4096];
 	// discard header
 	if (fgets(line, sizeof line, udp) == nullptr) return {};
 
+	// when the port is shared using SO_REUSEPORT there is one entry per socket
 	while (fgets(line, sizeof line, udp) != nullptr)
 	{
 		std::vector<std::string> fields = absl::StrSplit(line, absl::ByAnyChar(" :\n"), absl::SkipEmpty());
@@ -61,11 +65,28 @@ auto udp_info(int port, const char* proc_file) -> std::optional<udp_info_t>
 		auto cur_port = strtol(fields[2].c_str(), nullptr, 16);
 		if (port != cur_port) continue;
 
-		res.rx_queue_bytes = strtoul(fields[7].c_str(), nullptr, 16);
-		res.num_dropped = strtoul(fields[16].c_str(), nullptr, 10);
-		return res;
+		res.rx_queue_bytes += strtoul(fields[7].c_str(), nullptr, 16);
+		res.num_dropped += strtoul(fields[16].c_str(), nullptr, 10);
+		found = true;
 	}
-	return {};
+	if (!found) return {};
+	return res;
+}
+
+auto pin_thread_to_cpu(size_t cpu) -> bool
+{
+#ifdef __linux__
+	auto num_cpus = std::thread::hardware_concurrency();
+	if (num_cpus == 0) return false;
+
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(cpu % num_cpus, &cpu_set);
+	return pthread_setaffinity_np(pthread_self(), sizeof cpu_set, &cpu_set) == 0;
+#else
+	(void)cpu;
+	return false;
+#endif
 }
 
 }  // namespace spectatord
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <optional>
 
@@ -16,6 +17,11 @@ struct udp_info_t
 	int64_t rx_queue_bytes;
 };
 
+// get the stats for a port, adding up all sockets bound to it
 std::optional<udp_info_t> udp_info(int port, const char* proc_file = "/proc/net/udp");
 
+// pin the calling thread to the given cpu (modulo the number of cpus). Returns false when
+// not supported by the platform, or if the affinity could not be set
+bool pin_thread_to_cpu(size_t cpu);
+
 }  // namespace spectatord
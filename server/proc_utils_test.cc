@@ -37,4 +37,13 @@ TEST(ProcUtils, udp_info)
 	res = udp_info(1234, "/does-not-exist-dir/does-not-exist-file");
 	ASSERT_FALSE(res.has_value());
 }
+
+TEST(ProcUtils, udp_info_reuse_port)
+{
+	// multiple sockets bound to the same port
+	auto res = udp_info(1234, "test-resources/net_udp_2");
+	ASSERT_TRUE(res.has_value());
+	EXPECT_EQ(res->num_dropped, 123);
+	EXPECT_EQ(res->rx_queue_bytes, 0x300);
+}
 }  // namespace
@@ -0,0 +1,347 @@
+#include "shm_ring.h"
+#include "../util/logger.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace spectatord
+{
+
+namespace detail
+{
+static constexpr uint64_t kMagic = 0x53504543524e4731;  // SPECRNG1
+static constexpr uint32_t kVersion = 1;
+static constexpr size_t kCacheLine = 64;
+static constexpr size_t kHeaderSize = 4 * kCacheLine;
+
+// the state of a slot is its position in the ring times 4 plus one of these
+static constexpr uint64_t kFree = 0;
+static constexpr uint64_t kWriting = 1;
+static constexpr uint64_t kReady = 2;
+// abandoned by the reader: never used again, since the writer that claimed it could
+// still write into it at any time. Carries the next position it is skipped at
+static constexpr uint64_t kDead = 3;
+
+static constexpr auto state_of(uint64_t pos, uint64_t tag) noexcept -> uint64_t { return pos * 4 + tag; }
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "the ring is shared between processes, which needs lock free atomics");
+
+struct ring_header
+{
+	uint64_t magic;
+	uint32_t version;
+	uint32_t slots;
+	uint32_t slot_size;
+	std::atomic<uint32_t> closed;
+	// the next position writers will claim
+	alignas(kCacheLine) std::atomic<uint64_t> tail;
+	alignas(kCacheLine) std::atomic<uint64_t> dropped;
+};
+static_assert(sizeof(ring_header) <= kHeaderSize);
+
+struct ring_slot
+{
+	std::atomic<uint64_t> state;
+	std::atomic<uint32_t> size;
+	uint32_t unused;
+	char data[1];
+};
+static constexpr size_t kSlotOverhead = offsetof(ring_slot, data);
+}  // namespace detail
+
+using detail::kDead;
+using detail::kFree;
+using detail::kReady;
+using detail::kWriting;
+using detail::state_of;
+
+ShmRing::ShmRing(std::string path, int fd, void* base, size_t size) noexcept
+    : path_{std::move(path)},
+      fd_{fd},
+      base_{base},
+      size_{size},
+      header_{static_cast<detail::ring_header*>(base)},
+      slots_{header_->slots},
+      slot_size_{header_->slot_size}
+{
+}
+
+ShmRing::~ShmRing()
+{
+	::munmap(base_, size_);
+	::close(fd_);
+}
+
+auto ShmRing::Create(const std::string& path, size_t slots, size_t slot_size) -> std::unique_ptr<ShmRing>
+{
+	slots = std::max(slots, size_t{1});
+	slot_size = std::max(slot_size, detail::kSlotOverhead + 1);
+	slot_size = (slot_size + detail::kCacheLine - 1) / detail::kCacheLine * detail::kCacheLine;
+	auto size = detail::kHeaderSize + slots * slot_size;
+
+	// set up the ring in a new file, and then move it in place, so writers never see
+	// one that is not ready
+	auto tmp_path = path + ".tmp";
+	::unlink(tmp_path.c_str());
+	auto fd = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+	if (fd < 0)
+	{
+		Logger()->error("Unable to create {}: {}", tmp_path, strerror(errno));
+		return {};
+	}
+	// any user can write metrics, like with the unix domain socket
+	if (::fchmod(fd, 0666) != 0 || ::ftruncate(fd, static_cast<off_t>(size)) != 0)
+	{
+		Logger()->error("Unable to set up {}: {}", tmp_path, strerror(errno));
+		::close(fd);
+		::unlink(tmp_path.c_str());
+		return {};
+	}
+	auto* base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED)
+	{
+		Logger()->error("Unable to map {}: {}", tmp_path, strerror(errno));
+		::close(fd);
+		::unlink(tmp_path.c_str());
+		return {};
+	}
+
+	// the file starts zeroed, so only the fields that are not zero need to be set
+	auto* header = static_cast<detail::ring_header*>(base);
+	header->slots = static_cast<uint32_t>(slots);
+	header->slot_size = static_cast<uint32_t>(slot_size);
+	std::unique_ptr<ShmRing> ring{new ShmRing{path, fd, base, size}};
+	for (uint64_t pos = 0; pos < slots; ++pos)
+	{
+		ring->slot_at(pos)->state.store(state_of(pos, kFree), std::memory_order_relaxed);
+	}
+	header->version = detail::kVersion;
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = detail::kMagic;
+
+	if (::rename(tmp_path.c_str(), path.c_str()) != 0)
+	{
+		Logger()->error("Unable to move {} to {}: {}", tmp_path, path, strerror(errno));
+		::unlink(tmp_path.c_str());
+		return {};
+	}
+	return ring;
+}
+
+auto ShmRing::Open(const std::string& path) -> std::unique_ptr<ShmRing>
+{
+	auto fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return {};
+	}
+	struct stat st
+	{
+	};
+	if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < detail::kHeaderSize)
+	{
+		::close(fd);
+		return {};
+	}
+	auto size = static_cast<size_t>(st.st_size);
+	auto* base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED)
+	{
+		::close(fd);
+		return {};
+	}
+	auto* header = static_cast<detail::ring_header*>(base);
+	auto valid = header->magic == detail::kMagic && header->version == detail::kVersion && header->slots > 0 &&
+	             header->slot_size > detail::kSlotOverhead &&
+	             detail::kHeaderSize + size_t{header->slots} * header->slot_size == size;
+	if (!valid)
+	{
+		::munmap(base, size);
+		::close(fd);
+		return {};
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return std::unique_ptr<ShmRing>{new ShmRing{path, fd, base, size}};
+}
+
+auto ShmRing::slot_at(uint64_t pos) const noexcept -> detail::ring_slot*
+{
+	auto offset = detail::kHeaderSize + (pos % slots_) * slot_size_;
+	return reinterpret_cast<detail::ring_slot*>(static_cast<char*>(base_) + offset);
+}
+
+auto ShmRing::MaxMessageSize() const -> size_t { return slot_size_ - detail::kSlotOverhead; }
+
+auto ShmRing::Dropped() const -> uint64_t { return header_->dropped.load(std::memory_order_relaxed); }
+
+auto ShmRing::Reserve() -> std::optional<Reservation>
+{
+	if (header_->closed.load(std::memory_order_relaxed) != 0)
+	{
+		return {};
+	}
+
+	auto pos = header_->tail.load(std::memory_order_relaxed);
+	detail::ring_slot* slot = nullptr;
+	uint64_t skipped = 0;
+	for (;;)
+	{
+		slot = slot_at(pos);
+		auto state = slot->state.load(std::memory_order_acquire);
+		auto free = state_of(pos, kFree);
+		if (state == free)
+		{
+			if (header_->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (state == state_of(pos, kDead))
+		{
+			// move past it, the reader skips it once the tail is beyond it
+			if (++skipped > slots_)
+			{
+				// every slot was abandoned
+				header_->dropped.fetch_add(1, std::memory_order_relaxed);
+				return {};
+			}
+			header_->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed);
+			pos = header_->tail.load(std::memory_order_relaxed);
+		}
+		else if (state < free)
+		{
+			// the reader has not freed the slot from the previous lap yet
+			header_->dropped.fetch_add(1, std::memory_order_relaxed);
+			return {};
+		}
+		else
+		{
+			// another writer claimed it
+			pos = header_->tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	// the reader could have given up on the slot since we claimed the position
+	auto expected = state_of(pos, kFree);
+	if (!slot->state.compare_exchange_strong(expected, state_of(pos, kWriting), std::memory_order_acquire))
+	{
+		return {};
+	}
+	return Reservation{slot->data, MaxMessageSize(), pos};
+}
+
+auto ShmRing::Commit(const Reservation& reservation, size_t size) -> bool
+{
+	auto* slot = slot_at(reservation.pos);
+	slot->size.store(static_cast<uint32_t>(std::min(size, reservation.capacity)), std::memory_order_relaxed);
+	auto expected = state_of(reservation.pos, kWriting);
+	return slot->state.compare_exchange_strong(expected, state_of(reservation.pos, kReady),
+	                                           std::memory_order_release);
+}
+
+auto ShmRing::Write(std::string_view message) -> bool
+{
+	if (message.size() > MaxMessageSize())
+	{
+		return false;
+	}
+	auto reservation = Reserve();
+	if (!reservation)
+	{
+		return false;
+	}
+	std::memcpy(reservation->data, message.data(), message.size());
+	return Commit(*reservation, message.size());
+}
+
+auto ShmRing::Drain(const handler_t& handler, int64_t now_nanos) -> size_t
+{
+	size_t read = 0;
+	auto max_size = MaxMessageSize();
+	buffer_.resize(max_size + 1);
+	// stop after a lap, so writers that keep up with the reader do not keep it here forever
+	auto end = head_ + slots_;
+	while (head_ < end)
+	{
+		auto* slot = slot_at(head_);
+		auto state = slot->state.load(std::memory_order_acquire);
+		if (state == state_of(head_, kReady))
+		{
+			// copy the message out, so writers can reuse the slot while we parse it
+			auto size = std::min(size_t{slot->size.load(std::memory_order_relaxed)}, max_size);
+			std::memcpy(buffer_.data(), slot->data, size);
+			buffer_[size] = '\0';
+			slot->state.store(state_of(head_ + slots_, kFree), std::memory_order_release);
+			++head_;
+			stuck_since_.reset();
+			if (size > 0)
+			{
+				handler(buffer_.data());
+				++read;
+			}
+			continue;
+		}
+
+		if (header_->tail.load(std::memory_order_acquire) <= head_)
+		{
+			// nothing was claimed past the head
+			break;
+		}
+		if (state == state_of(head_, kDead))
+		{
+			// writers moved past an abandoned slot, it is skipped again on the next lap
+			slot->state.store(state_of(head_ + slots_, kDead), std::memory_order_release);
+			++head_;
+			continue;
+		}
+		// a writer claimed the slot but has not finished writing it
+		if (!stuck_since_)
+		{
+			stuck_since_ = now_nanos;
+		}
+		if (now_nanos - *stuck_since_ < kStuckTimeout)
+		{
+			break;
+		}
+		if (slot->state.compare_exchange_strong(state, state_of(head_ + slots_, kDead),
+		                                        std::memory_order_acq_rel))
+		{
+			Logger()->info("Giving up on slot {} of {}, not written after {}ms, it will not be used again",
+			               head_ % slots_, path_, kStuckTimeout / 1000000);
+			++head_;
+			++abandoned_;
+			stuck_since_.reset();
+		}
+		// otherwise the writer just finished, and it will be read on the next iteration
+	}
+	return read;
+}
+
+void ShmRing::Close() { header_->closed.store(1, std::memory_order_relaxed); }
+
+auto ShmRing::Stale() const -> bool
+{
+	if (header_->closed.load(std::memory_order_relaxed) != 0)
+	{
+		return true;
+	}
+	struct stat current
+	{
+	};
+	struct stat mapped
+	{
+	};
+	if (::stat(path_.c_str(), &current) != 0 || ::fstat(fd_, &mapped) != 0)
+	{
+		return true;
+	}
+	return current.st_ino != mapped.st_ino || current.st_dev != mapped.st_dev;
+}
+
+}  // namespace spectatord
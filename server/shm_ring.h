@@ -0,0 +1,111 @@
+#pragma once
+
+#include "handler.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace spectatord
+{
+
+namespace detail
+{
+struct ring_header;
+struct ring_slot;
+}  // namespace detail
+
+// A ring of fixed size slots in a file mapped in memory by spectatord and by co-located
+// clients, which write protocol messages into it without a syscall or a copy in the kernel.
+// Any number of processes can write to the ring, and a single spectatord worker drains it.
+//
+// Each slot goes from free to writing to ready and back to free, and its state is kept next
+// to the position in the ring it was claimed for, so a writer can only complete the slot it
+// claimed. A writer that crashes, or stalls, after claiming a slot would block the reader, so
+// the reader gives up on slots that are not ready after a timeout. The writer could come back
+// and write into the slot at any time, so an abandoned slot is never handed out again, and
+// writers and the reader skip it until the ring is created again. The late writer finds out
+// when it tries to mark the slot as ready, and its message is dropped.
+class ShmRing
+{
+   public:
+	static constexpr size_t kDefaultSlots = 4096;
+	static constexpr size_t kDefaultSlotSize = 1024;
+	static constexpr int64_t kStuckTimeout = 1000L * 1000 * 1000;
+
+	// a slot claimed by Reserve, to be filled with a message of up to capacity bytes
+	struct Reservation
+	{
+		char* data;
+		size_t capacity;
+		uint64_t pos;
+	};
+
+	// Create a new ring at path, replacing any previous one, which writers will see as
+	// stale. The size of the slots is rounded up to a multiple of the cache line size.
+	// Returns nullptr when the file can not be created
+	static auto Create(const std::string& path, size_t slots = kDefaultSlots, size_t slot_size = kDefaultSlotSize)
+	    -> std::unique_ptr<ShmRing>;
+
+	// Open a ring created by spectatord, to write to it. Returns nullptr when the file
+	// does not exist, or is not a ring
+	static auto Open(const std::string& path) -> std::unique_ptr<ShmRing>;
+
+	ShmRing(const ShmRing&) = delete;
+	ShmRing(ShmRing&&) = delete;
+	auto operator=(const ShmRing&) -> ShmRing& = delete;
+	auto operator=(ShmRing&&) -> ShmRing& = delete;
+	~ShmRing();
+
+	// Copy a message with one or more lines into the ring. Returns false, dropping the
+	// message, when it is larger than MaxMessageSize, the ring is full, or it was closed
+	auto Write(std::string_view message) -> bool;
+
+	// Write in two steps, so the message can be formatted in place. Commit returns false
+	// when the reader gave up on the slot before it was committed
+	auto Reserve() -> std::optional<Reservation>;
+	auto Commit(const Reservation& reservation, size_t size) -> bool;
+
+	// Pass each ready message, terminated with a '\0', to the handler, giving up on slots
+	// claimed more than kStuckTimeout before now. Reads at most one lap of the ring.
+	// Returns the number of messages read
+	auto Drain(const handler_t& handler, int64_t now_nanos) -> size_t;
+
+	// Tell writers to stop using the ring
+	void Close();
+
+	// Whether the ring was closed, or replaced by a new one, and should be opened again.
+	// It looks at the file with a couple of syscalls, so writers should only check it
+	// every now and then
+	[[nodiscard]] auto Stale() const -> bool;
+
+	[[nodiscard]] auto MaxMessageSize() const -> size_t;
+	// messages dropped by writers because the ring was full
+	[[nodiscard]] auto Dropped() const -> uint64_t;
+	// slots the reader gave up on, which are not used again
+	[[nodiscard]] auto Abandoned() const -> uint64_t { return abandoned_; }
+
+   private:
+	ShmRing(std::string path, int fd, void* base, size_t size) noexcept;
+
+	std::string path_;
+	int fd_;
+	void* base_;
+	size_t size_;
+	detail::ring_header* header_;
+	// any user can write to the file, so the layout is only read once it has been checked
+	uint64_t slots_;
+	size_t slot_size_;
+	// reader state
+	uint64_t head_ = 0;
+	std::optional<int64_t> stuck_since_;
+	uint64_t abandoned_ = 0;
+	std::vector<char> buffer_;
+
+	auto slot_at(uint64_t pos) const noexcept -> detail::ring_slot*;
+};
+
+}  // namespace spectatord
@@ -0,0 +1,249 @@
+#include "shm_ring.h"
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+using spectatord::ShmRing;
+
+auto ring_path(const char* name) -> std::string
+{
+	return fmt::format("{}spectatord-{}-{}.shm", testing::TempDir(), name, getpid());
+}
+
+// drain the ring, returning the messages read
+auto drain(ShmRing* ring, int64_t now = 0) -> std::vector<std::string>
+{
+	std::vector<std::string> messages;
+	ring->Drain(
+	    [&messages](char* message) -> std::optional<std::string>
+	    {
+		    messages.emplace_back(message);
+		    return {};
+	    },
+	    now);
+	return messages;
+}
+
+TEST(ShmRing, WriteAndDrain)
+{
+	auto path = ring_path("write");
+	auto reader = ShmRing::Create(path, 8, 128);
+	ASSERT_TRUE(reader);
+	auto writer = ShmRing::Open(path);
+	ASSERT_TRUE(writer);
+	EXPECT_EQ(writer->MaxMessageSize(), reader->MaxMessageSize());
+
+	// go around the ring a few times
+	for (auto i = 0; i < 5; ++i)
+	{
+		EXPECT_TRUE(writer->Write(fmt::format("c:counter,id={}:1", i)));
+		EXPECT_TRUE(writer->Write("c:other:1\nc:other:2"));
+		auto messages = drain(reader.get());
+		ASSERT_EQ(messages.size(), 2);
+		EXPECT_EQ(messages[0], fmt::format("c:counter,id={}:1", i));
+		EXPECT_EQ(messages[1], "c:other:1\nc:other:2");
+	}
+	EXPECT_TRUE(drain(reader.get()).empty());
+	::unlink(path.c_str());
+}
+
+TEST(ShmRing, Full)
+{
+	auto path = ring_path("full");
+	auto ring = ShmRing::Create(path, 4, 64);
+	ASSERT_TRUE(ring);
+	for (auto i = 0; i < 4; ++i)
+	{
+		EXPECT_TRUE(ring->Write("c:counter:1"));
+	}
+	EXPECT_FALSE(ring->Write("c:counter:1"));
+	EXPECT_EQ(ring->Dropped(), 1);
+	EXPECT_EQ(drain(ring.get()).size(), 4);
+	EXPECT_TRUE(ring->Write("c:counter:1"));
+
+	// messages that do not fit in a slot are rejected
+	std::string too_big(ring->MaxMessageSize() + 1, 'x');
+	EXPECT_FALSE(ring->Write(too_big));
+	EXPECT_EQ(drain(ring.get()).size(), 1);
+	::unlink(path.c_str());
+}
+
+TEST(ShmRing, AbandonStuckSlots)
+{
+	auto path = ring_path("stuck");
+	auto ring = ShmRing::Create(path, 4, 64);
+	ASSERT_TRUE(ring);
+
+	// a writer that claims a slot and never commits it, like when it crashes
+	auto stuck = ring->Reserve();
+	ASSERT_TRUE(stuck);
+	EXPECT_TRUE(ring->Write("c:after:1"));
+
+	// the reader waits a while for the writer before giving up on its slot
+	EXPECT_TRUE(drain(ring.get(), 1000).empty());
+	EXPECT_TRUE(drain(ring.get(), 1000 + ShmRing::kStuckTimeout - 1).empty());
+	auto messages = drain(ring.get(), 1000 + ShmRing::kStuckTimeout);
+	ASSERT_EQ(messages.size(), 1);
+	EXPECT_EQ(messages[0], "c:after:1");
+	EXPECT_EQ(ring->Abandoned(), 1);
+
+	// the writer coming back can not commit the slot
+	EXPECT_FALSE(ring->Commit(*stuck, 0));
+
+	// the abandoned slot is skipped from now on
+	for (auto lap = 0; lap < 3; ++lap)
+	{
+		for (auto i = 0; i < 3; ++i)
+		{
+			EXPECT_TRUE(ring->Write(fmt::format("c:counter,id={}:1", i)));
+		}
+		EXPECT_FALSE(ring->Write("c:counter:1"));
+		messages = drain(ring.get());
+		ASSERT_EQ(messages.size(), 3);
+		for (auto i = 0; i < 3; ++i)
+		{
+			EXPECT_EQ(messages[i], fmt::format("c:counter,id={}:1", i));
+		}
+	}
+	EXPECT_EQ(ring->Abandoned(), 1);
+	::unlink(path.c_str());
+}
+
+TEST(ShmRing, LateCommitAfterLaps)
+{
+	auto path = ring_path("late");
+	auto ring = ShmRing::Create(path, 4, 64);
+	ASSERT_TRUE(ring);
+
+	auto stuck = ring->Reserve();
+	ASSERT_TRUE(stuck);
+	EXPECT_TRUE(drain(ring.get(), 0).empty());
+	EXPECT_TRUE(drain(ring.get(), ShmRing::kStuckTimeout).empty());
+	EXPECT_EQ(ring->Abandoned(), 1);
+
+	// other writers go around the ring a few times, and leave messages in it
+	for (auto i = 0; i < 10; ++i)
+	{
+		EXPECT_TRUE(ring->Write(fmt::format("c:counter,id={}:1", i)));
+		EXPECT_EQ(drain(ring.get()).size(), 1);
+	}
+	EXPECT_TRUE(ring->Write("c:first:1"));
+	EXPECT_TRUE(ring->Write("c:second:1"));
+
+	// the stalled writer wakes up and finishes writing its message
+	std::string late(stuck->capacity, 'x');
+	std::memcpy(stuck->data, late.data(), late.size());
+	EXPECT_FALSE(ring->Commit(*stuck, late.size()));
+
+	auto messages = drain(ring.get());
+	ASSERT_EQ(messages.size(), 2);
+	EXPECT_EQ(messages[0], "c:first:1");
+	EXPECT_EQ(messages[1], "c:second:1");
+	::unlink(path.c_str());
+}
+
+TEST(ShmRing, AllSlotsAbandoned)
+{
+	auto path = ring_path("abandoned");
+	auto ring = ShmRing::Create(path, 2, 64);
+	ASSERT_TRUE(ring);
+	ASSERT_TRUE(ring->Reserve());
+	ASSERT_TRUE(ring->Reserve());
+	EXPECT_TRUE(drain(ring.get(), 0).empty());
+	EXPECT_TRUE(drain(ring.get(), ShmRing::kStuckTimeout).empty());
+	EXPECT_TRUE(drain(ring.get(), 2 * ShmRing::kStuckTimeout).empty());
+	EXPECT_EQ(ring->Abandoned(), 2);
+
+	// writers give up instead of looking for a free slot forever
+	EXPECT_FALSE(ring->Write("c:counter:1"));
+	EXPECT_TRUE(drain(ring.get()).empty());
+	::unlink(path.c_str());
+}
+
+TEST(ShmRing, Stale)
+{
+	auto path = ring_path("stale");
+	auto first = ShmRing::Create(path, 4, 64);
+	ASSERT_TRUE(first);
+	auto writer = ShmRing::Open(path);
+	ASSERT_TRUE(writer);
+	EXPECT_FALSE(writer->Stale());
+
+	// spectatord restarted
+	auto second = ShmRing::Create(path, 4, 64);
+	ASSERT_TRUE(second);
+	EXPECT_TRUE(writer->Stale());
+	writer = ShmRing::Open(path);
+	EXPECT_FALSE(writer->Stale());
+
+	second->Close();
+	EXPECT_TRUE(writer->Stale());
+	EXPECT_FALSE(writer->Write("c:counter:1"));
+	::unlink(path.c_str());
+}
+
+TEST(ShmRing, OpenInvalid)
+{
+	auto path = ring_path("invalid");
+	EXPECT_FALSE(ShmRing::Open(path));
+	{
+		std::ofstream out{path};
+		out << std::string(4096, 'x');
+	}
+	EXPECT_FALSE(ShmRing::Open(path));
+	::unlink(path.c_str());
+}
+
+TEST(ShmRing, ConcurrentWriters)
+{
+	auto path = ring_path("concurrent");
+	auto reader = ShmRing::Create(path, 64, 64);
+	ASSERT_TRUE(reader);
+
+	constexpr auto kThreads = 4;
+	constexpr auto kMessages = 20000;
+	std::atomic<int> written{0};
+	std::vector<std::thread> writers;
+	for (auto t = 0; t < kThreads; ++t)
+	{
+		writers.emplace_back(
+		    [&path, &written]()
+		    {
+			    auto ring = ShmRing::Open(path);
+			    for (auto i = 0; i < kMessages; ++i)
+			    {
+				    while (!ring->Write("c:counter:1"))
+				    {
+					    std::this_thread::yield();
+				    }
+				    ++written;
+			    }
+		    });
+	}
+
+	size_t read = 0;
+	while (read < kThreads * kMessages)
+	{
+		for (const auto& m : drain(reader.get()))
+		{
+			EXPECT_EQ(m, "c:counter:1");
+			++read;
+		}
+	}
+	for (auto& w : writers)
+	{
+		w.join();
+	}
+	EXPECT_EQ(written.load(), kThreads * kMessages);
+	EXPECT_TRUE(drain(reader.get()).empty());
+	EXPECT_EQ(reader->Abandoned(), 0);
+	::unlink(path.c_str());
+}
+
+}  // namespace
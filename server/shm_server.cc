@@ -0,0 +1,62 @@
+#include "shm_server.h"
+#include "../spectator/coarse_clock.h"
+#include "../util/logger.h"
+
+namespace spectatord
+{
+
+ShmServer::ShmServer(std::unique_ptr<ShmRing> ring, handler_t handler, spectator::Registry* registry)
+    : ring_{std::move(ring)}, handler_{std::move(handler)}, registry_{registry}
+{
+}
+
+void ShmServer::Start() { thread_ = std::thread(&ShmServer::run, this); }
+
+void ShmServer::Stop()
+{
+	if (!should_stop_.exchange(true))
+	{
+		ring_->Close();
+		if (thread_.joinable())
+		{
+			thread_.join();
+		}
+	}
+}
+
+void ShmServer::run()
+{
+	dropped_ = registry_->GetMonotonicCounter("spectatord.shmMessagesDropped");
+	abandoned_ = registry_->GetMonotonicCounter("spectatord.shmSlotsAbandoned");
+	while (!should_stop_)
+	{
+		auto now = spectator::coarse_monotonic_nanos();
+		auto read = ring_->Drain(handler_, now);
+		// messages are dropped when the ring is busy, so this can not wait for it to be empty
+		if (now - stats_updated_ >= kStatsInterval)
+		{
+			update_stats(now);
+		}
+		if (read == 0)
+		{
+			std::this_thread::sleep_for(kIdleSleep);
+		}
+	}
+	// pick up what was written before the ring was closed
+	auto now = spectator::coarse_monotonic_nanos();
+	ring_->Drain(handler_, now);
+	update_stats(now);
+	Logger()->debug("Stopped draining the shared memory ring");
+}
+
+void ShmServer::update_stats(int64_t now)
+{
+	stats_updated_ = now;
+	if (registry_->GetConfig().status_metrics_enabled)
+	{
+		dropped_->Set(static_cast<double>(ring_->Dropped()));
+		abandoned_->Set(static_cast<double>(ring_->Abandoned()));
+	}
+}
+
+}  // namespace spectatord
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "handler.h"
+#include "shm_ring.h"
+#include "../spectator/registry.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace spectatord
+{
+
+// Drains a shared memory ring on its own thread, passing the messages written by the
+// clients to the handler. Writers do not wake up the reader, so when the ring is empty
+// the thread sleeps for kIdleSleep before looking again.
+class ShmServer
+{
+   public:
+	static constexpr auto kIdleSleep = std::chrono::milliseconds{1};
+	// how often the dropped and abandoned counts are copied to the status metrics
+	static constexpr int64_t kStatsInterval = 1000L * 1000 * 1000;
+
+	ShmServer(std::unique_ptr<ShmRing> ring, handler_t handler, spectator::Registry* registry);
+	ShmServer(const ShmServer&) = delete;
+	ShmServer(ShmServer&&) = delete;
+	auto operator=(const ShmServer&) -> ShmServer& = delete;
+	auto operator=(ShmServer&&) -> ShmServer& = delete;
+	~ShmServer() { Stop(); }
+
+	void Start();
+	// close the ring, so writers stop using it, and wait for the thread to finish
+	void Stop();
+
+   private:
+	std::unique_ptr<ShmRing> ring_;
+	handler_t handler_;
+	spectator::Registry* registry_;
+	std::atomic_bool should_stop_{false};
+	std::thread thread_;
+	std::shared_ptr<spectator::MonotonicCounter> dropped_;
+	std::shared_ptr<spectator::MonotonicCounter> abandoned_;
+	int64_t stats_updated_{0};
+
+	void run();
+	void update_stats(int64_t now);
+};
+
+}  // namespace spectatord
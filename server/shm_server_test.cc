@@ -0,0 +1,50 @@
+#include "shm_server.h"
+#include "../spectator/test_utils.h"
+#include "gtest/gtest.h"
+
+#include <fmt/format.h>
+#include <unistd.h>
+
+namespace
+{
+using spectatord::ShmRing;
+using spectatord::ShmServer;
+
+TEST(ShmServer, StatsWhileBusy)
+{
+	spectator::Registry registry{spectator::GetConfiguration(), spectatord::Logger()};
+	auto path = fmt::format("{}spectatord-server-{}.shm", testing::TempDir(), getpid());
+	auto ring = ShmRing::Create(path, 4, 64);
+	ASSERT_TRUE(ring);
+	auto writer = ShmRing::Open(path);
+	ASSERT_TRUE(writer);
+	EXPECT_TRUE(writer->Write("c:counter:1"));
+
+	// every message read writes two more, so the ring is never empty and keeps dropping
+	auto handler = [&writer](char*) -> std::optional<std::string>
+	{
+		writer->Write("c:counter:1");
+		writer->Write("c:counter:1");
+		return {};
+	};
+	ShmServer server{std::move(ring), handler, &registry};
+	server.Start();
+
+	auto dropped = 0.0;
+	for (auto i = 0; i < 100 && dropped == 0.0; ++i)
+	{
+		usleep(50000);  // 50ms
+		for (const auto& m : registry.Measurements())
+		{
+			if (strcmp(m.id.Name().Get(), "spectatord.shmMessagesDropped") == 0)
+			{
+				dropped = m.value;
+			}
+		}
+	}
+	server.Stop();
+	EXPECT_GT(dropped, 0.0);
+	::unlink(path.c_str());
+}
+
+}  // namespace
@@ -1,10 +1,14 @@
 #include "spectatord.h"
 #include "local_server.h"
 #include "proc_utils.h"
+#include "shm_server.h"
 #include "udp_server.h"
 #include "../util/systemd.h"
 
+#include "absl/strings/charconv.h"
 #include <asio.hpp>
+#include <charconv>
+#include <limits>
 
 namespace spectatord
 {
@@ -39,54 +43,129 @@ inline auto add_tag(spectator::Tags* tags, const char* begin_key, const char* en
 	{
 		return false;
 	}
-	tags->add(key, value);
+	tags->add(spectator::intern_reclaimable_str(key), spectator::intern_reclaimable_str(value));
 	return true;
 }
 
-// feed lines into parser
-auto Server::parse_lines(char* buffer, const handler_t& parser) -> std::optional<std::string>
+// locale independent replacement for strtod and strtoull, which only looks at [begin, end).
+// Returns a pointer past the last character used, or begin if no number was found.
+// Like them, values out of range saturate, and negative values wrap around for unsigned types
+template <typename T>
+inline auto parse_number(const char* begin, const char* end, T* value) -> const char*
 {
-	const auto& cfg = registry_->GetConfig();
-
-	char* p = buffer;
-	std::string err_msg;
-	while (*p != '\0')
+	const char* p = begin;
+	while (p < end && std::isspace(static_cast<unsigned char>(*p)) != 0)
+	{
+		++p;
+	}
+	if (p < end && *p == '+')
+	{
+		++p;
+	}
+	if constexpr (std::is_floating_point_v<T>)
 	{
-		char* newline = std::strchr(p, '\n');
-		if (newline != nullptr)
+#if defined(__cpp_lib_to_chars)
+		auto result = std::from_chars(p, end, *value);
+#else
+		// floating point std::from_chars is not available in every standard library
+		auto result = absl::from_chars(p, end, *value);
+#endif
+		if (result.ec == std::errc::invalid_argument)
 		{
-			*newline = '\0';
+			return begin;
 		}
-		auto maybe_err = parser(p);
-		if (maybe_err)
+		if (result.ec == std::errc::result_out_of_range)
 		{
-			if (cfg.status_metrics_enabled)
-			{
-				parse_errors_->Increment();
-			}
-			if (err_msg.empty())
-			{
-				err_msg = *maybe_err;
-			}
-			else
+			// rare enough to let strtod pick between +-HUGE_VAL and a value close to 0
+			std::string number{p, static_cast<size_t>(result.ptr - p)};
+			*value = static_cast<T>(std::strtod(number.c_str(), nullptr));
+		}
+		return result.ptr;
+	}
+	else
+	{
+		auto negative = std::is_unsigned_v<T> && p < end && *p == '-';
+		if (negative)
+		{
+			++p;
+		}
+		auto result = std::from_chars(p, end, *value);
+		if (result.ec == std::errc::invalid_argument)
+		{
+			return begin;
+		}
+		if (result.ec == std::errc::result_out_of_range)
+		{
+			*value = std::numeric_limits<T>::max();
+		}
+		else if (negative)
+		{
+			*value = -*value;
+		}
+		return result.ptr;
+	}
+}
+
+// split the buffer in lines using the delimiters found in a single pass over it, feed them
+// into parser, and apply the updates they coalesced once the whole buffer is parsed
+auto Server::parse_lines(char* buffer, const line_parser_t& parser) -> std::optional<std::string>
+{
+	const auto& cfg = registry_->GetConfig();
+	thread_local meter_updates updates;
+
+	thread_local delimiter_index index;
+	auto size = std::strlen(buffer);
+	index.scan(buffer, size);
+	auto all = index.view(0, size);
+
+	size_t pos = 0;
+	std::string err_msg;
+	int64_t parsed = 0;
+	int64_t errors = 0;
+	while (pos < size)
+	{
+		auto newline = all.find('\n', pos);
+		auto end = newline == delimiters::npos ? size : newline;
+		buffer[end] = '\0';
+		auto err = parser(buffer + pos, index.view(pos, end), &updates);
+		if (err.code != ParseError::None)
+		{
+			++errors;
+			std::string_view line{buffer + pos, end - pos};
+			auto msg = format_parse_error(line, err);
+			Logger()->info("Parse error for '{}': {}", line, msg);
+			if (!err_msg.empty())
 			{
 				err_msg += '\n';
-				err_msg += *maybe_err;
 			}
+			err_msg += msg;
 		}
-		else if (cfg.status_metrics_enabled)
+		else
 		{
-			parsed_count_->Increment();
+			++parsed;
 		}
-		if (newline == nullptr)
+		if (newline == delimiters::npos)
 		{
 			break;
 		}
 		// skip empty lines
-		while (*++newline == '\n')
+		pos = newline + 1;
+		while (buffer[pos] == '\n')
+		{
+			++pos;
+		}
+	}
+	updates.apply(registry_);
+	if (cfg.status_metrics_enabled)
+	{
+		if (parsed > 0)
+		{
+			parsed_count_->Add(static_cast<double>(parsed));
+		}
+		if (errors > 0)
 		{
+			parse_errors_->Add(static_cast<double>(errors));
 		}
-		p = newline;
 	}
 	if (err_msg.empty())
 	{
@@ -96,13 +175,13 @@ auto Server::parse_lines(char* buffer, const handler_t& parser) -> std::optional
 	return err_msg;
 }
 
-static void update_statsd_metric(spectator::Registry* registry, StatsdMetricType type, spectator::Id id, double value,
-                                 double sampling_rate)
+static void update_statsd_metric(spectator::Registry* registry, meter_updates* updates, StatsdMetricType type,
+                                 spectator::Id id, double value, double sampling_rate)
 {
 	switch (type)
 	{
 		case StatsdMetricType::Counter:
-			registry->GetCounter(std::move(id))->Add(value / sampling_rate);
+			updates->add_counter(std::move(id), value / sampling_rate);
 			break;
 		case StatsdMetricType::Gauge:
 			// ignore sampling rate for gauges
@@ -110,23 +189,15 @@ static void update_statsd_metric(spectator::Registry* registry, StatsdMetricType
 			break;
 		case StatsdMetricType::Histogram:
 		{
+			// a sampled value stands for 1 / sampling_rate values
 			auto k = std::lround(1 / sampling_rate);
-			auto hist = registry->GetDistributionSummary(std::move(id));
-			for (auto i = 0; i < k; ++i)
-			{
-				hist->Record(value);
-			}
+			updates->record_dist_summary(std::move(id), value, k);
 			break;
 		}
 		case StatsdMetricType::Timing:
 		{
 			auto k = std::lround(1 / sampling_rate);
-			auto ns = std::chrono::nanoseconds(std::lround(value * 1e6));
-			auto timer = registry->GetTimer(std::move(id));
-			for (auto i = 0; i < k; ++i)
-			{
-				timer->Record(ns);
-			}
+			updates->record_timer(std::move(id), std::lround(value * 1e6), k);
 			break;
 		}
 		case StatsdMetricType::Set:
@@ -156,32 +227,34 @@ static void update_statsd_metric(spectator::Registry* registry, StatsdMetricType
  *                                          country of origin.
  *   users.online:1|c|@0.5|#country:china - Track active China users and use a sample rate.
  */
-auto Server::parse_statsd_line(const char* buffer) -> std::optional<std::string>
+auto Server::parse_statsd_line(const char* buffer, const delimiters& delims, meter_updates* updates) -> parse_error
 {
 	assert(buffer != nullptr);
+	const char* end = buffer + delims.size();
 
 	// get name
-	const char* p = std::strchr(buffer, ':');
-	if (p == nullptr || p == buffer)
+	auto name_end = delims.find(':', 0);
+	if (name_end == delimiters::npos || name_end == 0)
 	{
-		return "Invalid format: name is required";
+		return {ParseError::MissingStatsdName, 0};
 	}
-	std::string_view name{buffer, static_cast<size_t>(p - buffer)};
+	std::string_view name{buffer, name_end};
+	const char* p = buffer + name_end;
 
 	// get value
-	char* last_char = nullptr;
 	++p;
-	auto value = std::strtod(p, &last_char);
+	auto value = 0.0;
+	const char* last_char = parse_number(p, end, &value);
 	if (last_char == p)
 	{
-		return fmt::format("Unable to parse value starting at {}", p);
+		return {ParseError::InvalidStatsdValue, static_cast<size_t>(p - buffer)};
 	}
 
 	p = last_char;
 	StatsdMetricType type;
 	if (*p != '|')
 	{
-		return fmt::format("Invalid format. Expected | starting at {}", p);
+		return {ParseError::MissingStatsdPipe, static_cast<size_t>(p - buffer)};
 	}
 	++p;
 	char char_type = *p;
@@ -203,11 +276,11 @@ auto Server::parse_statsd_line(const char* buffer) -> std::optional<std::string>
 			type = StatsdMetricType::Timing;
 			if (*++p != 's')
 			{
-				return fmt::format("Invalid metric type for {}", buffer);
+				return {ParseError::InvalidStatsdType, static_cast<size_t>(p - buffer)};
 			}
 			break;
 		default:
-			return fmt::format("Invalid type for name {} ({})", name, buffer);
+			return {ParseError::InvalidStatsdType, static_cast<size_t>(p - buffer)};
 	}
 	++p;
 	auto sampling_rate = 1.0;
@@ -219,10 +292,10 @@ auto Server::parse_statsd_line(const char* buffer) -> std::optional<std::string>
 		if (*p == '@')
 		{
 			++p;
-			sampling_rate = std::strtod(p, &last_char);
+			last_char = parse_number(p, end, &sampling_rate);
 			if (last_char == p || sampling_rate <= 0 || sampling_rate > 1)
 			{
-				return fmt::format("Invalid sampling rate for name={}", name);
+				return {ParseError::InvalidSamplingRate, static_cast<size_t>(p - buffer)};
 			}
 			p = last_char;
 			if (*p == '|')
@@ -237,9 +310,11 @@ auto Server::parse_statsd_line(const char* buffer) -> std::optional<std::string>
 			const char* begin_key = p;
 			const char* end_key = nullptr;
 			const char* begin_value = nullptr;
+			// jump to the next ':' or ',' after p, skipping the first character of keys and values
 			while (*p != '\0')
 			{
-				++p;
+				auto next = delims.find_first_of(':', ',', static_cast<size_t>(p - buffer) + 1);
+				p = next == delimiters::npos ? end : buffer + next;
 				if (*p == ':')
 				{
 					end_key = p;
@@ -249,7 +324,7 @@ auto Server::parse_statsd_line(const char* buffer) -> std::optional<std::string>
 				{
 					if (!add_tag(&tags, begin_key, end_key, begin_value, p))
 					{
-						return fmt::format("Invalid tags for name={}", name);
+						return {ParseError::InvalidTags, static_cast<size_t>(begin_key - buffer)};
 					}
 					begin_value = nullptr;
 					begin_key = ++p;
@@ -257,81 +332,135 @@ auto Server::parse_statsd_line(const char* buffer) -> std::optional<std::string>
 			}
 			if (!add_tag(&tags, begin_key, end_key, begin_value, p))
 			{
-				return fmt::format("Invalid tags for name={}", name);
+				return {ParseError::InvalidTags, static_cast<size_t>(begin_key - buffer)};
 			}
 		}
 	}
 
-	spectator::Id id{spectator::intern_str(name), std::move(tags)};
-	update_statsd_metric(registry_, type, std::move(id), value, sampling_rate);
+	spectator::Id id{spectator::intern_reclaimable_str(name), std::move(tags)};
+	update_statsd_metric(registry_, updates, type, std::move(id), value, sampling_rate);
+	return {};
+}
+
+auto format_parse_error(std::string_view line, parse_error err) -> std::string
+{
+	auto rest = line.substr(std::min(err.offset, line.size()));
+	auto name = line.substr(0, line.find(':'));
+	switch (err.code)
+	{
+		case ParseError::None:
+			break;
+		case ParseError::MissingName:
+			return "Missing name";
+		case ParseError::MissingTagValue:
+			return "Missing value";
+		case ParseError::InvalidValue:
+			return "Unable to parse value for measurement";
+		case ParseError::IgnoredChars:
+			return fmt::format("Ignoring chars after the value starting at {}", rest);
+		case ParseError::InvalidTtl:
+			return fmt::format("Invalid ttl specified for gauge at index {}", err.offset);
+		case ParseError::InvalidTimestamp:
+			return fmt::format("Invalid timestamp specified for monotonic sampled source at index {}", err.offset);
+		case ParseError::MissingSeparator:
+			return fmt::format("Expecting separator ':' at index {}", err.offset);
+		case ParseError::UnknownType:
+			return fmt::format("Unknown type: {}", line.substr(0, 1));
+		case ParseError::MissingStatsdName:
+			return "Invalid format: name is required";
+		case ParseError::InvalidStatsdValue:
+			return fmt::format("Unable to parse value starting at {}", rest);
+		case ParseError::MissingStatsdPipe:
+			return fmt::format("Invalid format. Expected | starting at {}", rest);
+		case ParseError::InvalidStatsdType:
+			return fmt::format("Invalid type for name {} ({})", name, line);
+		case ParseError::InvalidSamplingRate:
+			return fmt::format("Invalid sampling rate for name={}", name);
+		case ParseError::InvalidTags:
+			return fmt::format("Invalid tags for name={}", name);
+	}
 	return {};
 }
 
 auto get_measurement(char type, std::string_view measurement_str, std::string* err_msg) -> std::optional<measurement>
+{
+	thread_local delimiter_index index;
+	index.scan(measurement_str.data(), measurement_str.size());
+	parse_error err;
+	auto result = get_measurement(type, measurement_str, index.view(0, measurement_str.size()), &err);
+	if (err.code != ParseError::None)
+	{
+		*err_msg = format_parse_error(measurement_str, err);
+	}
+	return result;
+}
+
+auto get_measurement(char type, std::string_view measurement_str, const delimiters& delims, parse_error* err)
+    -> std::optional<measurement>
 {
 	// get name (tags are specified with , but are optional)
-	auto pos = measurement_str.find_first_of(",:");
+	auto pos = delims.find_first_of(',', ':', 0);
 	if (pos == std::string_view::npos || pos == 0)
 	{
-		*err_msg = "Missing name";
+		*err = {ParseError::MissingName, 0};
 		return {};
 	}
 	auto name = measurement_str.substr(0, pos);
-	spectator::Tags tags{};
 
-	// optionally get tags
+	// optionally get tags. We keep them in a scratch buffer until we know the
+	// line is valid, so we don't intern strings for lines we end up rejecting
+	thread_local std::vector<std::pair<std::string_view, std::string_view>> tag_views;
+	tag_views.clear();
 	if (measurement_str[pos] == ',')
 	{
 		while (measurement_str[pos] != ':')
 		{
 			++pos;
-			auto k_pos = measurement_str.find('=', pos);
+			auto k_pos = delims.find('=', pos);
 			if (k_pos == std::string_view::npos) break;
 			auto key = measurement_str.substr(pos, k_pos - pos);
 			++k_pos;
-			auto v_pos = measurement_str.find_first_of(",:", k_pos);
+			auto v_pos = delims.find_first_of(',', ':', k_pos);
 			if (v_pos == std::string_view::npos)
 			{
-				*err_msg = "Missing value";
+				*err = {ParseError::MissingTagValue, k_pos};
 				return {};
 			}
-			auto val = measurement_str.substr(k_pos, v_pos - k_pos);
-			tags.add(key, val);
+			tag_views.emplace_back(key, measurement_str.substr(k_pos, v_pos - k_pos));
 			pos = v_pos;
 		}
 	}
 
 	++pos;
-	auto value_str = measurement_str.begin() + pos;
-	char* last_char = nullptr;
+	const char* value_str = measurement_str.data() + pos;
+	const char* value_end = measurement_str.data() + measurement_str.size();
+	const char* last_char = nullptr;
 	valueT value{};
 	if (type == 'U')
 	{
-		value.u = std::strtoull(value_str, &last_char, 10);
+		last_char = parse_number(value_str, value_end, &value.u);
 	}
 	else
 	{
-		value.d = std::strtod(value_str, &last_char);
+		last_char = parse_number(value_str, value_end, &value.d);
 	}
 
 	if (last_char == value_str)
 	{
-		*err_msg = "Unable to parse value for measurement";
+		*err = {ParseError::InvalidValue, pos};
 		return {};
 	}
-	if (*last_char != '\0' && std::isspace(*last_char) == 0)
+	if (last_char != value_end && std::isspace(static_cast<unsigned char>(*last_char)) == 0)
 	{
-		if (type == 'U')
-		{
-			*err_msg = fmt::format("Got {} parsing value, ignoring chars starting at {}", value.u, last_char);
-		}
-		else
-		{
-			*err_msg = fmt::format("Got {} parsing value, ignoring chars starting at {}", value.d, last_char);
-		}
+		*err = {ParseError::IgnoredChars, static_cast<size_t>(last_char - measurement_str.data())};
 	}
-	auto name_ref = spectator::intern_str(name);
-	return measurement{spectator::Id{name_ref, tags}, value};
+
+	spectator::Tags tags{};
+	for (const auto& tag : tag_views)
+	{
+		tags.add(spectator::intern_reclaimable_str(tag.first), spectator::intern_reclaimable_str(tag.second));
+	}
+	return measurement{spectator::Id{spectator::intern_reclaimable_str(name), std::move(tags)}, value};
 }
 
 static constexpr auto min_perc_timer = absl::Nanoseconds(1);
@@ -339,23 +468,41 @@ static constexpr auto max_perc_timer = absl::Hours(24);
 static constexpr auto min_ds = std::numeric_limits<int64_t>::min();
 static constexpr auto max_ds = std::numeric_limits<int64_t>::max();
 
+// the percentile caches keep their ids outside of the registry, where reclaiming
+// strings does not look for them, so intern their strings to keep them
+static void keep_strings(const spectator::Id& id)
+{
+	spectator::intern_str(id.Name().Get());
+	for (const auto& tag : id.GetTags())
+	{
+		spectator::intern_str(tag.key.Get());
+		spectator::intern_str(tag.value.Get());
+	}
+}
+
 static auto create_perc_timer(spectator::Registry* registry, spectator::Id id)
 {
+	keep_strings(id);
 	return std::make_unique<spectator::PercentileTimer>(registry, std::move(id), min_perc_timer, max_perc_timer);
 }
 
 static auto create_perc_ds(spectator::Registry* registry, spectator::Id id)
 {
+	keep_strings(id);
 	return std::make_unique<spectator::PercentileDistributionSummary>(registry, std::move(id), min_ds, max_ds);
 }
 
 Server::Server(bool ipv4_only, int port_number, std::optional<int> statsd_port_number,
-               std::optional<std::string> socket_path, spectator::Registry* registry)
+               std::optional<std::string> socket_path, spectator::Registry* registry, size_t num_workers,
+               size_t recv_batch_size, std::optional<std::string> shm_path)
     : ipv4_only_{ipv4_only},
       port_number_{port_number},
       statsd_port_number_{statsd_port_number},
       socket_path_{std::move(socket_path)},
       registry_{registry},
+      num_workers_{std::max(num_workers, size_t{1})},
+      recv_batch_size_{std::max(recv_batch_size, size_t{1})},
+      shm_path_{std::move(shm_path)},
       parsed_count_{registry_->GetCounter("spectatord.parsedCount")},
       parse_errors_{registry_->GetCounter("spectatord.parseErrors")},
       logger_{Logger()},
@@ -382,6 +529,45 @@ static void prepare_socket_path(const std::string& socket_path)
 	umask(0);
 }
 
+// Create the udp servers for a port. Without socket activation, each ingest worker gets its own
+// socket bound with SO_REUSEPORT, so the kernel spreads the datagrams among the workers.
+static auto create_udp_servers(const std::vector<std::unique_ptr<asio::io_context>>& contexts, const char* name,
+                               bool ipv4_only, int port_number, const handler_t& parser, size_t batch_size)
+    -> std::vector<std::unique_ptr<UdpServer>>
+{
+	auto logger = Logger();
+	std::vector<std::unique_ptr<UdpServer>> servers;
+	auto systemd_fd = get_systemd_udp_socket(port_number);
+	if (systemd_fd)
+	{
+		logger->info("Using systemd socket activation for {} server on port {}/udp (fd={})", name, port_number,
+		             *systemd_fd);
+		if (contexts.size() > 1)
+		{
+			logger->info("Socket activation provides a single socket: using one ingest worker for port {}",
+			             port_number);
+		}
+		bool is_ipv6 = is_socket_ipv6(*systemd_fd);
+		servers.emplace_back(std::make_unique<UdpServer>(*contexts.front(), *systemd_fd, is_ipv6, parser));
+	}
+	else
+	{
+		logger->info("Starting {} server on port {}/udp (ipv4_only={}, workers={})", name, port_number, ipv4_only,
+		             contexts.size());
+		auto reuse_port = contexts.size() > 1;
+		for (const auto& io_context : contexts)
+		{
+			servers.emplace_back(
+			    std::make_unique<UdpServer>(*io_context, ipv4_only, port_number, parser, reuse_port));
+		}
+	}
+	for (auto& server : servers)
+	{
+		server->Start(batch_size);
+	}
+	return servers;
+}
+
 void Server::Start()
 {
 	auto logger = Logger();
@@ -395,56 +581,41 @@ void Server::Start()
 	logger->info("Starting janitorial tasks");
 	upkeep_thread_ = std::thread(&Server::upkeep, this);
 
-	asio::io_context io_context;
+	// one event loop per ingest worker, the first one runs on the calling thread
+	std::vector<std::unique_ptr<asio::io_context>> contexts;
+	contexts.reserve(num_workers_);
+	for (size_t i = 0; i < num_workers_; ++i)
+	{
+		contexts.emplace_back(std::make_unique<asio::io_context>(1));
+	}
+	auto& io_context = *contexts.front();
 
 	// stop the server on SIGINT / SIGTERM
 	asio::signal_set signals(io_context, SIGINT, SIGTERM);
 	signals.async_wait(
-	    [&io_context, this](std::error_code /*ec*/, int /*signo*/)
+	    [&contexts, this](std::error_code /*ec*/, int /*signo*/)
 	    {
-		    io_context.stop();
+		    for (auto& ctx : contexts)
+		    {
+			    ctx->stop();
+		    }
 		    this->Stop();
 	    });
 
 	logger->info("Using receive buffer size = {}", max_buffer_size());
-	auto parser = [this](char* buffer) { return this->parse(buffer); };
-
-	// Check for systemd socket activation for the main UDP port
-	std::unique_ptr<UdpServer> udp_server;
-	auto systemd_udp_fd = get_systemd_udp_socket(port_number_);
-	if (systemd_udp_fd)
+	if (recv_batch_size_ > 1)
 	{
-		logger->info("Using systemd socket activation for spectatord server on port {}/udp (fd={})", port_number_,
-		             *systemd_udp_fd);
-		bool is_ipv6 = is_socket_ipv6(*systemd_udp_fd);
-		udp_server = std::make_unique<UdpServer>(io_context, *systemd_udp_fd, is_ipv6, parser);
+		logger->info("Receiving up to {} datagrams per recvmmsg call", recv_batch_size_);
 	}
-	else
-	{
-		logger->info("Starting spectatord server on port {}/udp (ipv4_only={})", port_number_, ipv4_only_);
-		udp_server = std::make_unique<UdpServer>(io_context, ipv4_only_, port_number_, parser);
-	}
-	udp_server->Start();
+	auto parser = [this](char* buffer) { return this->parse(buffer); };
+	auto udp_servers = create_udp_servers(contexts, "spectatord", ipv4_only_, port_number_, parser, recv_batch_size_);
 
-	std::unique_ptr<UdpServer> statsd_server;
+	std::vector<std::unique_ptr<UdpServer>> statsd_servers;
 	if (statsd_port_number_)
 	{
 		auto statsd_parser = [this](char* buffer) { return this->parse_statsd(buffer); };
-		// Check for systemd socket activation for the statsd port
-		auto systemd_statsd_fd = get_systemd_udp_socket(*statsd_port_number_);
-		if (systemd_statsd_fd)
-		{
-			logger->info("Using systemd socket activation for statsd server on port {}/udp (fd={})",
-			             *statsd_port_number_, *systemd_statsd_fd);
-			bool is_ipv6 = is_socket_ipv6(*systemd_statsd_fd);
-			statsd_server = std::make_unique<UdpServer>(io_context, *systemd_statsd_fd, is_ipv6, statsd_parser);
-		}
-		else
-		{
-			logger->info("Starting statsd server on port {}/udp (ipv4_only={})", *statsd_port_number_, ipv4_only_);
-			statsd_server = std::make_unique<UdpServer>(io_context, ipv4_only_, *statsd_port_number_, statsd_parser);
-		}
-		statsd_server->Start();
+		statsd_servers = create_udp_servers(contexts, "statsd", ipv4_only_, *statsd_port_number_, statsd_parser,
+		                                    recv_batch_size_);
 	}
 	else
 	{
@@ -457,19 +628,59 @@ void Server::Start()
 		prepare_socket_path(*socket_path_);
 		local_server = std::make_unique<LocalServer>(io_context, *socket_path_, parser);
 		logger->info("Starting local server (dgram) on socket {}", *socket_path_);
-		local_server->Start();
+		local_server->Start(recv_batch_size_);
 	}
 	else
 	{
 		logger->info("unix socket support is not enabled");
 	}
 
+	std::unique_ptr<ShmServer> shm_server;
+	if (shm_path_)
+	{
+		prepare_socket_path(*shm_path_);
+		auto ring = ShmRing::Create(*shm_path_);
+		if (ring)
+		{
+			logger->info("Starting shared memory ring server on {} ({} slots of up to {} bytes)", *shm_path_,
+			             ShmRing::kDefaultSlots, ring->MaxMessageSize());
+			shm_server = std::make_unique<ShmServer>(std::move(ring), parser, registry_);
+			shm_server->Start();
+		}
+	}
+
 	// Notify systemd that we're ready to accept connections
 	if (sd_notify("READY=1")) {
 	  logger->info("Sent READY=1 notification to systemd");
 	}
 
+	std::vector<std::thread> workers;
+	if (num_workers_ > 1)
+	{
+		logger->info("Starting {} ingest workers", num_workers_);
+		for (size_t i = 1; i < num_workers_; ++i)
+		{
+			workers.emplace_back(
+			    [i, ctx = contexts[i].get()]()
+			    {
+				    if (!pin_thread_to_cpu(i))
+				    {
+					    Logger()->info("Unable to pin ingest worker {} to a cpu", i);
+				    }
+				    ctx->run();
+			    });
+		}
+		if (!pin_thread_to_cpu(0))
+		{
+			logger->info("Unable to pin ingest worker 0 to a cpu");
+		}
+	}
+
 	io_context.run();
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
 }
 
 // This watchdog is removed from the upkeep loop, because there are many instances
@@ -508,6 +719,9 @@ void Server::upkeep()
 
 	static auto pool_hits = registry_->GetMonotonicCounter("spectatord.poolAccess", spectator::Tags{{"id", "hit"}});
 	static auto pool_misses = registry_->GetMonotonicCounter("spectatord.poolAccess", spectator::Tags{{"id", "miss"}});
+	static auto pool_cache_hits =
+	    registry_->GetMonotonicCounter("spectatord.poolAccess", spectator::Tags{{"id", "cache-hit"}});
+	static auto pool_reclaimed = registry_->GetMonotonicCounter("spectatord.poolReclaimed");
 	static auto pool_alloc_size = registry_->GetGauge("spectatord.poolAllocSize");
 	static auto pool_entries = registry_->GetGauge("spectatord.poolEntries");
 
@@ -541,11 +755,14 @@ void Server::upkeep()
 		{
 			pool_hits->Set(pool_stats.hits);
 			pool_misses->Set(pool_stats.misses);
-			pool_alloc_size->Set(pool_stats.alloc_size);
+			pool_cache_hits->Set(pool_stats.cache_hits);
+			pool_reclaimed->Set(pool_stats.reclaimed);
+			pool_alloc_size->Set(pool_stats.arena_size);
 			pool_entries->Set(pool_stats.table_size);
 		}
-		logger_->debug("Str Pool: Hits {} Misses {} Size {} Alloc {}", pool_stats.hits, pool_stats.misses,
-		               pool_stats.table_size, pool_stats.alloc_size);
+		logger_->debug("Str Pool: Hits {} Misses {} Cache Hits {} Size {} Alloc {} Arena {}", pool_stats.hits,
+		               pool_stats.misses, pool_stats.cache_hits, pool_stats.table_size, pool_stats.alloc_size,
+		               pool_stats.arena_size);
 
 		auto elapsed = clock::now() - start;
 		auto millis = duration_cast<milliseconds>(elapsed);
@@ -587,17 +804,21 @@ void Server::Stop()
 
 auto Server::parse_statsd(char* buffer) -> std::optional<std::string>
 {
-	return parse_lines(buffer, [this](char* line) { return this->parse_statsd_line(line); });
+	return parse_lines(buffer, [this](char* line, const delimiters& delims, meter_updates* updates) {
+		return this->parse_statsd_line(line, delims, updates);
+	});
 }
 
 auto Server::parse(char* buffer) -> std::optional<std::string>
 {
-	return parse_lines(buffer, [this](const char* line) { return this->parse_line(line); });
+	return parse_lines(buffer, [this](const char* line, const delimiters& delims, meter_updates* updates) {
+		return this->parse_line(line, delims, updates);
+	});
 }
 
-auto Server::parse_line(const char* buffer) -> std::optional<std::string>
+auto Server::parse_line(const char* buffer, const delimiters& delims, meter_updates* updates) -> parse_error
 {
-	static int_fast64_t parsed_count = 0;
+	static std::atomic<int_fast64_t> parsed_count{0};
 
 	const char* p = buffer;
 
@@ -610,113 +831,111 @@ auto Server::parse_line(const char* buffer) -> std::optional<std::string>
 		extra = strtoll(p, &end_ttl, 10);
 		if (extra <= 0)
 		{
-			auto idx = p - buffer;
+			auto idx = static_cast<size_t>(p - buffer);
 			if (type == 'g')
 			{
-				auto msg = fmt::format("Invalid ttl specified for gauge at index {}", idx);
-				Logger()->info(fmt::format("Parse error for '{}': {}", buffer, msg));
-				return msg;
+				return {ParseError::InvalidTtl, idx};
 			}
 			else if (type == 'X')
 			{
-				auto msg = fmt::format("Invalid timestamp specified for monotonic sampled source at index {}", idx);
-				Logger()->info(fmt::format("Parse error for '{}': {}", buffer, msg));
-				return msg;
+				return {ParseError::InvalidTimestamp, idx};
 			}
 		}
 		p = end_ttl;
 	}
-	if (*p != ':')
+	// an empty line has no type, and p would already be past its end
+	if (static_cast<size_t>(p - buffer) >= delims.size() || *p != ':')
 	{
-		auto msg = fmt::format("Expecting separator ':' at index {}", p - buffer);
-		Logger()->info(fmt::format("Parse error for '{}': {}", buffer, msg));
-		return msg;
+		return {ParseError::MissingSeparator, static_cast<size_t>(p - buffer)};
 	}
 	++p;
-	std::string err_msg;
-	auto measurement = get_measurement(type, p, &err_msg);
+	parse_error err;
+	auto offset = static_cast<size_t>(p - buffer);
+	std::string_view measurement_str{p, delims.size() - offset};
+	auto measurement = get_measurement(type, measurement_str, delims.from(offset), &err);
 	if (!measurement)
 	{
-		Logger()->info(fmt::format("Parse error for '{}': {}", buffer, err_msg));
-		return err_msg;
+		err.offset += offset;
+		return err;
 	}
 
-	if (!err_msg.empty())
+	if (err.code != ParseError::None)
 	{
 		// got a warning while parsing
-		Logger()->info("While parsing {}: {}", p, err_msg);
+		Logger()->info("While parsing {}: {}", measurement_str, format_parse_error(measurement_str, err));
 	}
 	switch (type)
 	{
 		case 'A':
 			if (measurement->value.d == 0)
 			{
-				registry_->GetAgeGauge(measurement->id)->UpdateLastSuccess();
+				registry_->GetAgeGauge(std::move(measurement->id))->UpdateLastSuccess();
 			}
 			else
 			{
-				registry_->GetAgeGauge(measurement->id)
+				registry_->GetAgeGauge(std::move(measurement->id))
 				    ->UpdateLastSuccess(static_cast<int64_t>(measurement->value.d * 1e9));
 			}
 			break;
 		case 'c':
-			registry_->GetCounter(measurement->id)->Add(measurement->value.d);
+			updates->add_counter(std::move(measurement->id), measurement->value.d);
 			break;
 		case 'C':
-			registry_->GetMonotonicCounter(measurement->id)->Set(measurement->value.d);
+			registry_->GetMonotonicCounter(std::move(measurement->id))->Set(measurement->value.d);
 			break;
 		case 'd':
-			registry_->GetDistributionSummary(measurement->id)->Record(measurement->value.d);
+			updates->record_dist_summary(std::move(measurement->id), measurement->value.d, 1);
 			break;
 		case 'D':
-			perc_ds_.get_or_create(registry_, measurement->id)->Record(static_cast<int64_t>(measurement->value.d));
+			perc_ds_.get_or_create(registry_, std::move(measurement->id))
+			    ->Record(static_cast<int64_t>(measurement->value.d));
 			break;
 		case 'g':
 			if (extra > 0)
 			{
-				registry_->GetGauge(measurement->id, absl::Seconds(extra))->Set(measurement->value.d);
+				registry_->GetGauge(std::move(measurement->id), absl::Seconds(extra))->Set(measurement->value.d);
 			}
 			else
 			{
 				// this preserves the previous ttl, otherwise we would override it
 				// with the default value, if we use the previous constructor
-				registry_->GetGauge(measurement->id)->Set(measurement->value.d);
+				registry_->GetGauge(std::move(measurement->id))->Set(measurement->value.d);
 			}
 			break;
 		case 'm':
-			registry_->GetMaxGauge(measurement->id)->Update(measurement->value.d);
+			updates->update_max_gauge(std::move(measurement->id), measurement->value.d);
 			break;
 		case 't':  // elapsed time is reported in seconds
 		{
 			auto nanos = static_cast<int64_t>(measurement->value.d * 1e9);
-			registry_->GetTimer(measurement->id)->Record(std::chrono::nanoseconds(nanos));
+			updates->record_timer(std::move(measurement->id), nanos, 1);
 		}
 		break;
 		case 'T':
 		{
 			auto nanos = static_cast<int64_t>(measurement->value.d * 1e9);
-			perc_timers_.get_or_create(registry_, measurement->id)->Record(std::chrono::nanoseconds(nanos));
+			perc_timers_.get_or_create(registry_, std::move(measurement->id))->Record(std::chrono::nanoseconds(nanos));
 		}
 		break;
 		case 'U':
-			registry_->GetMonotonicCounterUint(measurement->id)->Set(measurement->value.u);
+			registry_->GetMonotonicCounterUint(std::move(measurement->id))->Set(measurement->value.u);
 			break;
 		case 'X':
 			if (extra > 0)
 			{
 				// extra is milliseconds since the epoch
 				auto nanos = extra * 1000 * 1000;
-				registry_->GetMonotonicSampled(measurement->id)->Set(measurement->value.u, nanos);
+				registry_->GetMonotonicSampled(std::move(measurement->id))->Set(measurement->value.u, nanos);
 			}
 			break;
 		default:
-			return fmt::format("Unknown type: {}", type);
+			return {ParseError::UnknownType, 0};
 	}
 
-	++parsed_count;
-	if (parsed_count % 50000 == 0)
+	auto count = ++parsed_count;
+	if (count % 50000 == 0)
 	{
-		logger_->debug("Parsed {} messages", parsed_count);
+		logger_->debug("Parsed {} messages", count);
 		logger_->debug("Meters in Registry = {}", registry_->Size());
 	}
 	return {};
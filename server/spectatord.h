@@ -1,7 +1,9 @@
 #pragma once
 
+#include "delimiters.h"
 #include "expiring_cache.h"
 #include "handler.h"
+#include "meter_updates.h"
 #include "../spectator/percentile_distribution_summary.h"
 #include "../spectator/percentile_timer.h"
 #include "../spectator/registry.h"
@@ -9,11 +11,42 @@
 namespace spectatord
 {
 
+// Why a line was rejected, or part of it ignored. Parsing only records where the
+// problem is, the message is formatted with format_parse_error when it is logged
+enum class ParseError : uint8_t
+{
+	None,
+	MissingName,
+	MissingTagValue,
+	InvalidValue,
+	IgnoredChars,  // not an error, the value was parsed but what follows it was ignored
+	InvalidTtl,
+	InvalidTimestamp,
+	MissingSeparator,
+	UnknownType,
+	MissingStatsdName,
+	InvalidStatsdValue,
+	MissingStatsdPipe,
+	InvalidStatsdType,
+	InvalidSamplingRate,
+	InvalidTags
+};
+
+struct parse_error
+{
+	ParseError code{ParseError::None};
+	size_t offset{0};  // in the line that was parsed
+};
+
+// the message for err, found while parsing line
+std::string format_parse_error(std::string_view line, parse_error err);
+
 class Server
 {
    public:
 	Server(bool ipv4_only, int port_number, std::optional<int> statsd_port_number,
-	       std::optional<std::string> socket_path, spectator::Registry* registry);
+	       std::optional<std::string> socket_path, spectator::Registry* registry, size_t num_workers = 1,
+	       size_t recv_batch_size = 1, std::optional<std::string> shm_path = {});
 	Server(const Server&) = delete;
 	Server(Server&&) = delete;
 	Server& operator=(const Server&) = delete;
@@ -30,6 +63,9 @@ class Server
 	std::optional<int> statsd_port_number_;
 	std::optional<std::string> socket_path_;
 	spectator::Registry* registry_;
+	size_t num_workers_;                   // number of ingest threads, each with its own udp sockets
+	size_t recv_batch_size_;               // max datagrams per recvmmsg call, 1 disables batching
+	std::optional<std::string> shm_path_;  // shared memory ring for co-located clients
 	std::shared_ptr<spectator::Counter> parsed_count_;
 	std::shared_ptr<spectator::Counter> parse_errors_;
 	std::shared_ptr<spdlog::logger> logger_;
@@ -44,9 +80,12 @@ class Server
 	void upkeep();
 	void update_network_metrics();
 
-	std::optional<std::string> parse_lines(char* buffer, const handler_t& parser);
-	std::optional<std::string> parse_line(const char* buffer);
-	std::optional<std::string> parse_statsd_line(const char* buffer);
+	// parses a single line, with the delimiters found in it, adding the updates that can
+	// be coalesced to the given set
+	using line_parser_t = std::function<parse_error(char*, const delimiters&, meter_updates*)>;
+	std::optional<std::string> parse_lines(char* buffer, const line_parser_t& parser);
+	parse_error parse_line(const char* buffer, const delimiters& delims, meter_updates* updates);
+	parse_error parse_statsd_line(const char* buffer, const delimiters& delims, meter_updates* updates);
 	void ensure_not_stuck();
 
    protected:
@@ -67,5 +106,8 @@ struct measurement
 };
 
 std::optional<measurement> get_measurement(char type, std::string_view measurement_str, std::string* err_msg);
+// same as above, using the delimiters already found in measurement_str
+std::optional<measurement> get_measurement(char type, std::string_view measurement_str, const delimiters& delims,
+                                           parse_error* err);
 
 }  // namespace spectatord
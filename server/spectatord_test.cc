@@ -1,8 +1,11 @@
 #include "../spectator/test_utils.h"
+#include "absl/strings/str_join.h"
 #include "gtest/gtest.h"
 #include "local.h"
 #include "spectatord.h"
+#include "../spectator/string_pool.h"
 
+#include <cmath>
 #include <fmt/ostream.h>
 
 namespace
@@ -266,6 +269,81 @@ TEST(Spectatord, ParseIgnoringStuffAtTheEnd)
 	EXPECT_FALSE(err_msg.empty());
 }
 
+TEST(Spectatord, ParseValues)
+{
+	auto parse_value = [](char type, const char* str)
+	{
+		std::string err_msg;
+		auto measurement = get_measurement(type, str, &err_msg);
+		EXPECT_TRUE(measurement) << str;
+		EXPECT_TRUE(err_msg.empty()) << str << ": " << err_msg;
+		return measurement ? measurement->value : spectatord::valueT{};
+	};
+	EXPECT_DOUBLE_EQ(parse_value('c', "n:+1.5").d, 1.5);
+	EXPECT_DOUBLE_EQ(parse_value('c', "n: -2e3").d, -2000.0);
+	EXPECT_DOUBLE_EQ(parse_value('c', "n:0.000001").d, 1e-6);
+	EXPECT_DOUBLE_EQ(parse_value('c', "n:42 ").d, 42.0);
+	EXPECT_EQ(parse_value('U', "n:18446744073709551615").u, std::numeric_limits<uint64_t>::max());
+}
+
+TEST(Spectatord, ParseValuesOutOfRange)
+{
+	auto parse_value = [](char type, const char* str)
+	{
+		std::string err_msg;
+		auto measurement = get_measurement(type, str, &err_msg);
+		EXPECT_TRUE(measurement) << str;
+		EXPECT_TRUE(err_msg.empty()) << str << ": " << err_msg;
+		return measurement ? measurement->value : spectatord::valueT{};
+	};
+	// values that do not fit saturate, like with strtod and strtoull
+	EXPECT_EQ(parse_value('c', "n:1e400").d, HUGE_VAL);
+	EXPECT_EQ(parse_value('c', "n:-1e400").d, -HUGE_VAL);
+	EXPECT_EQ(parse_value('c', ("n:" + std::string(400, '9')).c_str()).d, HUGE_VAL);
+	EXPECT_DOUBLE_EQ(parse_value('c', "n:1e-400").d, 0.0);
+	EXPECT_EQ(parse_value('U', "n:18446744073709551616").u, std::numeric_limits<uint64_t>::max());
+	EXPECT_EQ(parse_value('U', "n:99999999999999999999999").u, std::numeric_limits<uint64_t>::max());
+
+	// negative values wrap around for monotonic counters of unsigned values
+	EXPECT_EQ(parse_value('U', "n:-1").u, std::numeric_limits<uint64_t>::max());
+	EXPECT_EQ(parse_value('U', "n: -5").u, std::numeric_limits<uint64_t>::max() - 4);
+	EXPECT_EQ(parse_value('U', "n:-0").u, 0);
+
+	std::string err_msg;
+	EXPECT_FALSE(get_measurement('U', "n:-", &err_msg));
+	EXPECT_FALSE(get_measurement('U', "n:--1", &err_msg));
+}
+
+TEST(Spectatord, ParseErrorsDoNotInternTags)
+{
+	std::string err_msg;
+	auto before = spectator::string_pool_stats().table_size;
+	EXPECT_FALSE(get_measurement('c', "never.seen.name,never.seen.key=never.seen.value:abc", &err_msg));
+	EXPECT_FALSE(err_msg.empty());
+	EXPECT_EQ(spectator::string_pool_stats().table_size, before);
+}
+
+TEST(Spectatord, ReclaimStrings)
+{
+	spectator::Registry registry{GetConfiguration(), Logger()};
+	test_server server{&registry};
+	std::string msg{"c:reclaim.counter,id=some-counter:1\nT:reclaim.timer,id=some-timer:1"};
+	server.parse_msg(&msg[0]);
+
+	// nothing marks the counter strings as live, but the percentile timer
+	// is cached by the server, so its strings must be kept
+	auto& pool = spectator::the_str_pool();
+	pool.Reclaim({});
+	pool.Reclaim({});
+	auto before = spectator::string_pool_stats();
+	spectator::intern_reclaimable_str("reclaim.timer");
+	spectator::intern_reclaimable_str("some-timer");
+	EXPECT_EQ(spectator::string_pool_stats().misses, before.misses);
+	spectator::intern_reclaimable_str("reclaim.counter");
+	spectator::intern_reclaimable_str("some-counter");
+	EXPECT_EQ(spectator::string_pool_stats().misses, before.misses + 2);
+}
+
 TEST(Spectatord, ParseMultiline)
 {
 	auto logger = Logger();
@@ -280,6 +358,67 @@ TEST(Spectatord, ParseMultiline)
 	EXPECT_DOUBLE_EQ(map["counter.name|statistic=count"], 42);
 }
 
+TEST(Spectatord, ParseErrorMessages)
+{
+	spectator::Registry registry{GetConfiguration(), Logger()};
+	test_server server{&registry};
+
+	// the parsers only record where the problem was, the messages are built from that
+	std::string line{"g,-1:gauge.name:1"};
+	EXPECT_EQ(server.parse_msg(&line[0]), "Invalid ttl specified for gauge at index 2");
+	line = "c;counter.name:1";
+	EXPECT_EQ(server.parse_msg(&line[0]), "Expecting separator ':' at index 1");
+	line = "c:counter.name:abc";
+	EXPECT_EQ(server.parse_msg(&line[0]), "Unable to parse value for measurement");
+	line = "x:unknown.type:1\nc:,id=a:1";
+	EXPECT_EQ(server.parse_msg(&line[0]), "Unknown type: x\nMissing name");
+
+	line = "statsd.name:abc|c";
+	EXPECT_EQ(server.test_parse_statsd(&line[0]), "Unable to parse value starting at abc|c");
+	line = "statsd.name:1|c|@2";
+	EXPECT_EQ(server.test_parse_statsd(&line[0]), "Invalid sampling rate for name=statsd.name");
+	line = "statsd.name:1|x";
+	EXPECT_EQ(server.test_parse_statsd(&line[0]), "Invalid type for name statsd.name (statsd.name:1|x)");
+}
+
+TEST(Spectatord, ParseCoalescedUpdates)
+{
+	// updates to the same meter in a buffer are added up before being applied,
+	// which must give the same result as applying each line on its own
+	std::vector<std::string> lines{"c:counter.name:10",     "t:timer.name:.001", "c:counter.name,id=a:1",
+	                               "d:dist.summary:2",      "m:max.gauge:4",     "c:counter.name:20",
+	                               "t:timer.name:.005",     "m:max.gauge:nan",   "d:dist.summary:-1",
+	                               "c:counter.name:-5",     "m:max.gauge:7",     "t:timer.name:-1",
+	                               "c:ignored.name:-1",     "g:gauge.name:3",    "d:dist.summary:5",
+	                               "t:timer.name:.002",     "x:unknown.type:1",  "m:max.gauge:6",
+	                               "c:counter.name,id=a:2", "g:gauge.name:1"};
+
+	spectator::Registry coalesced{GetConfiguration(), Logger()};
+	test_server coalesced_server{&coalesced};
+	auto buffer = absl::StrJoin(lines, "\n");
+	EXPECT_TRUE(coalesced_server.parse_msg(&buffer[0]).has_value());
+
+	spectator::Registry line_by_line{GetConfiguration(), Logger()};
+	test_server line_by_line_server{&line_by_line};
+	for (auto line : lines)
+	{
+		line_by_line_server.parse_msg(&line[0]);
+	}
+
+	EXPECT_EQ(coalesced.Size(), line_by_line.Size());
+	auto expected = line_by_line_server.measurements();
+	auto actual = coalesced_server.measurements();
+	ASSERT_EQ(actual.size(), expected.size());
+	for (const auto& kv : expected)
+	{
+		EXPECT_DOUBLE_EQ(actual[kv.first], kv.second) << kv.first;
+	}
+	EXPECT_DOUBLE_EQ(actual["counter.name|statistic=count"], 30);
+	EXPECT_DOUBLE_EQ(actual["timer.name|statistic=count"], 3);
+	EXPECT_DOUBLE_EQ(actual["max.gauge|statistic=max"], 7);
+	EXPECT_DOUBLE_EQ(actual["spectatord.parseErrors|statistic=count"], 1);
+}
+
 TEST(Spectatord, ParseAgeGauge)
 {
 	auto logger = Logger();
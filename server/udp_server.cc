@@ -7,19 +7,22 @@ using asio::ip::udp;
 namespace spectatord
 {
 
+using reuse_port_option = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
 // NOLINTNEXTLINE(google-runtime-references)
-UdpServer::UdpServer(asio::io_context& io_context, bool ipv4_only, int port_number, handler_t message_handler)
-    : udp_socket_{io_context, udp::endpoint(
-                                  [&ipv4_only]() -> udp
-                                  {
-	                                  if (ipv4_only)
-		                                  return udp::v4();
-	                                  else
-		                                  return udp::v6();
-                                  }(),
-                                  port_number)},
-      message_handler_(std::move(message_handler))
+UdpServer::UdpServer(asio::io_context& io_context, bool ipv4_only, int port_number, handler_t message_handler,
+                     bool reuse_port)
+    : udp_socket_{io_context}, message_handler_(std::move(message_handler))
 {
+	auto protocol = ipv4_only ? udp::v4() : udp::v6();
+	udp_socket_.open(protocol);
+	if (reuse_port)
+	{
+		// must be set before bind, and on every socket sharing the port
+		udp_socket_.set_option(reuse_port_option{true});
+	}
+	udp_socket_.bind(udp::endpoint{protocol, static_cast<unsigned short>(port_number)});
+
 	asio::socket_base::receive_buffer_size option{max_buffer_size()};
 	try
 	{
@@ -38,6 +41,36 @@ UdpServer::UdpServer(asio::io_context& io_context, int socket_fd, bool is_ipv6,
 	Logger()->info("Using systemd socket activation for UDP server (fd={})", socket_fd);
 }
 
+void UdpServer::Start(size_t batch_size)
+{
+	if (batch_size > 1)
+	{
+		batch_receiver_ = std::make_unique<BatchReceiver>(batch_size);
+		start_batch_receive();
+	}
+	else
+	{
+		start_udp_receive();
+	}
+}
+
+void UdpServer::start_batch_receive()
+{
+	udp_socket_.async_wait(asio::socket_base::wait_read,
+	                       [this](const std::error_code& err)
+	                       {
+		                       if (err)
+		                       {
+			                       Logger()->error("Error waiting to receive: {}: {}", err.value(), err.message());
+		                       }
+		                       else
+		                       {
+			                       batch_receiver_->Dispatch(udp_socket_.native_handle(), message_handler_);
+		                       }
+		                       start_batch_receive();
+	                       });
+}
+
 void UdpServer::start_udp_receive()
 {
 	udp_socket_.async_receive(asio::buffer(recv_buffer_),
@@ -1,28 +1,37 @@
 #pragma once
 
+#include "batch_receiver.h"
 #include "handler.h"
 #include <asio.hpp>
+#include <memory>
 
 namespace spectatord
 {
 class UdpServer
 {
    public:
-	// Create a UdpServer that binds to a new socket on the given port
+	// Create a UdpServer that binds to a new socket on the given port. When reuse_port is set, the
+	// socket is opened with SO_REUSEPORT so several servers can share the port, and the kernel will
+	// distribute incoming datagrams between them.
 	// NOLINTNEXTLINE(google-runtime-references)
-	UdpServer(asio::io_context& io_context, bool ipv4_only, int port_number, handler_t message_handler);
+	UdpServer(asio::io_context& io_context, bool ipv4_only, int port_number, handler_t message_handler,
+	          bool reuse_port = false);
 
 	// Create a UdpServer using an existing socket file descriptor (systemd activation)
 	// NOLINTNEXTLINE(google-runtime-references)
 	UdpServer(asio::io_context& io_context, int socket_fd, bool is_ipv6, handler_t message_handler);
 
-	void Start() { start_udp_receive(); }
+	// Start receiving datagrams. With a batch_size greater than 1, up to batch_size datagrams
+	// are read with a single recvmmsg call every time the socket becomes readable
+	void Start(size_t batch_size = 1);
 
    private:
 	asio::ip::udp::socket udp_socket_;
 	std::array<char, 65536> recv_buffer_{};
 	handler_t message_handler_;
+	std::unique_ptr<BatchReceiver> batch_receiver_;
 
 	void start_udp_receive();
+	void start_batch_receive();
 };
-}  // namespace spectatord
\ No newline at end of file
+}  // namespace spectatord
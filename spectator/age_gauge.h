@@ -9,9 +9,13 @@ namespace spectator
 class AgeGauge : public Meter
 {
    public:
+	// the age keeps growing without updates
+	static constexpr bool kMeasureWhenIdle = true;
+
 	explicit AgeGauge(Id id) noexcept : Meter{std::move(id)}, last_success_{0} {}
 
-	void Measure(Measurements* results) const noexcept
+	template <typename Results>
+	void Measure(Results* results) const noexcept
 	{
 		if (!gauge_id_)
 		{
@@ -0,0 +1,215 @@
+#include "async_http_client.h"
+#include "curl_handle.h"
+#include "log_entry.h"
+
+#include <algorithm>
+
+namespace spectator
+{
+
+using detail::CurlHandle;
+
+static constexpr const char* const kPost = "POST";
+// how long the event loop sleeps when there is nothing to do
+static constexpr int kMaxWaitMillis = 1000;
+
+struct AsyncHttpClient::Request
+{
+	Request(std::string url_param, std::shared_ptr<CurlHeaders> headers_param, const void* payload_param,
+	        size_t size_param, Callback callback_param)
+	    : url{std::move(url_param)},
+	      headers{std::move(headers_param)},
+	      payload{payload_param},
+	      size{size_param},
+	      callback{std::move(callback_param)}
+	{
+	}
+
+	std::string url;
+	std::shared_ptr<CurlHeaders> headers;
+	const void* payload;
+	size_t size;
+	Callback callback;
+
+	int attempt_number{0};
+	absl::Time retry_at;
+	std::unique_ptr<LogEntry> entry;
+	std::unique_ptr<CurlHandle> curl;
+};
+
+auto AsyncHttpClient::retry_later(const std::unique_ptr<Request>& a, const std::unique_ptr<Request>& b) -> bool
+{
+	return a->retry_at > b->retry_at;
+}
+
+AsyncHttpClient::AsyncHttpClient(Registry* registry, HttpClientConfig config, size_t max_connections)
+    : registry_{registry}, config_{std::move(config)}, max_connections_{max_connections}, multi_{curl_multi_init()}
+{
+	curl_multi_setopt(multi_, CURLMOPT_MAX_TOTAL_CONNECTIONS, static_cast<long>(max_connections));
+	curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+	loop_thread_ = std::thread(&AsyncHttpClient::loop, this);
+}
+
+AsyncHttpClient::~AsyncHttpClient()
+{
+	{
+		std::lock_guard<std::mutex> lock{mutex_};
+		stopping_ = true;
+	}
+	curl_multi_wakeup(multi_);
+	loop_thread_.join();
+
+	// the handles were removed from the multi handle when their requests completed
+	idle_handles_.clear();
+	curl_multi_cleanup(multi_);
+}
+
+void AsyncHttpClient::Post(const std::string& url, const char* content_type, const CompressedResult& payload,
+                           Callback callback)
+{
+	auto headers = std::make_shared<CurlHeaders>();
+	headers->append(content_type);
+	if (payload.content_encoding != nullptr)
+	{
+		headers->append(payload.content_encoding);
+	}
+	auto request = std::make_unique<Request>(url, std::move(headers), payload.data, payload.size, std::move(callback));
+	{
+		std::lock_guard<std::mutex> lock{mutex_};
+		++outstanding_;
+		submitted_.emplace_back(std::move(request));
+	}
+	curl_multi_wakeup(multi_);
+}
+
+void AsyncHttpClient::Wait()
+{
+	std::unique_lock<std::mutex> lock{mutex_};
+	done_cv_.wait(lock, [this]() { return outstanding_ == 0; });
+}
+
+void AsyncHttpClient::loop()
+{
+	std::vector<std::unique_ptr<Request>> submitted;
+	for (;;)
+	{
+		{
+			std::lock_guard<std::mutex> lock{mutex_};
+			if (stopping_ && outstanding_ == 0)
+			{
+				break;
+			}
+			submitted.swap(submitted_);
+		}
+		for (auto& request : submitted)
+		{
+			start(std::move(request));
+		}
+		submitted.clear();
+
+		auto now = absl::Now();
+		while (!retries_.empty() && retries_.front()->retry_at <= now)
+		{
+			std::pop_heap(retries_.begin(), retries_.end(), retry_later);
+			auto request = std::move(retries_.back());
+			retries_.pop_back();
+			start(std::move(request));
+		}
+
+		int still_running = 0;
+		curl_multi_perform(multi_, &still_running);
+		int msgs_left = 0;
+		CURLMsg* msg;
+		while ((msg = curl_multi_info_read(multi_, &msgs_left)) != nullptr)
+		{
+			if (msg->msg == CURLMSG_DONE)
+			{
+				finish(msg->easy_handle, msg->data.result);
+			}
+		}
+
+		// wait for activity on the connections, a new request, or the next retry.
+		// curl shortens the wait if it has timeouts of its own to handle
+		auto timeout = absl::Milliseconds(kMaxWaitMillis);
+		if (!retries_.empty())
+		{
+			timeout = std::min(timeout, std::max(retries_.front()->retry_at - absl::Now(), absl::ZeroDuration()));
+		}
+		curl_multi_poll(multi_, nullptr, 0, static_cast<int>(absl::ToInt64Milliseconds(timeout)), nullptr);
+	}
+}
+
+void AsyncHttpClient::start(std::unique_ptr<Request> request)
+{
+	if (!request->curl)
+	{
+		if (idle_handles_.empty())
+		{
+			request->curl = std::make_unique<CurlHandle>();
+		}
+		else
+		{
+			request->curl = std::move(idle_handles_.back());
+			idle_handles_.pop_back();
+		}
+	}
+	auto& curl = *request->curl;
+	curl.clear_for_reuse();
+	curl.setup_request(config_, kPost, request->url, request->headers, request->payload, request->size);
+	// prefer waiting for a connection that can multiplex requests over opening a new one
+	curl_easy_setopt(curl.handle(), CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+	curl_easy_setopt(curl.handle(), CURLOPT_PIPEWAIT, 1L);
+
+	request->entry = std::make_unique<LogEntry>(registry_, kPost, request->url);
+	curl_multi_add_handle(multi_, curl.handle());
+	running_.emplace(curl.handle(), std::move(request));
+}
+
+void AsyncHttpClient::finish(void* easy, int curl_res)
+{
+	auto it = running_.find(easy);
+	if (it == running_.end())
+	{
+		return;
+	}
+	auto request = std::move(it->second);
+	running_.erase(it);
+	curl_multi_remove_handle(multi_, easy);
+
+	auto attempt = detail::check_attempt(registry_, config_, kPost, request->url, request->attempt_number,
+	                                     static_cast<CURLcode>(curl_res), request->curl.get(), request->entry.get());
+	if (attempt.retry)
+	{
+		++request->attempt_number;
+		if (attempt.backoff == absl::ZeroDuration())
+		{
+			start(std::move(request));
+			return;
+		}
+		// wait on a timer, giving the handle back in the meantime
+		release_handle(std::move(request->curl));
+		request->retry_at = absl::Now() + attempt.backoff;
+		retries_.emplace_back(std::move(request));
+		std::push_heap(retries_.begin(), retries_.end(), retry_later);
+		return;
+	}
+
+	auto response = request->curl->take_response(attempt.http_code);
+	release_handle(std::move(request->curl));
+	request->callback(std::move(response));
+	// notify while holding the lock, the client can be destroyed as soon as a waiter sees 0
+	std::lock_guard<std::mutex> lock{mutex_};
+	--outstanding_;
+	done_cv_.notify_all();
+}
+
+void AsyncHttpClient::release_handle(std::unique_ptr<CurlHandle> curl)
+{
+	// keep enough handles around for the usual number of requests in flight
+	if (idle_handles_.size() < max_connections_)
+	{
+		idle_handles_.emplace_back(std::move(curl));
+	}
+}
+
+}  // namespace spectator
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "http_client.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace spectator
+{
+
+namespace detail
+{
+class CurlHandle;
+}
+
+// An http client that keeps many requests in flight from a single thread. Requests
+// are handed to an event loop driving a curl multi handle, which multiplexes them
+// over HTTP/2 connections when the server supports it, and retries are scheduled
+// on timers instead of putting a thread to sleep.
+class AsyncHttpClient
+{
+   public:
+	using Callback = std::function<void(HttpResponse)>;
+
+	// at most max_connections connections are open at any time, extra requests
+	// wait for one of them to be available
+	AsyncHttpClient(Registry* registry, HttpClientConfig config, size_t max_connections);
+	AsyncHttpClient(const AsyncHttpClient&) = delete;
+	AsyncHttpClient(AsyncHttpClient&&) = delete;
+	auto operator=(const AsyncHttpClient&) -> AsyncHttpClient& = delete;
+	auto operator=(AsyncHttpClient&&) -> AsyncHttpClient& = delete;
+
+	// waits for the requests in flight to complete
+	~AsyncHttpClient();
+
+	// The payload must be valid until the callback is called. Callbacks are called
+	// from the event loop thread, and should not block
+	void Post(const std::string& url, const char* content_type, const CompressedResult& payload, Callback callback);
+
+	// wait until all the requests submitted so far have completed
+	void Wait();
+
+   private:
+	struct Request;
+
+	Registry* registry_;
+	HttpClientConfig config_;
+	size_t max_connections_;
+	void* multi_;  // the CURLM handle
+
+	std::mutex mutex_;
+	std::condition_variable done_cv_;
+	std::vector<std::unique_ptr<Request>> submitted_;
+	size_t outstanding_{0};
+	bool stopping_{false};
+
+	// only used by the event loop thread
+	std::unordered_map<void*, std::unique_ptr<Request>> running_;  // by CURL handle
+	std::vector<std::unique_ptr<Request>> retries_;                // a heap, soonest first
+	std::vector<std::unique_ptr<detail::CurlHandle>> idle_handles_;
+
+	std::thread loop_thread_;
+
+	void loop();
+	void start(std::unique_ptr<Request> request);
+	void finish(void* easy, int curl_res);
+	void release_handle(std::unique_ptr<detail::CurlHandle> curl);
+	static auto retry_later(const std::unique_ptr<Request>& a, const std::unique_ptr<Request>& b) -> bool;
+};
+
+}  // namespace spectator
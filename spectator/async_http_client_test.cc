@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+
+#include "../spectator/async_http_client.h"
+#include "../spectator/gzip.h"
+#include "../spectator/registry.h"
+#include "http_server.h"
+#include "test_utils.h"
+
+namespace
+{
+
+using spectator::AsyncHttpClient;
+using spectator::CompressedResult;
+using spectator::GetConfiguration;
+using spectator::gzip_compress;
+using spectator::HttpClient;
+using spectator::HttpClientConfig;
+using spectator::HttpResponse;
+using spectator::Registry;
+
+HttpClientConfig get_cfg(int read_to, int connect_to)
+{
+	auto cert_info = metatron::CertInfo{"ssl_cert", "ssl_key", "ca_info", "app_name"};
+	return HttpClientConfig{
+	    absl::Milliseconds(connect_to), absl::Milliseconds(read_to), true, true, true, false, true, false, cert_info};
+}
+
+class Responses
+{
+   public:
+	auto callback() -> AsyncHttpClient::Callback
+	{
+		return [this](HttpResponse response)
+		{
+			absl::MutexLock lock{&mutex_};
+			responses_.emplace_back(std::move(response));
+		};
+	}
+
+	auto get() -> std::vector<HttpResponse>
+	{
+		absl::MutexLock lock{&mutex_};
+		return responses_;
+	}
+
+   private:
+	absl::Mutex mutex_;
+	std::vector<HttpResponse> responses_;
+};
+
+auto compressed(const std::string& payload, std::vector<char>* buffer) -> CompressedResult
+{
+	auto size = compressBound(payload.length()) + spectator::kGzipHeaderSize;
+	buffer->resize(size);
+	EXPECT_EQ(gzip_compress(buffer->data(), &size, payload.c_str(), payload.length()), Z_OK);
+	return CompressedResult{reinterpret_cast<const uint8_t*>(buffer->data()), size};
+}
+
+TEST(AsyncHttpTest, Post)
+{
+	http_server server;
+	server.start();
+	auto port = server.get_port();
+	ASSERT_TRUE(port > 0) << "Port = " << port;
+
+	Registry registry{GetConfiguration(), spectatord::Logger()};
+	Responses responses;
+	std::vector<char> buffer;
+	auto payload = compressed("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", &buffer);
+	{
+		AsyncHttpClient client{&registry, get_cfg(1000, 1000), 4};
+		auto url = fmt::format("http://localhost:{}/foo", port);
+		for (auto i = 0; i < 10; ++i)
+		{
+			client.Post(url, HttpClient::kJsonType, payload, responses.callback());
+		}
+		client.Wait();
+		EXPECT_EQ(responses.get().size(), 10);
+	}
+	server.stop();
+
+	for (const auto& response : responses.get())
+	{
+		EXPECT_EQ(response.status, 200);
+		EXPECT_EQ(response.raw_body, "OK\n");
+	}
+
+	const auto& requests = server.get_requests();
+	ASSERT_EQ(requests.size(), 10);
+	for (const auto& r : requests)
+	{
+		EXPECT_EQ(r.method(), "POST");
+		EXPECT_EQ(r.path(), "/foo");
+		EXPECT_EQ(r.get_header("Content-Encoding"), "gzip");
+		EXPECT_EQ(r.get_header("Content-Type"), "application/json");
+		EXPECT_EQ(r.size(), payload.size);
+	}
+}
+
+TEST(AsyncHttpTest, RetryWithoutBlocking)
+{
+	http_server server;
+	server.start();
+	auto port = server.get_port();
+	ASSERT_TRUE(port > 0) << "Port = " << port;
+
+	Registry registry{GetConfiguration(), spectatord::Logger()};
+	Responses responses;
+	std::vector<char> buffer;
+	auto payload = compressed("stuff", &buffer);
+	AsyncHttpClient client{&registry, get_cfg(1000, 1000), 4};
+
+	// the 503 is retried after a backoff, but posting returns right away
+	auto start = absl::Now();
+	client.Post(fmt::format("http://localhost:{}/get503", port), HttpClient::kJsonType, payload, responses.callback());
+	EXPECT_LT(absl::Now() - start, absl::Milliseconds(100));
+	client.Wait();
+	EXPECT_GE(absl::Now() - start, absl::Milliseconds(200));
+	server.stop();
+
+	auto result = responses.get();
+	ASSERT_EQ(result.size(), 1);
+	EXPECT_EQ(result[0].status, 200);
+	EXPECT_EQ(result[0].raw_body, "InsightInstanceProfile");
+	EXPECT_EQ(server.get_requests().size(), 2);
+}
+
+TEST(AsyncHttpTest, Timeout)
+{
+	http_server server;
+	server.set_read_sleep(std::chrono::milliseconds(100));
+	server.start();
+	auto port = server.get_port();
+	ASSERT_TRUE(port > 0) << "Port = " << port;
+
+	Registry registry{GetConfiguration(), spectatord::Logger()};
+	Responses responses;
+	std::vector<char> buffer;
+	auto payload = compressed("stuff", &buffer);
+	{
+		AsyncHttpClient client{&registry, get_cfg(10, 10), 4};
+		client.Post(fmt::format("http://localhost:{}/foo", port), HttpClient::kJsonType, payload,
+		            responses.callback());
+		// pending requests are completed before the client goes away
+	}
+	server.stop();
+
+	auto result = responses.get();
+	ASSERT_EQ(result.size(), 1);
+	EXPECT_EQ(result[0].status, -1);
+}
+
+}  // namespace
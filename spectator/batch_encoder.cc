@@ -0,0 +1,122 @@
+#include "batch_encoder.h"
+#include "common_refs.h"
+
+namespace spectator
+{
+
+BatchEncoder::BatchEncoder(const Tags& common_tags, Codec codec, Executor executor)
+    : payload_{codec, std::move(executor)}
+{
+	start_batch();
+	uint8_t buf[SmilePayload::kMaxIntSize];
+	auto append_index = [&buf](std::string* bytes, int index)
+	{
+		auto* end = SmilePayload::EncodeInt(buf, static_cast<size_t>(index));
+		bytes->append(reinterpret_cast<const char*>(buf), static_cast<size_t>(end - buf));
+	};
+	for (const auto& tag : common_tags)
+	{
+		append_index(&common_ids_bytes_, index_of(tag.key));
+		append_index(&common_ids_bytes_, index_of(tag.value));
+	}
+	common_tags_size_ = common_tags.size();
+	append_index(&name_index_bytes_, index_of(refs().name()));
+	fixed_ = table_;
+}
+
+void BatchEncoder::start_batch()
+{
+	if (dictionary_.size() > kMaxStrings)
+	{
+		dictionary_.clear();
+	}
+	++batch_;
+	table_ = fixed_;
+	for (auto i = 0u; i < fixed_.size(); ++i)
+	{
+		dictionary_[fixed_[i]] = Slot{batch_, static_cast<int>(i)};
+	}
+	indexes_.clear();
+}
+
+auto BatchEncoder::index_of(StrRef s) -> int
+{
+	auto& slot = dictionary_[s];
+	if (slot.batch != batch_)
+	{
+		slot.batch = batch_;
+		slot.index = static_cast<int>(table_.size());
+		table_.emplace_back(s);
+	}
+	return slot.index;
+}
+
+// only used when a measurement has too many tags to be encoded with a single reservation
+void BatchEncoder::append_measurement(size_t tags_size, Op op, double value, std::vector<int>::const_iterator* index)
+{
+	auto name_value_index = *(*index)++;
+	payload_.Append(tags_size + 1 + common_tags_size_);
+	payload_.AppendEncoded(common_ids_bytes_);
+	for (auto i = 0u; i < tags_size * 2; ++i)
+	{
+		payload_.Append(*(*index)++);
+	}
+	payload_.AppendEncoded(name_index_bytes_);
+	payload_.Append(name_value_index);
+	payload_.Append(static_cast<int>(op));
+	payload_.Append(value);
+}
+
+auto BatchEncoder::Encode(const MeasurementColumns& ms) -> CompressedResult
+{
+	start_batch();
+	auto n = ms.size();
+	for (size_t i = 0; i < n; ++i)
+	{
+		indexes_.emplace_back(index_of(ms.Name(i)));
+		for (const auto* tag = ms.TagsBegin(i); tag != ms.TagsEnd(i); ++tag)
+		{
+			indexes_.emplace_back(index_of(tag->key));
+			indexes_.emplace_back(index_of(tag->value));
+		}
+	}
+
+	payload_.Init();
+	payload_.Append(table_.size());
+	for (const auto& s : table_)
+	{
+		payload_.Append(s.Get());
+	}
+
+	auto index = indexes_.cbegin();
+	for (size_t i = 0; i < n; ++i)
+	{
+		auto tags_size = ms.TagsSize(i);
+		auto max_size = common_ids_bytes_.size() + name_index_bytes_.size() + SmilePayload::kDoubleSize +
+		                SmilePayload::kMaxIntSize * (2 * tags_size + 3);
+		if (max_size > SmilePayload::kMaxReserve)
+		{
+			append_measurement(tags_size, ms.GetOp(i), ms.Value(i), &index);
+			continue;
+		}
+
+		auto* p = payload_.Reserve(max_size);
+		auto name_value_index = *index++;
+		p = SmilePayload::EncodeInt(p, tags_size + 1 + common_tags_size_);
+		memcpy(p, common_ids_bytes_.data(), common_ids_bytes_.size());
+		p += common_ids_bytes_.size();
+		for (auto j = 0u; j < tags_size * 2; ++j)
+		{
+			p = SmilePayload::EncodeInt(p, static_cast<size_t>(*index++));
+		}
+		memcpy(p, name_index_bytes_.data(), name_index_bytes_.size());
+		p += name_index_bytes_.size();
+		p = SmilePayload::EncodeInt(p, static_cast<size_t>(name_value_index));
+		p = SmilePayload::EncodeInt(p, static_cast<size_t>(ms.GetOp(i)));
+		p = SmilePayload::EncodeDouble(p, ms.Value(i));
+		payload_.Commit(p);
+	}
+	return payload_.Result();
+}
+
+}  // namespace spectator
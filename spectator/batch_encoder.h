@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../ska/flat_hash_map.hpp"
+#include "measurement_columns.h"
+#include "smile.h"
+
+namespace spectator
+{
+
+// Encodes batches of measurements as the smile payloads sent to the aggregator.
+// Each payload starts with a table of the strings it uses, and refers to them by
+// their index. The encoder keeps a dictionary of the strings it has seen across
+// batches and publish intervals, so adding a string to the table of a batch is a
+// single lookup, and the common tags are always the first entries of every table.
+// Each measurement is written with a single reservation in the compressor input.
+// Not thread safe: the publisher uses one encoder per sender thread.
+class BatchEncoder
+{
+   public:
+	// an executor is used to compress the chunks of a payload in parallel
+	explicit BatchEncoder(const Tags& common_tags, Codec codec = Codec::Gzip, Executor executor = {});
+
+	auto Encode(const MeasurementColumns& ms) -> CompressedResult;
+
+   private:
+	// forget about strings that are no longer in use once the dictionary gets this big
+	static constexpr size_t kMaxStrings = 256 * 1024;
+
+	struct Slot
+	{
+		uint32_t batch;  // the last batch that used the string
+		int index;       // its index in the table for that batch
+	};
+	// keyed by the interned pointer. A string freed by the pool might leave behind a
+	// slot that gets reused by a new string at the same address, which is harmless
+	ska::flat_hash_map<StrRef, Slot> dictionary_;
+	std::vector<StrRef> fixed_;  // the common tags and the name key
+	size_t common_tags_size_{0};
+	// the indexes of the fixed strings never change, so their encoding is written once
+	std::string common_ids_bytes_;
+	std::string name_index_bytes_;
+
+	uint32_t batch_{0};
+	std::vector<StrRef> table_;  // the strings used by the current batch
+	std::vector<int> indexes_;   // the name and tags of each measurement in the current batch
+	SmilePayload payload_;
+
+	void start_batch();
+	auto index_of(StrRef s) -> int;
+	void append_measurement(size_t tags_size, Op op, double value, std::vector<int>::const_iterator* index);
+};
+
+}  // namespace spectator
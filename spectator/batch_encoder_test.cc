@@ -0,0 +1,190 @@
+#include "batch_encoder.h"
+#include "common_refs.h"
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+#include <map>
+
+namespace
+{
+using spectator::BatchEncoder;
+using spectator::CompressedResult;
+using spectator::gzip_uncompress;
+using spectator::Id;
+using spectator::Measurement;
+using spectator::MeasurementColumns;
+using spectator::Measurements;
+using spectator::SmilePayload;
+using spectator::Tags;
+
+auto uncompress(CompressedResult res) -> std::vector<uint8_t>
+{
+	std::vector<uint8_t> result(1024 * 1024);
+	size_t dest_len = result.size();
+	EXPECT_EQ(gzip_uncompress(result.data(), &dest_len, res.data, res.size), 0);
+	result.resize(dest_len);
+	return result;
+}
+
+auto encode(BatchEncoder* encoder, Measurements::const_iterator first, Measurements::const_iterator last)
+    -> CompressedResult
+{
+	MeasurementColumns columns;
+	for (auto it = first; it != last; ++it)
+	{
+		columns.emplace_back(it->id, it->value);
+	}
+	return encoder->Encode(columns);
+}
+
+// the expected payload for measurements with a single tag, using common tags nf.app=foo
+auto expected_payload(const std::vector<std::string>& strings, const std::vector<std::vector<int>>& measurements)
+    -> std::vector<uint8_t>
+{
+	SmilePayload payload;
+	payload.Init();
+	payload.Append(strings.size());
+	for (const auto& s : strings)
+	{
+		payload.Append(s);
+	}
+	for (const auto& m : measurements)
+	{
+		// nf.app, foo, key, value, name, id.Name, op, value
+		payload.Append(3);
+		payload.Append(0);
+		payload.Append(1);
+		for (auto i = 0u; i < m.size() - 1; ++i)
+		{
+			payload.Append(m[i]);
+		}
+		payload.Append(static_cast<double>(m.back()));
+	}
+	return uncompress(payload.Result());
+}
+
+// encode the measurements one value at a time, assigning indexes in the order strings are used
+auto reference_payload(const Tags& common_tags, const Measurements& measurements) -> std::vector<uint8_t>
+{
+	std::vector<std::string> strings;
+	std::map<std::string, int> indexes;
+	auto index_of = [&](spectator::StrRef s)
+	{
+		auto res = indexes.emplace(s.Get(), static_cast<int>(strings.size()));
+		if (res.second)
+		{
+			strings.emplace_back(s.Get());
+		}
+		return res.first->second;
+	};
+	std::vector<int> common_ids;
+	for (const auto& tag : common_tags)
+	{
+		common_ids.push_back(index_of(tag.key));
+		common_ids.push_back(index_of(tag.value));
+	}
+	auto name_index = index_of(spectator::refs().name());
+	for (const auto& m : measurements)
+	{
+		index_of(m.id.Name());
+		for (const auto& tag : m.id.GetTags())
+		{
+			index_of(tag.key);
+			index_of(tag.value);
+		}
+	}
+
+	SmilePayload payload;
+	payload.Init();
+	payload.Append(strings.size());
+	for (const auto& s : strings)
+	{
+		payload.Append(s);
+	}
+	for (const auto& m : measurements)
+	{
+		const auto& tags = m.id.GetTags();
+		payload.Append(tags.size() + 1 + common_tags.size());
+		for (auto i : common_ids)
+		{
+			payload.Append(i);
+		}
+		for (const auto& tag : tags)
+		{
+			payload.Append(indexes[tag.key.Get()]);
+			payload.Append(indexes[tag.value.Get()]);
+		}
+		payload.Append(name_index);
+		payload.Append(indexes[m.id.Name().Get()]);
+		payload.Append(tags.at(spectator::refs().statistic()) == spectator::refs().count() ? 0 : 10);
+		payload.Append(m.value);
+	}
+	return uncompress(payload.Result());
+}
+
+TEST(BatchEncoder, Encode)
+{
+	Tags common_tags{{"nf.app", "foo"}};
+	BatchEncoder encoder{common_tags};
+
+	auto counter = Id::Of("c", {{"statistic", "count"}});
+	auto gauge = Id::Of("g", {{"statistic", "gauge"}});
+	Measurements measurements{Measurement{counter, 1}, Measurement{gauge, 2}};
+	auto payload = uncompress(encode(&encoder, measurements.begin(), measurements.end()));
+
+	std::vector<std::string> strings{"nf.app", "foo", "name", "c", "statistic", "count", "g", "gauge"};
+	auto expected = expected_payload(strings, {{4, 5, 2, 3, 0, 1}, {4, 7, 2, 6, 10, 2}});
+	EXPECT_EQ(payload, expected);
+}
+
+TEST(BatchEncoder, OnlyStringsInBatch)
+{
+	Tags common_tags{{"nf.app", "foo"}};
+	BatchEncoder encoder{common_tags};
+
+	auto counter = Id::Of("c", {{"statistic", "count"}});
+	auto gauge = Id::Of("g", {{"statistic", "gauge"}});
+	Measurements measurements{Measurement{counter, 1}, Measurement{gauge, 2}};
+	encode(&encoder, measurements.begin(), measurements.end());
+
+	// strings from previous batches are not sent, and indexes are assigned again
+	auto payload = uncompress(encode(&encoder, measurements.begin() + 1, measurements.end()));
+	std::vector<std::string> strings{"nf.app", "foo", "name", "g", "statistic", "gauge"};
+	EXPECT_EQ(payload, expected_payload(strings, {{4, 5, 2, 3, 10, 2}}));
+
+	payload = uncompress(encode(&encoder, measurements.begin(), measurements.end()));
+	strings = {"nf.app", "foo", "name", "c", "statistic", "count", "g", "gauge"};
+	EXPECT_EQ(payload, expected_payload(strings, {{4, 5, 2, 3, 0, 1}, {4, 7, 2, 6, 10, 2}}));
+}
+
+TEST(BatchEncoder, CommonTagsInMeasurement)
+{
+	Tags common_tags{{"nf.app", "foo"}};
+	BatchEncoder encoder{common_tags};
+
+	auto counter = Id::Of("foo", {{"statistic", "count"}});
+	Measurements measurements{Measurement{counter, 1}};
+	auto payload = uncompress(encode(&encoder, measurements.begin(), measurements.end()));
+	std::vector<std::string> strings{"nf.app", "foo", "name", "statistic", "count"};
+	EXPECT_EQ(payload, expected_payload(strings, {{3, 4, 2, 1, 0, 1}}));
+}
+
+TEST(BatchEncoder, ManyTags)
+{
+	Tags common_tags{{"nf.app", "foo"}, {"nf.cluster", "foo-main"}};
+	BatchEncoder encoder{common_tags};
+
+	// too many tags to fit in a single reservation
+	Tags tags{{"statistic", "count"}};
+	for (auto i = 0; i < 2000; ++i)
+	{
+		tags.add(fmt::format("k{}", i), fmt::format("v{}", i));
+	}
+	auto big = Id::Of("big", std::move(tags));
+	auto small = Id::Of("small", {{"statistic", "max"}, {"k1", "v1"}});
+	Measurements measurements{Measurement{small, 1}, Measurement{big, 42}, Measurement{small, 3}};
+
+	auto payload = uncompress(encode(&encoder, measurements.begin(), measurements.end()));
+	EXPECT_EQ(payload, reference_payload(common_tags, measurements));
+}
+
+}  // namespace
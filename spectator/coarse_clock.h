@@ -0,0 +1,46 @@
+#pragma once
+
+#include "absl/time/clock.h"
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+namespace spectator
+{
+
+// The monotonic time the kernel updates on every tick, which is much cheaper to read than
+// the precise clocks, at a resolution of a few milliseconds. Good enough to tell how long
+// something has been idle
+inline auto coarse_monotonic_nanos() noexcept -> int64_t
+{
+#ifdef CLOCK_MONOTONIC_COARSE
+	timespec ts{};
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return int64_t{ts.tv_sec} * 1000 * 1000 * 1000 + ts.tv_nsec;
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+	    .count();
+#endif
+}
+
+inline auto coarse_monotonic_seconds() noexcept -> int64_t
+{
+	return coarse_monotonic_nanos() / (1000 * 1000 * 1000);
+}
+
+// The wall clock, in nanoseconds since the epoch like absl::GetCurrentTimeNanos, at the
+// resolution of the coarse clock. It lags behind the precise time by up to a tick, or a
+// few more milliseconds right after the cpu was idle. Used for the timestamps meters
+// take on every update
+inline auto coarse_realtime_nanos() noexcept -> int64_t
+{
+#ifdef CLOCK_REALTIME_COARSE
+	timespec ts{};
+	clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+	return int64_t{ts.tv_sec} * 1000 * 1000 * 1000 + ts.tv_nsec;
+#else
+	return absl::GetCurrentTimeNanos();
+#endif
+}
+
+}  // namespace spectator
@@ -0,0 +1,171 @@
+#include "codec.h"
+#include <cassert>
+#include <cstring>
+#include <fmt/format.h>
+#include <libdeflate.h>
+#include <stdexcept>
+#include <zstd.h>
+
+namespace spectator
+{
+
+// the fastest levels, compression is the largest cost of publishing
+static constexpr int kLibdeflateLevel = 1;
+static constexpr int kZstdLevel = 1;
+
+auto AbslParseFlag(absl::string_view text, Codec* codec, std::string* error) -> bool
+{
+	if (text == "gzip")
+	{
+		*codec = Codec::Gzip;
+	}
+	else if (text == "identity")
+	{
+		*codec = Codec::Identity;
+	}
+	else if (text == "libdeflate")
+	{
+		*codec = Codec::Libdeflate;
+	}
+	else if (text == "zstd")
+	{
+		*codec = Codec::Zstd;
+	}
+	else
+	{
+		*error = "must be one of gzip, identity, libdeflate or zstd";
+		return false;
+	}
+	return true;
+}
+
+auto AbslUnparseFlag(Codec codec) -> std::string
+{
+	switch (codec)
+	{
+		case Codec::Gzip:
+			return "gzip";
+		case Codec::Identity:
+			return "identity";
+		case Codec::Libdeflate:
+			return "libdeflate";
+		case Codec::Zstd:
+			return "zstd";
+	}
+	return "gzip";
+}
+
+auto deflate_init(z_stream* stream) -> void
+{
+	stream->zalloc = static_cast<alloc_func>(nullptr);
+	stream->zfree = static_cast<free_func>(nullptr);
+	stream->opaque = static_cast<voidpf>(nullptr);
+
+	auto err = deflateInit2(stream, Z_BEST_SPEED, Z_DEFLATED, kWindowBits, kMemLevel, Z_DEFAULT_STRATEGY);
+	if (err != Z_OK)
+	{
+		throw std::runtime_error(fmt::format("Unable to init zlib: {}", err));
+	}
+}
+
+BlockCompressor::BlockCompressor(Codec codec) : codec_{codec}
+{
+	switch (codec_)
+	{
+		case Codec::Gzip:
+			deflate_init(&stream_);
+			break;
+		case Codec::Libdeflate:
+			libdeflate_ = libdeflate_alloc_compressor(kLibdeflateLevel);
+			if (libdeflate_ == nullptr)
+			{
+				throw std::runtime_error("Unable to allocate a libdeflate compressor");
+			}
+			break;
+		case Codec::Zstd:
+			zstd_ = ZSTD_createCCtx();
+			if (zstd_ == nullptr)
+			{
+				throw std::runtime_error("Unable to allocate a zstd context");
+			}
+			break;
+		case Codec::Identity:
+			break;
+	}
+}
+
+BlockCompressor::~BlockCompressor()
+{
+	switch (codec_)
+	{
+		case Codec::Gzip:
+			deflateEnd(&stream_);
+			break;
+		case Codec::Libdeflate:
+			libdeflate_free_compressor(libdeflate_);
+			break;
+		case Codec::Zstd:
+			ZSTD_freeCCtx(zstd_);
+			break;
+		case Codec::Identity:
+			break;
+	}
+}
+
+auto BlockCompressor::Compress(const uint8_t* data, size_t size, std::vector<uint8_t>* out) -> size_t
+{
+	switch (codec_)
+	{
+		case Codec::Gzip:
+		{
+			deflateReset(&stream_);
+			auto bound = deflateBound(&stream_, size);
+			if (out->size() < bound)
+			{
+				out->resize(bound);
+			}
+			stream_.next_in = const_cast<Bytef*>(data);
+			stream_.avail_in = static_cast<uInt>(size);
+			stream_.next_out = out->data();
+			stream_.avail_out = static_cast<uInt>(out->size());
+			// there is room for the whole member, so this always gets to the end of the stream
+			[[maybe_unused]] auto err = deflate(&stream_, Z_FINISH);
+			assert(err == Z_STREAM_END);
+			return stream_.total_out;
+		}
+		case Codec::Libdeflate:
+		{
+			auto bound = libdeflate_gzip_compress_bound(libdeflate_, size);
+			if (out->size() < bound)
+			{
+				out->resize(bound);
+			}
+			// only returns 0 when the output does not fit, which the bound rules out
+			return libdeflate_gzip_compress(libdeflate_, data, size, out->data(), out->size());
+		}
+		case Codec::Zstd:
+		{
+			auto bound = ZSTD_compressBound(size);
+			if (out->size() < bound)
+			{
+				out->resize(bound);
+			}
+			auto res = ZSTD_compressCCtx(zstd_, out->data(), out->size(), data, size, kZstdLevel);
+			if (ZSTD_isError(res) != 0U)
+			{
+				throw std::runtime_error(fmt::format("Unable to compress with zstd: {}", ZSTD_getErrorName(res)));
+			}
+			return res;
+		}
+		case Codec::Identity:
+			break;
+	}
+	if (out->size() < size)
+	{
+		out->resize(size);
+	}
+	std::memcpy(out->data(), data, size);
+	return size;
+}
+
+}  // namespace spectator
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "gzip.h"
+#include "absl/strings/string_view.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct libdeflate_compressor;
+struct ZSTD_CCtx_s;
+
+namespace spectator
+{
+
+// How publish payloads are compressed:
+//   Gzip: deflate at the fastest level, which the aggregator always accepts
+//   Identity: no compression, for aggregators reached over a local connection,
+//             where the CPU used by deflate costs more than the bytes it saves
+//   Libdeflate: the same gzip format, compressed in one shot by libdeflate, which
+//               is faster than zlib and compresses a bit better at the same level
+//   Zstd: zstd frames, for aggregators that accept Content-Encoding: zstd
+enum class Codec
+{
+	Gzip,
+	Identity,
+	Libdeflate,
+	Zstd
+};
+
+static constexpr const char* const kGzipEncoding = "Content-Encoding: gzip";
+static constexpr const char* const kZstdEncoding = "Content-Encoding: zstd";
+
+// the Content-Encoding header for payloads using the codec, or nullptr when the
+// header should not be sent
+[[nodiscard]] constexpr auto ContentEncoding(Codec codec) -> const char*
+{
+	switch (codec)
+	{
+		case Codec::Identity:
+			return nullptr;
+		case Codec::Zstd:
+			return kZstdEncoding;
+		case Codec::Gzip:
+		case Codec::Libdeflate:
+			break;
+	}
+	return kGzipEncoding;
+}
+
+// used by absl flags, and to parse the codec from a config value
+auto AbslParseFlag(absl::string_view text, Codec* codec, std::string* error) -> bool;
+auto AbslUnparseFlag(Codec codec) -> std::string;
+
+// set up stream to write gzip at the fastest level, throws if zlib can not
+auto deflate_init(z_stream* stream) -> void;
+
+// Compresses a whole buffer at once with one of the codecs, keeping the state of the
+// compressor between calls. Gzip and libdeflate write a gzip member and zstd a frame,
+// so the output of several calls can be concatenated into a single payload.
+class BlockCompressor
+{
+   public:
+	explicit BlockCompressor(Codec codec);
+	BlockCompressor(const BlockCompressor&) = delete;
+	BlockCompressor(BlockCompressor&&) = delete;
+	auto operator=(const BlockCompressor&) -> BlockCompressor& = delete;
+	auto operator=(BlockCompressor&&) -> BlockCompressor& = delete;
+	~BlockCompressor();
+
+	// compress size bytes from data into the start of out, which is grown to the
+	// worst case size for the input if needed. Returns the compressed size
+	auto Compress(const uint8_t* data, size_t size, std::vector<uint8_t>* out) -> size_t;
+
+   private:
+	Codec codec_;
+	z_stream stream_{};
+	libdeflate_compressor* libdeflate_{nullptr};
+	ZSTD_CCtx_s* zstd_{nullptr};
+};
+
+}  // namespace spectator
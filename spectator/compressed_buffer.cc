@@ -1,5 +1,8 @@
 #include "compressed_buffer.h"
-#include <fmt/format.h>
+#include <algorithm>
+#include <condition_variable>
+#include <iterator>
+#include <mutex>
 
 #ifndef z_const
 #define z_const
@@ -8,10 +11,80 @@
 namespace spectator
 {
 
-CompressedBuffer::CompressedBuffer(size_t chunk_size_input, size_t out_size, size_t chunk_size_output)
-    : chunk_size_input_(chunk_size_input), chunk_size_output_(chunk_size_output), stream{}
+// A chunk of input compressed as a gzip member or zstd frame of its own. It is compressed by
+// whoever takes it first: the task handed to the executor, or the buffer when
+// it needs the result. Tasks keep the chunk alive, and do nothing if they run
+// after it was taken, even if it has been reused for another payload by then.
+struct CompressedBuffer::Chunk
+{
+	Chunk(size_t slab_size, Codec codec) : slab{new uint8_t[slab_size]}, compressor{codec} {}
+	Chunk(const Chunk&) = delete;
+	Chunk(Chunk&&) = delete;
+	auto operator=(const Chunk&) -> Chunk& = delete;
+	auto operator=(Chunk&&) -> Chunk& = delete;
+	~Chunk() = default;
+
+	enum class State
+	{
+		Done,
+		Pending,
+		Running
+	};
+
+	std::mutex mutex;
+	std::condition_variable done_cv;
+	State state{State::Done};
+	std::unique_ptr<uint8_t[]> slab;
+	size_t size{0};
+	std::vector<uint8_t> out;
+	size_t out_size{0};
+	BlockCompressor compressor;
+
+	void Submit(size_t input_size)
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		size = input_size;
+		state = State::Pending;
+	}
+
+	// compress the chunk if nobody took it yet
+	auto Run() -> bool
+	{
+		{
+			std::lock_guard<std::mutex> lock{mutex};
+			if (state != State::Pending)
+			{
+				return false;
+			}
+			state = State::Running;
+		}
+
+		out_size = compressor.Compress(slab.get(), size, &out);
+
+		{
+			std::lock_guard<std::mutex> lock{mutex};
+			state = State::Done;
+		}
+		done_cv.notify_all();
+		return true;
+	}
+
+	void Wait()
+	{
+		std::unique_lock<std::mutex> lock{mutex};
+		done_cv.wait(lock, [this]() { return state == State::Done; });
+	}
+};
+
+CompressedBuffer::CompressedBuffer(size_t chunk_size_input, size_t out_size, size_t chunk_size_output, Codec codec,
+                                   Executor executor)
+    : codec_{codec},
+      executor_{std::move(executor)},
+      slab_{new uint8_t[chunk_size_input + kMaxReserve]},
+      chunk_size_input_(chunk_size_input),
+      chunk_size_output_(chunk_size_output),
+      stream{}
 {
-	cur_.reserve(chunk_size_input + 16 * 1024);
 	dest_.resize(out_size);
 }
 
@@ -23,13 +96,47 @@ CompressedBuffer::~CompressedBuffer()
 
 auto CompressedBuffer::maybe_compress() -> void
 {
-	if (cur_.size() > chunk_size_input_)
+	if (used_ > chunk_size_input_)
 	{
-		compress(Z_NO_FLUSH);
-		cur_.clear();
+		if (parallel())
+		{
+			submit_chunk(true);
+		}
+		else
+		{
+			compress(Z_NO_FLUSH);
+		}
 	}
 }
 
+auto CompressedBuffer::append_string(std::string_view s) -> void
+{
+	if (s.size() <= kMaxReserve)
+	{
+		auto* p = Reserve(s.size());
+		memcpy(p, s.data(), s.size());
+		used_ += s.size();
+		return;
+	}
+
+	if (parallel())
+	{
+		// chunks own their input, so the string is copied into them
+		for (size_t i = 0; i < s.size(); i += kMaxReserve)
+		{
+			auto n = std::min(kMaxReserve, s.size() - i);
+			memcpy(Reserve(n), s.data() + i, n);
+			used_ += n;
+			maybe_compress();
+		}
+		return;
+	}
+
+	// keep the order of the input
+	compress(Z_NO_FLUSH);
+	compress(reinterpret_cast<const uint8_t*>(s.data()), s.size(), Z_NO_FLUSH);
+}
+
 auto CompressedBuffer::deflate_chunk(size_t chunk_size, int flush) -> int
 {
 	auto avail_out = dest_.size() - dest_index_;
@@ -47,11 +154,41 @@ auto CompressedBuffer::deflate_chunk(size_t chunk_size, int flush) -> int
 	return err;
 }
 
+static auto append_to(std::vector<uint8_t>* buf, size_t* used, const uint8_t* data, size_t size) -> void
+{
+	if (buf->size() - *used < size)
+	{
+		buf->resize(std::max(buf->size() * 2, *used + size));
+	}
+	memcpy(buf->data() + *used, data, size);
+	*used += size;
+}
+
+auto CompressedBuffer::copy(const uint8_t* data, size_t size) -> void { append_to(&dest_, &dest_index_, data, size); }
+
 // compress the current chunk
 auto CompressedBuffer::compress(int flush) -> void
 {
-	stream.avail_in = cur_.size();
-	stream.next_in = reinterpret_cast<z_const Bytef*>(const_cast<uint8_t*>(cur_.data()));
+	compress(slab_.get(), used_, flush);
+	used_ = 0;
+}
+
+auto CompressedBuffer::compress(const uint8_t* data, size_t size, int flush) -> void
+{
+	if (codec_ == Codec::Identity)
+	{
+		copy(data, size);
+		return;
+	}
+	if (one_shot())
+	{
+		// keep the whole payload, it is compressed at once by Result
+		append_to(&input_, &input_size_, data, size);
+		return;
+	}
+
+	stream.avail_in = static_cast<uInt>(size);
+	stream.next_in = reinterpret_cast<z_const Bytef*>(const_cast<uint8_t*>(data));
 
 	int err = Z_OK;
 	while (stream.avail_in > 0 && err == Z_OK)
@@ -74,27 +211,81 @@ auto CompressedBuffer::Result() -> CompressedResult
 	if (init_)
 	{
 		init_ = false;
-		compress(Z_FINISH);
-		deflateEnd(&stream);
+		if (parallel())
+		{
+			// the last chunk is compressed here, there is no point in waiting for a task
+			submit_chunk(false);
+			finish_chunks();
+		}
+		else if (one_shot())
+		{
+			compress(Z_FINISH);
+			if (!block_)
+			{
+				block_ = std::make_unique<BlockCompressor>(codec_);
+			}
+			dest_index_ = block_->Compress(input_.data(), input_size_, &dest_);
+		}
+		else
+		{
+			compress(Z_FINISH);
+			if (codec_ != Codec::Identity)
+			{
+				deflateEnd(&stream);
+			}
+		}
 	}
-	return CompressedResult{dest_.data(), stream.total_out};
+	return CompressedResult{dest_.data(), dest_index_, ContentEncoding(codec_)};
 }
 
 auto CompressedBuffer::Init() -> void
 {
-	cur_.clear();
+	used_ = 0;
 	init_ = true;
 	dest_index_ = 0;
+	input_size_ = 0;
+	if (codec_ == Codec::Identity || one_shot() || parallel())
+	{
+		return;
+	}
+	deflate_init(&stream);
+}
 
-	stream.zalloc = static_cast<alloc_func>(nullptr);
-	stream.zfree = static_cast<free_func>(nullptr);
-	stream.opaque = static_cast<voidpf>(nullptr);
+auto CompressedBuffer::submit_chunk(bool schedule) -> void
+{
+	std::shared_ptr<Chunk> chunk;
+	if (free_chunks_.empty())
+	{
+		chunk = std::make_shared<Chunk>(chunk_size_input_ + kMaxReserve, codec_);
+	}
+	else
+	{
+		chunk = std::move(free_chunks_.back());
+		free_chunks_.pop_back();
+	}
+	// the chunk takes the input, and gives us the slab it was done with
+	std::swap(slab_, chunk->slab);
+	chunk->Submit(used_);
+	used_ = 0;
+	chunks_.emplace_back(chunk);
+	if (schedule)
+	{
+		executor_([chunk]() { chunk->Run(); });
+	}
+}
 
-	auto err = deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, kWindowBits, kMemLevel, Z_DEFAULT_STRATEGY);
-	if (err != Z_OK)
+auto CompressedBuffer::finish_chunks() -> void
+{
+	for (const auto& chunk : chunks_)
 	{
-		throw std::runtime_error(fmt::format("Unable to init zlib: {}", err));
+		if (!chunk->Run())
+		{
+			chunk->Wait();
+		}
+		copy(chunk->out.data(), chunk->out_size);
 	}
+	std::move(chunks_.begin(), chunks_.end(), std::back_inserter(free_chunks_));
+	chunks_.clear();
 }
 
 }  // namespace spectator
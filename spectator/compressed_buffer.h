@@ -1,8 +1,12 @@
 #pragma once
 
+#include "codec.h"
 #include "gzip.h"
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include <string_view>
 #include <vector>
 
@@ -13,17 +17,30 @@ struct CompressedResult
 {
 	const uint8_t* data;
 	size_t size;
+	const char* content_encoding{kGzipEncoding};
 };
 
+// runs a task on another thread
+using Executor = std::function<void(std::function<void()>)>;
+
 class CompressedBuffer
 {
    public:
 	static constexpr size_t kDefaultChunkSizeInput = 256 * 1024;
 	static constexpr size_t kDefaultOutSize = 256 * 1024;
 	static constexpr size_t kDefaultChunkSizeOutput = 32 * 1024;
+	// the largest number of bytes that can be written at once with Reserve
+	static constexpr size_t kMaxReserve = 16 * 1024;
 
+	// With an executor, compressed payloads are written as a multi-member gzip stream, or a
+	// sequence of zstd frames, where each chunk of input is compressed independently by the
+	// executor, while the rest of the payload is being appended. Result compresses the chunks
+	// that were not picked up yet, so it never waits on tasks that did not start.
+	// Without one, libdeflate and zstd, which can not be streamed, keep the whole payload
+	// and compress it at once in Result.
 	explicit CompressedBuffer(size_t chunk_size_input = kDefaultChunkSizeInput, size_t out_size = kDefaultOutSize,
-	                          size_t chunk_size_output = kDefaultChunkSizeOutput);
+	                          size_t chunk_size_output = kDefaultChunkSizeOutput, Codec codec = Codec::Gzip,
+	                          Executor executor = {});
 	CompressedBuffer(const CompressedBuffer&) = delete;
 	CompressedBuffer(CompressedBuffer&&) = default;
 	auto operator=(const CompressedBuffer&) -> CompressedBuffer& = delete;
@@ -57,16 +74,52 @@ class CompressedBuffer
 		maybe_compress();
 	}
 
+	/**
+	 * Get a pointer to write up to n bytes directly into the input of the compressor,
+	 * n must be at most kMaxReserve. The input is compressed once it goes over the chunk
+	 * size, so there is always room for kMaxReserve bytes, and callers only need to
+	 * reserve once for a group of values, and then Commit the end of what they wrote.
+	 */
+	auto Reserve([[maybe_unused]] size_t n) -> uint8_t*
+	{
+		assert(init_);
+		assert(n <= kMaxReserve);
+		return slab_.get() + used_;
+	}
+
+	auto Commit(const uint8_t* end) -> void
+	{
+		used_ = static_cast<size_t>(end - slab_.get());
+		assert(used_ <= chunk_size_input_ + kMaxReserve);
+		maybe_compress();
+	}
+
 	auto Result() -> CompressedResult;
 
    private:
+	struct Chunk;
+
+	Codec codec_;
+	Executor executor_;
 	bool init_{false};
-	std::vector<uint8_t> cur_;
+	// a fixed size input buffer, with room for the chunk size plus one reservation
+	std::unique_ptr<uint8_t[]> slab_;
+	size_t used_{0};
 	size_t chunk_size_input_;
 	std::vector<uint8_t> dest_;
 	size_t chunk_size_output_;
-	int dest_index_{0};
+	size_t dest_index_{0};
 	z_stream stream;
+	// the payload for the codecs compressed at once, and their compressor
+	std::vector<uint8_t> input_;
+	size_t input_size_{0};
+	std::unique_ptr<BlockCompressor> block_;
+	// the chunks of the current payload when compressing in parallel, and the
+	// ones that can be reused
+	std::vector<std::shared_ptr<Chunk>> chunks_;
+	std::vector<std::shared_ptr<Chunk>> free_chunks_;
+
+	auto compress(const uint8_t* data, size_t size, int flush) -> void;
 
 	auto compress(int flush) -> void;
 
@@ -74,19 +127,40 @@ class CompressedBuffer
 
 	auto deflate_chunk(size_t chunk_size, int flush) -> int;
 
+	// the identity codec copies its input to the output
+	auto copy(const uint8_t* data, size_t size) -> void;
+
+	[[nodiscard]] auto parallel() const -> bool { return executor_ && codec_ != Codec::Identity; }
+
+	[[nodiscard]] auto one_shot() const -> bool
+	{
+		return !executor_ && (codec_ == Codec::Libdeflate || codec_ == Codec::Zstd);
+	}
+
+	// start a new chunk with the current input, and hand it to the executor if schedule is set
+	auto submit_chunk(bool schedule) -> void;
+
+	// wait for the chunks of the payload, and concatenate their output
+	auto finish_chunks() -> void;
+
+	// strings too big to fit in a reservation are compressed from where they are
+	auto append_string(std::string_view s) -> void;
+
 	template <typename... Args>
 	auto AppendImpl(Args&&... args) -> void
 	{
 		if constexpr ((std::is_convertible_v<std::decay_t<Args>, std::string_view> && ...))
 		{
 			static_assert(sizeof...(args) == 1, "Only one string-like argument is allowed.");
-			(cur_.insert(cur_.end(), std::forward<Args>(args).begin(), std::forward<Args>(args).end()), ...);
+			(append_string(std::string_view{std::forward<Args>(args)}), ...);
 		}
 		else if constexpr ((std::is_same_v<std::decay_t<Args>, uint8_t> && ...))
 		{
 			static_assert(sizeof...(args) >= 1 && sizeof...(args) <= 6,
 			              "The number of uint8_t arguments must be between 1 and 6.");
-			(cur_.push_back(std::forward<Args>(args)), ...);
+			auto* p = Reserve(sizeof...(args));
+			((*p++ = args), ...);
+			used_ += sizeof...(args);
 		}
 	}
 };
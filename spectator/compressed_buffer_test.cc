@@ -3,13 +3,35 @@
 #include "compressed_buffer.h"
 #include "gzip.h"
 #include "absl/strings/str_cat.h"
+#include <zstd.h>
 
 namespace
 {
 
+using spectator::Codec;
 using spectator::CompressedBuffer;
 using spectator::gzip_uncompress;
 
+// uncompress a payload of expected_size bytes, returning an empty string if it is invalid
+auto uncompress(Codec codec, const spectator::CompressedResult& res, size_t expected_size) -> std::string
+{
+	std::vector<char> uncompressed(expected_size + 1);
+	size_t dest_len = uncompressed.size();
+	if (codec == Codec::Zstd)
+	{
+		dest_len = ZSTD_decompress(uncompressed.data(), uncompressed.size(), res.data, res.size);
+		if (ZSTD_isError(dest_len) != 0U)
+		{
+			return {};
+		}
+	}
+	else if (gzip_uncompress(uncompressed.data(), &dest_len, res.data, res.size) != Z_OK)
+	{
+		return {};
+	}
+	return std::string(uncompressed.data(), dest_len);
+}
+
 TEST(CompressedBuffer, Basic)
 {
 	std::string string1(1000, 'a');
@@ -47,6 +69,131 @@ TEST(CompressedBuffer, Basic)
 	EXPECT_EQ(result2, expected);
 }
 
+TEST(CompressedBuffer, Identity)
+{
+	std::string big(CompressedBuffer::kMaxReserve + 1, 'b');
+	CompressedBuffer buf{1024, 32, 32, Codec::Identity};
+	buf.Init();
+	buf.Append(static_cast<uint8_t>('a'));
+	buf.Append(big);
+	buf.Append(static_cast<uint8_t>('c'), static_cast<uint8_t>('d'));
+	auto res = buf.Result();
+
+	EXPECT_EQ(res.content_encoding, nullptr);
+	std::string result{reinterpret_cast<const char*>(res.data), res.size};
+	EXPECT_EQ(result, absl::StrCat("a", big, "cd"));
+
+	buf.Init();
+	buf.Append(std::string{"foo"});
+	res = buf.Result();
+	EXPECT_EQ(std::string(reinterpret_cast<const char*>(res.data), res.size), "foo");
+}
+
+TEST(CompressedBuffer, OneShot)
+{
+	for (auto codec : {Codec::Libdeflate, Codec::Zstd})
+	{
+		std::string big(CompressedBuffer::kMaxReserve + 1, 'b');
+		CompressedBuffer buf{1024, 32, 32, codec};
+		buf.Init();
+		std::string expected;
+		for (auto i = 0; i < 10; ++i)
+		{
+			std::string s(500, static_cast<char>('a' + i));
+			buf.Append(s);
+			expected += s;
+		}
+		buf.Append(big);
+		buf.Append(static_cast<uint8_t>('c'), static_cast<uint8_t>('d'));
+		expected += big + "cd";
+		auto res = buf.Result();
+		EXPECT_STREQ(res.content_encoding, spectator::ContentEncoding(codec));
+		EXPECT_LT(res.size, expected.size());
+		EXPECT_EQ(uncompress(codec, res, expected.size()), expected) << AbslUnparseFlag(codec);
+
+		// make sure we can reuse the buffer
+		buf.Init();
+		buf.Append(std::string{"foo"});
+		res = buf.Result();
+		EXPECT_EQ(uncompress(codec, res, 3), "foo") << AbslUnparseFlag(codec);
+	}
+}
+
+TEST(CompressedBuffer, Parallel)
+{
+	for (auto codec : {Codec::Gzip, Codec::Libdeflate, Codec::Zstd})
+	{
+		std::vector<std::function<void()>> tasks;
+		auto executor = [&tasks](std::function<void()> task) { tasks.emplace_back(std::move(task)); };
+		CompressedBuffer buf{1024, 32, 32, codec, executor};
+
+		std::string expected;
+		auto check = [&buf, &expected, codec]()
+		{
+			auto res = buf.Result();
+			EXPECT_STREQ(res.content_encoding, spectator::ContentEncoding(codec));
+			EXPECT_EQ(uncompress(codec, res, expected.size()), expected) << AbslUnparseFlag(codec);
+		};
+
+		// none of the tasks ran, the chunks are compressed by Result
+		buf.Init();
+		for (auto i = 0; i < 10; ++i)
+		{
+			std::string s(500, static_cast<char>('a' + i));
+			buf.Append(s);
+			expected += s;
+		}
+		std::string big(CompressedBuffer::kMaxReserve * 2 + 3, 'z');
+		buf.Append(big);
+		expected += big;
+		EXPECT_GT(tasks.size(), 2);
+		check();
+
+		// tasks that run late have nothing to do, and the chunks can be reused
+		for (auto& task : tasks)
+		{
+			task();
+		}
+		tasks.clear();
+		buf.Init();
+		expected.clear();
+		for (auto i = 0; i < 10; ++i)
+		{
+			std::string s(300, static_cast<char>('0' + i));
+			buf.Append(s);
+			expected += s;
+			for (auto& task : tasks)
+			{
+				task();
+			}
+			tasks.clear();
+		}
+		check();
+	}
+}
+
+TEST(CompressedBuffer, ParseCodec)
+{
+	Codec codec;
+	std::string error;
+	EXPECT_TRUE(AbslParseFlag("identity", &codec, &error));
+	EXPECT_EQ(codec, Codec::Identity);
+	EXPECT_TRUE(AbslParseFlag("gzip", &codec, &error));
+	EXPECT_EQ(codec, Codec::Gzip);
+	EXPECT_EQ(AbslUnparseFlag(codec), "gzip");
+	EXPECT_STREQ(spectator::ContentEncoding(codec), spectator::kGzipEncoding);
+	EXPECT_TRUE(AbslParseFlag("libdeflate", &codec, &error));
+	EXPECT_EQ(codec, Codec::Libdeflate);
+	EXPECT_STREQ(spectator::ContentEncoding(codec), spectator::kGzipEncoding);
+	EXPECT_TRUE(AbslParseFlag("zstd", &codec, &error));
+	EXPECT_EQ(codec, Codec::Zstd);
+	EXPECT_EQ(AbslUnparseFlag(codec), "zstd");
+	EXPECT_STREQ(spectator::ContentEncoding(codec), spectator::kZstdEncoding);
+
+	EXPECT_FALSE(AbslParseFlag("zip", &codec, &error));
+	EXPECT_FALSE(error.empty());
+}
+
 // This test is commented out intentionally. Uncomment this test to ensure the correct behavior
 // of each static assert. This is to ensure specefic behavior for the templated Append
 /*
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "absl/time/time.h"
+#include "codec.h"
 #include <map>
 #include <memory>
 #include <string>
@@ -49,6 +50,14 @@ class Config
 	bool external_enabled = false;
 	bool status_metrics_enabled = true;
 	bool verbose_http = false;
+	// free the interned names and tags from clients once no meter uses them
+	bool reclaim_strings = false;
+	// max number of connections used to publish, each one can multiplex requests with HTTP/2
+	size_t publish_connections = 8;
+	// how publish payloads are compressed
+	Codec compression = Codec::Gzip;
+	// compress the chunks of large gzip payloads in parallel, as a multi-member gzip stream
+	bool parallel_compression = false;
 
 	// sub-classes can override this method implementing custom logic
 	// that can disable publishing under certain conditions
@@ -1,15 +1,15 @@
 #include "counter.h"
-#include "atomicnumber.h"
 #include "common_refs.h"
 
 namespace spectator
 {
 
-Counter::Counter(Id id) noexcept : Meter{std::move(id)}, count_{0.0} {}
+Counter::Counter(Id id) noexcept : Meter{std::move(id)} {}
 
-void Counter::Measure(Measurements* results) const noexcept
+template <typename Results>
+void Counter::Measure(Results* results) const noexcept
 {
-	auto count = count_.exchange(0.0, std::memory_order_relaxed);
+	auto count = count_.SumThenReset();
 	if (count > 0)
 	{
 		if (!count_id_)
@@ -30,9 +30,13 @@ void Counter::Add(double delta) noexcept
 	{
 		return;
 	}
-	add_double(&count_, delta);
+	count_.Add(delta);
+	MarkDirty();
 }
 
-auto Counter::Count() const noexcept -> double { return count_.load(std::memory_order_relaxed); }
+auto Counter::Count() const noexcept -> double { return count_.Sum(); }
+
+template void Counter::Measure(Measurements* results) const noexcept;
+template void Counter::Measure(MeasurementColumns* results) const noexcept;
 
 }  // namespace spectator
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "meter.h"
-#include <atomic>
+#include "striped_adder.h"
 
 namespace spectator
 {
@@ -10,14 +10,15 @@ class Counter : public Meter
 {
    public:
 	explicit Counter(Id id) noexcept;
-	auto Measure(Measurements* results) const noexcept -> void;
+	template <typename Results>
+	auto Measure(Results* results) const noexcept -> void;
 	auto Increment() noexcept -> void;
 	auto Add(double delta) noexcept -> void;
 	[[nodiscard]] auto Count() const noexcept -> double;
 
    private:
 	mutable std::unique_ptr<Id> count_id_;
-	mutable std::atomic<double> count_;
+	mutable StripedAdder<double> count_;
 };
 
 }  // namespace spectator
@@ -97,7 +97,7 @@ TEST(Counter, Updated)
 	auto t2 = counter.Updated();
 	EXPECT_EQ(t1, t2);
 
-	usleep(1);
+	usleep(20000);  // 20ms, longer than a tick of the coarse clock
 	counter.Increment();
 	EXPECT_TRUE(counter.Updated() > t1);
 }
@@ -0,0 +1,294 @@
+#pragma once
+
+// The easy handles shared by the blocking and the asynchronous http clients.
+
+#include "http_client.h"
+#include "version.h"
+
+#include <cstring>
+#include <curl/curl.h>
+#include <fmt/format.h>
+
+namespace spectator
+{
+
+class LogEntry;
+
+class CurlHeaders
+{
+   public:
+	CurlHeaders() = default;
+	~CurlHeaders() { curl_slist_free_all(list_); }
+	CurlHeaders(const CurlHeaders&) = delete;
+	CurlHeaders(CurlHeaders&&) = delete;
+	auto operator=(const CurlHeaders&) -> CurlHeaders& = delete;
+	auto operator=(CurlHeaders&&) -> CurlHeaders& = delete;
+	void append(const std::string& string) { list_ = curl_slist_append(list_, string.c_str()); }
+	auto headers() -> curl_slist* { return list_; }
+
+   private:
+	curl_slist* list_{nullptr};
+};
+
+namespace detail
+{
+
+inline auto curl_ignore_output_fun(char* /*unused*/, size_t size, size_t nmemb, void* /*unused*/) -> size_t
+{
+	return size * nmemb;
+}
+
+inline auto curl_capture_output_fun(char* contents, size_t size, size_t nmemb, void* userp) -> size_t
+{
+	auto real_size = size * nmemb;
+	auto* resp = static_cast<std::string*>(userp);
+	resp->append(contents, real_size);
+	return real_size;
+}
+
+inline auto curl_capture_headers_fun(char* contents, size_t size, size_t nmemb, void* userp) -> size_t
+{
+	auto real_size = size * nmemb;
+	auto end = contents + real_size;
+	auto* headers = static_cast<HttpHeaders*>(userp);
+	// see if it's a proper header and not HTTP/xx or the final \n
+	auto p = static_cast<char*>(memchr(contents, ':', real_size));
+	if (p != nullptr && p + 2 < end)
+	{
+		std::string key{contents, p};
+		std::string value{p + 2, end - 1};  // drop last lf
+		headers->emplace(std::make_pair(std::move(key), std::move(value)));
+	}
+	return real_size;
+}
+
+class CurlHandle
+{
+   public:
+	CurlHandle() noexcept : handle_{curl_easy_init()} { apply_persistent_settings(); }
+
+	CurlHandle(const CurlHandle&) = delete;
+
+	auto operator=(const CurlHandle&) -> CurlHandle& = delete;
+
+	CurlHandle(CurlHandle&& other) = delete;
+
+	auto operator=(CurlHandle&& other) -> CurlHandle& = delete;
+
+	~CurlHandle()
+	{
+		// nullptr is handled by curl
+		curl_easy_cleanup(handle_);
+	}
+
+	[[nodiscard]] auto handle() const noexcept -> CURL* { return handle_; }
+
+	[[nodiscard]] auto perform() const -> CURLcode { return curl_easy_perform(handle()); }
+
+	auto set_opt(CURLoption option, const void* param) const -> CURLcode
+	{
+		return curl_easy_setopt(handle(), option, param);
+	}
+
+	[[nodiscard]] auto status_code() const -> int
+	{
+		// curl requires this to be a long
+		long http_code = 400;
+		curl_easy_getinfo(handle(), CURLINFO_RESPONSE_CODE, &http_code);
+		return static_cast<int>(http_code);
+	}
+
+	[[nodiscard]] auto response() const -> std::string { return response_; }
+
+	void move_response(std::string* out) { *out = std::move(response_); }
+
+	[[nodiscard]] auto headers() const -> HttpHeaders { return resp_headers_; }
+
+	void move_headers(HttpHeaders* out) { *out = std::move(resp_headers_); }
+
+	void set_url(const std::string& url) const { set_opt(CURLOPT_URL, url.c_str()); }
+
+	void set_headers(std::shared_ptr<CurlHeaders> headers)
+	{
+		headers_ = std::move(headers);
+		set_opt(CURLOPT_HTTPHEADER, headers_->headers());
+	}
+
+	void set_connect_timeout(absl::Duration connect_timeout)
+	{
+		auto millis = absl::ToInt64Milliseconds(connect_timeout);
+		curl_easy_setopt(handle_, CURLOPT_CONNECTTIMEOUT_MS, millis);
+	}
+
+	void set_timeout(absl::Duration total_timeout)
+	{
+		auto millis = absl::ToInt64Milliseconds(total_timeout);
+		curl_easy_setopt(handle_, CURLOPT_TIMEOUT_MS, millis);
+	}
+
+	void post_payload(const void* payload, size_t size)
+	{
+		payload_ = payload;
+		curl_easy_setopt(handle_, CURLOPT_POST, 1L);
+		curl_easy_setopt(handle_, CURLOPT_POSTFIELDS, payload_);
+		curl_easy_setopt(handle_, CURLOPT_POSTFIELDSIZE, size);
+	}
+
+	void custom_request(const char* method) { curl_easy_setopt(handle_, CURLOPT_CUSTOMREQUEST, method); }
+
+	void configure_metatron(const HttpClientConfig& config)
+	{
+		// provide metatron client certificate during handshake
+		curl_easy_setopt(handle_, CURLOPT_SSLCERT, config.cert_info.ssl_cert.c_str());
+		curl_easy_setopt(handle_, CURLOPT_SSLKEY, config.cert_info.ssl_key.c_str());
+		// disable use of system CAs
+		curl_easy_setopt(handle_, CURLOPT_CAPATH, NULL);
+		// perform full trust verification of server based on metatron CAs
+		curl_easy_setopt(handle_, CURLOPT_SSL_VERIFYPEER, 1);
+		curl_easy_setopt(handle_, CURLOPT_CAINFO, config.cert_info.ca_info.c_str());
+		// install Metatron verifier and provide application name to check
+		curl_easy_setopt(handle_, CURLOPT_SSL_CTX_FUNCTION, metatron::sslctx_metatron_verify);
+		curl_easy_setopt(handle_, CURLOPT_SSL_CTX_DATA, config.cert_info.app_name.c_str());
+		// disable hostname verification, SANs not present in metatron certs
+		curl_easy_setopt(handle_, CURLOPT_SSL_VERIFYHOST, 0);
+		// save any extended error message
+		curl_easy_setopt(handle_, CURLOPT_ERRORBUFFER, errbuf_);
+	}
+
+	void ignore_output() { curl_easy_setopt(handle_, CURLOPT_WRITEFUNCTION, curl_ignore_output_fun); }
+
+	void capture_output()
+	{
+		curl_easy_setopt(handle_, CURLOPT_WRITEFUNCTION, curl_capture_output_fun);
+		curl_easy_setopt(handle_, CURLOPT_WRITEDATA, static_cast<void*>(&response_));
+	}
+
+	void capture_headers()
+	{
+		curl_easy_setopt(handle_, CURLOPT_HEADERDATA, static_cast<void*>(&resp_headers_));
+		curl_easy_setopt(handle_, CURLOPT_HEADERFUNCTION, curl_capture_headers_fun);
+	}
+
+	void trace_requests()
+	{
+		// we log to stdout - might need to make it configurable
+		// in the future. For now let's keep it simple
+		curl_easy_setopt(handle_, CURLOPT_STDERR, stdout);
+		curl_easy_setopt(handle_, CURLOPT_VERBOSE, 1L);
+	}
+
+	char* get_errbuf() { return errbuf_; }
+
+	// The handle keeps the headers alive, but the payload must outlive the request
+	void setup_request(const HttpClientConfig& config, const char* method, const std::string& url,
+	                   std::shared_ptr<CurlHeaders> headers, const void* payload, size_t size)
+	{
+		auto total_timeout = config.connect_timeout + config.read_timeout;
+		set_timeout(total_timeout);
+		set_connect_timeout(config.connect_timeout);
+		set_url(url);
+		set_headers(std::move(headers));
+
+		if (strcmp("POST", method) == 0)
+		{
+			post_payload(payload, size);
+		}
+		else if (strcmp("GET", method) != 0)
+		{
+			custom_request(method);
+		}
+		if (config.external_enabled)
+		{
+			configure_metatron(config);
+		}
+		if (config.read_body)
+		{
+			capture_output();
+		}
+		else
+		{
+			ignore_output();
+		}
+		if (config.read_headers)
+		{
+			capture_headers();
+		}
+		if (config.verbose_requests)
+		{
+			trace_requests();
+		}
+	}
+
+	auto take_response(int http_code) -> HttpResponse
+	{
+		std::string resp;
+		move_response(&resp);
+		HttpHeaders resp_headers;
+		move_headers(&resp_headers);
+		return HttpResponse{http_code, std::move(resp), std::move(resp_headers)};
+	}
+
+	// Clear per-request state when reusing handle across requests.
+	// curl_easy_reset() clears all options but preserves the connection cache.
+	void clear_for_reuse()
+	{
+		response_.clear();
+		resp_headers_.clear();
+		headers_.reset();
+		payload_ = nullptr;
+		std::memset(errbuf_, 0, CURL_ERROR_SIZE);
+
+		curl_easy_reset(handle_);
+		apply_persistent_settings();
+	}
+
+	// Destroy and recreate the handle to get a fresh DNS resolver.
+	// The underlying resolver (c-ares) reads /etc/resolv.conf once at handle
+	// creation and never re-reads it, so a stale resolver can cause permanent
+	// DNS failures. This forces a full re-initialization.
+	void recreate()
+	{
+		curl_easy_cleanup(handle_);
+		handle_ = curl_easy_init();
+		apply_persistent_settings();
+	}
+
+   private:
+	// Settings that survive across requests (applied in constructor and after reset)
+	void apply_persistent_settings()
+	{
+		static const auto user_agent = fmt::format("spectatord/{}", VERSION);
+		curl_easy_setopt(handle_, CURLOPT_USERAGENT, user_agent.c_str());
+
+		// Enable connection reuse for thread-local handles
+		curl_easy_setopt(handle_, CURLOPT_TCP_KEEPALIVE, 1L);
+		// Cache up to 2 connections per handle. Each thread only talks to one aggregator
+		// endpoint, so 1 is sufficient for steady state. We use 2 to handle the edge case
+		// where an old connection is closing while a new one is being established.
+		curl_easy_setopt(handle_, CURLOPT_MAXCONNECTS, 2L);
+		curl_easy_setopt(handle_, CURLOPT_FORBID_REUSE, 0L);  // Allow connection reuse
+	}
+
+	CURL* handle_;
+	std::shared_ptr<CurlHeaders> headers_;
+	const void* payload_ = nullptr;
+	std::string response_;
+	HttpHeaders resp_headers_;
+	char errbuf_[CURL_ERROR_SIZE]{};
+};
+
+struct Attempt
+{
+	int http_code;
+	bool retry;
+	absl::Duration backoff;  // how long to wait before retrying
+};
+
+// Record the outcome of an attempt at a request in its log entry, and decide
+// whether it should be retried. The handle is recreated after curl errors.
+auto check_attempt(Registry* registry, const HttpClientConfig& config, const char* method, const std::string& url,
+                   int attempt_number, CURLcode curl_res, CurlHandle* curl, LogEntry* entry) -> Attempt;
+
+}  // namespace detail
+
+}  // namespace spectator
@@ -6,13 +6,14 @@ namespace spectator
 {
 
 DistributionSummary::DistributionSummary(Id id) noexcept
-    : Meter(std::move(id)), count_(0), total_(0), totalSq_(0.0), max_(0)
+    : Meter(std::move(id)), max_(0)
 {
 }
 
-auto DistributionSummary::Measure(Measurements* results) const noexcept -> void
+template <typename Results>
+auto DistributionSummary::Measure(Results* results) const noexcept -> void
 {
-	auto cnt = count_.exchange(0, std::memory_order_relaxed);
+	auto cnt = count_.SumThenReset();
 	if (cnt == 0)
 	{
 		return;
@@ -23,8 +24,8 @@ auto DistributionSummary::Measure(Measurements* results) const noexcept -> void
 		st = std::make_unique<DistStats>(MeterId(), refs().totalAmount());
 	}
 
-	auto total = total_.exchange(0.0, std::memory_order_relaxed);
-	auto t_sq = totalSq_.exchange(0.0, std::memory_order_relaxed);
+	auto total = total_.SumThenReset();
+	auto t_sq = totalSq_.SumThenReset();
 	auto mx = max_.exchange(0.0, std::memory_order_relaxed);
 	results->emplace_back(st->count, static_cast<double>(cnt));
 	results->emplace_back(st->total, total);
@@ -32,21 +33,41 @@ auto DistributionSummary::Measure(Measurements* results) const noexcept -> void
 	results->emplace_back(st->max, mx);
 }
 
-auto DistributionSummary::Record(double amount) noexcept -> void
+auto DistributionSummary::Record(double amount) noexcept -> void { Record(amount, 1); }
+
+auto DistributionSummary::Record(double amount, int64_t count) noexcept -> void
 {
 	Update();
 
-	if (amount >= 0)
+	if (amount >= 0 && count > 0)
 	{
-		count_.fetch_add(1, std::memory_order_relaxed);
-		add_double(&total_, amount);
-		add_double(&totalSq_, amount * amount);
+		count_.Add(count);
+		total_.Add(amount * count);
+		totalSq_.Add(amount * amount * count);
 		update_max(&max_, amount);
+		MarkDirty();
 	}
 }
 
-auto DistributionSummary::Count() const noexcept -> int64_t { return count_.load(std::memory_order_relaxed); }
+auto DistributionSummary::RecordTotals(int64_t count, double total, double total_sq, double max) noexcept -> void
+{
+	Update();
+
+	if (count > 0)
+	{
+		count_.Add(count);
+		total_.Add(total);
+		totalSq_.Add(total_sq);
+		update_max(&max_, max);
+		MarkDirty();
+	}
+}
+
+auto DistributionSummary::Count() const noexcept -> int64_t { return count_.Sum(); }
+
+auto DistributionSummary::TotalAmount() const noexcept -> double { return total_.Sum(); }
 
-auto DistributionSummary::TotalAmount() const noexcept -> double { return total_.load(std::memory_order_relaxed); }
+template auto DistributionSummary::Measure(Measurements* results) const noexcept -> void;
+template auto DistributionSummary::Measure(MeasurementColumns* results) const noexcept -> void;
 
 }  // namespace spectator
@@ -1,6 +1,7 @@
 #pragma once
 #include "dist_stats.h"
 #include "meter.h"
+#include "striped_adder.h"
 #include <atomic>
 
 namespace spectator
@@ -10,16 +11,22 @@ class DistributionSummary : public Meter
 {
    public:
 	explicit DistributionSummary(Id id) noexcept;
-	auto Measure(Measurements* results) const noexcept -> void;
+	template <typename Results>
+	auto Measure(Results* results) const noexcept -> void;
 	auto Record(double amount) noexcept -> void;
+	// record the same amount count times, for sampled values
+	auto Record(double amount, int64_t count) noexcept -> void;
+	// record count amounts that were added up beforehand, with the given total, sum of
+	// squares and max. Nothing is recorded when count <= 0
+	auto RecordTotals(int64_t count, double total, double total_sq, double max) noexcept -> void;
 	[[nodiscard]] auto Count() const noexcept -> int64_t;
 	[[nodiscard]] auto TotalAmount() const noexcept -> double;
 
    private:
 	mutable std::unique_ptr<DistStats> st;
-	mutable std::atomic<int64_t> count_;
-	mutable std::atomic<double> total_;
-	mutable std::atomic<double> totalSq_;
+	mutable StripedAdder<int64_t> count_;
+	mutable StripedAdder<double> total_;
+	mutable StripedAdder<double> totalSq_;
 	mutable std::atomic<double> max_;
 };
 
@@ -74,6 +74,16 @@ TEST(DistributionSummary, Measure)
 	expect_dist_summary(ds, 2, 300, 100 * 100 + 200 * 200, 200);
 }
 
+TEST(DistributionSummary, RecordWeighted)
+{
+	auto ds = getDS();
+	ds.Record(100, 10);
+	ds.Record(200, 1);
+	ds.Record(300, 0);
+	ds.Record(-1, 10);
+	expect_dist_summary(ds, 11, 1200, 100 * 100 * 10 + 200 * 200, 200);
+}
+
 TEST(DistributionSummary, Updated)
 {
 	auto ds = getDS();
@@ -83,7 +93,7 @@ TEST(DistributionSummary, Updated)
 	auto t2 = ds.Updated();
 	EXPECT_EQ(t1, t2);
 
-	usleep(1);
+	usleep(20000);  // 20ms, longer than a tick of the coarse clock
 	ds.Record(1);
 	EXPECT_TRUE(ds.Updated() > t1);
 }
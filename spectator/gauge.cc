@@ -26,7 +26,8 @@ auto Gauge::HasExpired(int64_t now) const noexcept -> bool
 	return ago > ttl_nanos_;
 }
 
-void Gauge::Measure(Measurements* results, int64_t now) const noexcept
+template <typename Results>
+void Gauge::Measure(Results* results, int64_t now) const noexcept
 {
 	double value;
 	if (HasExpired(now))
@@ -60,4 +61,7 @@ auto Gauge::Get() const noexcept -> double { return value_.load(std::memory_orde
 
 void Gauge::SetTtl(absl::Duration ttl) noexcept { this->ttl_nanos_ = get_ttl(ttl); }
 
+template void Gauge::Measure(Measurements* results, int64_t now) const noexcept;
+template void Gauge::Measure(MeasurementColumns* results, int64_t now) const noexcept;
+
 }  // namespace spectator
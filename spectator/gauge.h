@@ -9,8 +9,12 @@ namespace spectator
 class Gauge : public Meter
 {
    public:
+	// reported every interval until the ttl expires
+	static constexpr bool kMeasureWhenIdle = true;
+
 	Gauge(Id id, absl::Duration ttl) noexcept;
-	void Measure(Measurements* results, int64_t now = absl::GetCurrentTimeNanos()) const noexcept;
+	template <typename Results>
+	void Measure(Results* results, int64_t now = absl::GetCurrentTimeNanos()) const noexcept;
 
 	void Set(double value) noexcept;
 	auto Get() const noexcept -> double;
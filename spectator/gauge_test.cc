@@ -50,7 +50,7 @@ TEST(Gauge, Updated)
 	auto t2 = gauge.Updated();
 	EXPECT_EQ(t1, t2);
 
-	usleep(1);
+	usleep(20000);  // 20ms, longer than a tick of the coarse clock
 	gauge.Set(1);
 	EXPECT_TRUE(gauge.Updated() > t1);
 }
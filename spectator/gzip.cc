@@ -72,16 +72,22 @@ auto gzip_uncompress(void* dest, size_t* destLen, const void* source, size_t sou
 		return err;
 	}
 
-	err = inflate(&stream, Z_FINISH);
-	if (err != Z_STREAM_END)
+	// the source can be made of several gzip members, which are concatenated
+	size_t total_out = 0;
+	do
 	{
-		if (err == Z_NEED_DICT || (err == Z_BUF_ERROR && stream.avail_in == 0))
+		err = inflate(&stream, Z_FINISH);
+		if (err != Z_STREAM_END)
 		{
-			return Z_DATA_ERROR;
+			if (err == Z_NEED_DICT || (err == Z_BUF_ERROR && stream.avail_in == 0))
+			{
+				return Z_DATA_ERROR;
+			}
+			return err;
 		}
-		return err;
-	}
-	*destLen = stream.total_out;
+		total_out += stream.total_out;
+	} while (stream.avail_in > 0 && inflateReset(&stream) == Z_OK);
+	*destLen = total_out;
 
 	return Z_OK;
 }
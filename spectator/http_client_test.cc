@@ -265,9 +265,9 @@ TEST(HttpTest, Get)
 	EXPECT_EQ(response.status, 200);
 	EXPECT_EQ(response.raw_body, "InsightInstanceProfile");
 
-	// one timer, plus one counter for the percentile bucket
+	// one timer, plus one histogram for the percentile buckets
 	EXPECT_EQ(my_timers(registry).size(), 1);
-	EXPECT_EQ(my_counters(registry).size(), 1);
+	EXPECT_EQ(my_percentile_histograms(registry).size(), 1);
 
 	spectator::Tags timer_tags{
 	    {"http.method", "GET"},        {"http.status", "200"},       {"ipc.attempt", "initial"},
@@ -10,7 +10,8 @@ static constexpr auto kNaN = std::numeric_limits<double>::quiet_NaN();
 
 MaxGauge::MaxGauge(Id id) noexcept : Meter{std::move(id)}, value_{kMinValue} {}
 
-void MaxGauge::Measure(Measurements* results) const noexcept
+template <typename Results>
+void MaxGauge::Measure(Results* results) const noexcept
 {
 	auto value = value_.exchange(kMinValue, std::memory_order_relaxed);
 	if (value == kMinValue)
@@ -38,6 +39,10 @@ void MaxGauge::Update(double value) noexcept
 {
 	Meter::Update();
 	update_max(&value_, value);
+	MarkDirty();
 }
 
+template void MaxGauge::Measure(Measurements* results) const noexcept;
+template void MaxGauge::Measure(MeasurementColumns* results) const noexcept;
+
 }  // namespace spectator
@@ -10,7 +10,8 @@ class MaxGauge : public Meter
 {
    public:
 	explicit MaxGauge(Id id) noexcept;
-	void Measure(Measurements* results) const noexcept;
+	template <typename Results>
+	void Measure(Results* results) const noexcept;
 	void Update(double value) noexcept;
 
 	// synonym for Update for consistency with the Gauge interface
@@ -88,7 +88,7 @@ TEST(MaxGauge, Updated)
 	auto t2 = m.Updated();
 	EXPECT_EQ(t1, t2);
 
-	usleep(1);
+	usleep(20000);  // 20ms, longer than a tick of the coarse clock
 	m.Set(2);
 	EXPECT_TRUE(m.Updated() > t1);
 }
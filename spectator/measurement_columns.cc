@@ -0,0 +1,32 @@
+#include "measurement_columns.h"
+
+namespace spectator
+{
+
+MeasurementColumns::MeasurementColumns(const MeasurementColumns& other, size_t first, size_t last)
+    : ids_(other.ids_.begin() + first, other.ids_.begin() + last),
+      names_(other.names_.begin() + first, other.names_.begin() + last),
+      tags_(other.tags_.begin() + other.tag_offsets_[first], other.tags_.begin() + other.tag_offsets_[last]),
+      ops_(other.ops_.begin() + first, other.ops_.begin() + last),
+      values_(other.values_.begin() + first, other.values_.begin() + last)
+{
+	auto base = other.tag_offsets_[first];
+	tag_offsets_.reserve(last - first + 1);
+	for (auto i = first; i <= last; ++i)
+	{
+		tag_offsets_.push_back(other.tag_offsets_[i] - base);
+	}
+}
+
+auto MeasurementColumns::ToMeasurements() const -> Measurements
+{
+	Measurements result;
+	result.reserve(size());
+	for (size_t i = 0; i < size(); ++i)
+	{
+		result.emplace_back(*ids_[i], values_[i]);
+	}
+	return result;
+}
+
+}  // namespace spectator
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "common_refs.h"
+#include "measurement.h"
+
+namespace spectator
+{
+
+// how the aggregator combines the values for a measurement
+enum class Op : uint8_t
+{
+	Add = 0,
+	Max = 10
+};
+
+inline auto op_from_tags(const Tags& tags) -> Op
+{
+	auto stat = tags.at(refs().statistic());
+	if (stat == refs().count() || stat == refs().totalAmount() || stat == refs().totalTime() ||
+	    stat == refs().totalOfSquares() || stat == refs().percentile())
+	{
+		return Op::Add;
+	}
+	return Op::Max;
+}
+
+// A snapshot of measurements laid out as columns, so publishing can walk the names,
+// tags and values of a batch linearly instead of following each measurement to the
+// id owned by its meter. The tags of all the measurements are copied into a single
+// array, and the op is worked out from the statistic when a measurement is added.
+// The ids are kept for what still needs a Measurement, like the measurement callbacks.
+class MeasurementColumns
+{
+   public:
+	MeasurementColumns() { tag_offsets_.push_back(0); }
+
+	// a copy of the rows in [first, last) of other
+	MeasurementColumns(const MeasurementColumns& other, size_t first, size_t last);
+
+	void reserve(size_t n)
+	{
+		ids_.reserve(n);
+		names_.reserve(n);
+		tag_offsets_.reserve(n + 1);
+		tags_.reserve(n * 4);
+		ops_.reserve(n);
+		values_.reserve(n);
+	}
+
+	// same as for Measurements, so meters can add to either
+	void emplace_back(const Id& id, double value)
+	{
+		const auto& tags = id.GetTags();
+		ids_.push_back(&id);
+		names_.push_back(id.Name());
+		tags_.insert(tags_.end(), tags.begin(), tags.end());
+		tag_offsets_.push_back(static_cast<uint32_t>(tags_.size()));
+		ops_.push_back(op_from_tags(tags));
+		values_.push_back(value);
+	}
+
+	[[nodiscard]] auto size() const -> size_t { return values_.size(); }
+	[[nodiscard]] auto empty() const -> bool { return values_.empty(); }
+
+	[[nodiscard]] auto Name(size_t i) const -> StrRef { return names_[i]; }
+	[[nodiscard]] auto TagsBegin(size_t i) const -> const Tag* { return tags_.data() + tag_offsets_[i]; }
+	[[nodiscard]] auto TagsEnd(size_t i) const -> const Tag* { return tags_.data() + tag_offsets_[i + 1]; }
+	[[nodiscard]] auto TagsSize(size_t i) const -> size_t { return tag_offsets_[i + 1] - tag_offsets_[i]; }
+	[[nodiscard]] auto GetOp(size_t i) const -> Op { return ops_[i]; }
+	[[nodiscard]] auto Value(size_t i) const -> double { return values_[i]; }
+
+	[[nodiscard]] auto operator[](size_t i) const -> Measurement { return Measurement{*ids_[i], values_[i]}; }
+	[[nodiscard]] auto ToMeasurements() const -> Measurements;
+
+   private:
+	std::vector<const Id*> ids_;
+	std::vector<StrRef> names_;
+	// the tags of row i are tags_[tag_offsets_[i], tag_offsets_[i + 1])
+	std::vector<uint32_t> tag_offsets_;
+	std::vector<Tag> tags_;
+	std::vector<Op> ops_;
+	std::vector<double> values_;
+};
+
+}  // namespace spectator
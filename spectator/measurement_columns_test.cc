@@ -0,0 +1,86 @@
+#include "measurement_columns.h"
+#include "counter.h"
+#include "timer.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using spectator::Counter;
+using spectator::Id;
+using spectator::Measurement;
+using spectator::MeasurementColumns;
+using spectator::Measurements;
+using spectator::Op;
+using spectator::Timer;
+
+TEST(MeasurementColumns, Add)
+{
+	auto a = Id::Of("a", {{"statistic", "count"}, {"k", "v"}});
+	auto b = Id::Of("b");
+	auto c = Id::Of("c", {{"statistic", "max"}});
+	MeasurementColumns ms;
+	ms.emplace_back(a, 1);
+	ms.emplace_back(b, 2);
+	ms.emplace_back(c, 3);
+
+	ASSERT_EQ(ms.size(), 3);
+	EXPECT_EQ(ms.Name(0), a.Name());
+	ASSERT_EQ(ms.TagsSize(0), 2);
+	EXPECT_EQ(ms.TagsBegin(0)->key, a.GetTags().begin()->key);
+	EXPECT_EQ(ms.TagsSize(1), 0);
+	EXPECT_EQ(ms.TagsBegin(1), ms.TagsEnd(1));
+	EXPECT_EQ(ms.TagsSize(2), 1);
+	EXPECT_EQ(ms.GetOp(0), Op::Add);
+	EXPECT_EQ(ms.GetOp(1), Op::Max);
+	EXPECT_EQ(ms.GetOp(2), Op::Max);
+	EXPECT_DOUBLE_EQ(ms.Value(2), 3);
+
+	auto expected = Measurements{Measurement{a, 1}, Measurement{b, 2}, Measurement{c, 3}};
+	EXPECT_EQ(ms.ToMeasurements(), expected);
+	EXPECT_EQ(ms[1], expected[1]);
+}
+
+TEST(MeasurementColumns, Slice)
+{
+	auto a = Id::Of("a", {{"statistic", "count"}, {"k", "v"}});
+	auto b = Id::Of("b", {{"statistic", "gauge"}});
+	auto c = Id::Of("c", {{"statistic", "max"}, {"x", "y"}, {"z", "w"}});
+	MeasurementColumns ms;
+	ms.emplace_back(a, 1);
+	ms.emplace_back(b, 2);
+	ms.emplace_back(c, 3);
+
+	MeasurementColumns tail{ms, 1, 3};
+	ASSERT_EQ(tail.size(), 2);
+	EXPECT_EQ(tail.Name(0), b.Name());
+	EXPECT_EQ(tail.TagsSize(0), 1);
+	EXPECT_EQ(tail.TagsBegin(1)->key, c.GetTags().begin()->key);
+	EXPECT_EQ(tail.TagsSize(1), 3);
+	EXPECT_EQ(tail.ToMeasurements(), (Measurements{Measurement{b, 2}, Measurement{c, 3}}));
+
+	MeasurementColumns empty{ms, 3, 3};
+	EXPECT_TRUE(empty.empty());
+}
+
+TEST(MeasurementColumns, FilledByMeters)
+{
+	Counter counter{Id::Of("c")};
+	counter.Add(2);
+	Timer timer{Id::Of("t")};
+	timer.Record(std::chrono::milliseconds(1));
+
+	MeasurementColumns columns;
+	counter.Measure(&columns);
+	timer.Measure(&columns);
+	ASSERT_EQ(columns.size(), 5);
+	EXPECT_EQ(columns.GetOp(0), Op::Add);
+	EXPECT_DOUBLE_EQ(columns.Value(0), 2);
+	// count, totalTime, totalOfSquares are added, max is not
+	EXPECT_EQ(columns.GetOp(1), Op::Add);
+	EXPECT_EQ(columns.GetOp(2), Op::Add);
+	EXPECT_EQ(columns.GetOp(3), Op::Add);
+	EXPECT_EQ(columns.GetOp(4), Op::Max);
+}
+
+}  // namespace
@@ -1,28 +1,99 @@
 #pragma once
 
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
+#include "coarse_clock.h"
 #include "id.h"
-#include "measurement.h"
+#include "measurement_columns.h"
 #include <atomic>
 #include <chrono>
+#include <memory>
 #include <vector>
 
 namespace spectator
 {
 
+struct Meter;
+
+// The meters of a stripe in the registry that were updated since they were last measured
+struct DirtyMeters
+{
+	absl::Mutex mutex;
+	std::vector<Meter*> meters ABSL_GUARDED_BY(mutex);
+	// meters removed from the registry while in the list above, kept alive until it is
+	// measured, so removing a meter does not need to search for it
+	std::vector<std::shared_ptr<Meter>> removed ABSL_GUARDED_BY(mutex);
+};
+
+// Meter types take their measurements with a Measure function template, which
+// adds them to either Measurements or MeasurementColumns
 struct Meter
 {
    public:
-	explicit Meter(Id id) : id_{std::move(id)}, last_updated_{absl::GetCurrentTimeNanos()} {}
+	explicit Meter(Id id) : id_{std::move(id)}, last_updated_{coarse_realtime_nanos()} {}
 	[[nodiscard]] auto MeterId() const -> const Id& { return id_; }
-	[[nodiscard]] auto Updated() const noexcept -> int64_t { return last_updated_; }
+	// when the meter was last updated, up to the resolution of the coarse clock
+	[[nodiscard]] auto Updated() const noexcept -> int64_t { return last_updated_.load(std::memory_order_relaxed); }
+
+	// set when the registry stops tracking this meter, so users that cache
+	// a reference to it know they need to get a new one
+	[[nodiscard]] auto IsRemoved() const noexcept -> bool { return removed_.load(std::memory_order_relaxed); }
+	void MarkRemoved() noexcept { removed_.store(true, std::memory_order_relaxed); }
+
+	// Meters that only report values after being updated can be added to a dirty list the
+	// first time they are updated after being measured, so the registry does not need to
+	// visit the idle ones. Gauges are reported every interval, so they are not tracked.
+	static constexpr bool kMeasureWhenIdle = false;
+	// Meters share the list with the registry, since they can outlive it
+	void TrackUpdates(std::shared_ptr<DirtyMeters> dirty) noexcept { dirty_meters_ = std::move(dirty); }
+	// called by the registry when it removes the meter, while holding the list lock.
+	// The flag stays set, so later updates never take the lock again
+	void StopTracking() noexcept { dirty_.store(true, std::memory_order_release); }
+	// clear the dirty flag before measuring, so updates from now on add the meter again
+	void ClearDirty() noexcept { dirty_.exchange(false, std::memory_order_acq_rel); }
+	[[nodiscard]] auto IsDirty() const noexcept -> bool { return dirty_.load(std::memory_order_acquire); }
 
    private:
 	Id id_;
 	std::atomic_int64_t last_updated_;
+	std::atomic_bool removed_{false};
+	std::atomic_bool dirty_{false};
+	std::shared_ptr<DirtyMeters> dirty_meters_;
+
+	void add_to_dirty() noexcept
+	{
+		absl::MutexLock lock{&dirty_meters_->mutex};
+		// the registry marks the meters it removes while holding the lock
+		if (!IsRemoved())
+		{
+			dirty_meters_->meters.push_back(this);
+		}
+	}
 
    protected:
-	auto Update() -> void { last_updated_ = absl::GetCurrentTimeNanos(); }
+	// The coarse clock only moves every few milliseconds, so meters updated many times
+	// within a tick only write the timestamp once, instead of every thread updating them
+	// taking the cache line for a store
+	auto Update() -> void
+	{
+		auto now = coarse_realtime_nanos();
+		if (last_updated_.load(std::memory_order_relaxed) != now)
+		{
+			last_updated_.store(now, std::memory_order_relaxed);
+		}
+	}
+
+	// Called after writing a new value. Both sides exchange the flag, so either the
+	// registry clears it after this and then sees the value when measuring the meter,
+	// or this sees it cleared and adds the meter again.
+	void MarkDirty() noexcept
+	{
+		if (dirty_meters_ != nullptr && !dirty_.exchange(true, std::memory_order_acq_rel))
+		{
+			add_to_dirty();
+		}
+	}
 };
 
 }  // namespace spectator
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "absl/synchronization/mutex.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace spectator
+{
+
+// A cached reference to a meter owned by the registry. If the registry removes
+// the meter, for example because it expired, the next Get fetches it again.
+//
+// Other threads could still be using the previous meter through the pointer Get
+// returned, so it is kept until the registry has gone through a full expiration
+// pass since it was replaced, which takes far longer than any update. Readers
+// don't need to announce themselves, which keeps Get free of shared writes.
+template <typename M>
+class MeterHandle
+{
+   public:
+	// expirations is the number of expiration passes the registry completed
+	MeterHandle(std::shared_ptr<M> meter, const std::atomic<uint64_t>* expirations) noexcept
+	    : current_{meter.get()}, expirations_{expirations}, owner_{std::move(meter)}
+	{
+	}
+
+	MeterHandle(const MeterHandle&) = delete;
+	auto operator=(const MeterHandle&) -> MeterHandle& = delete;
+
+	// fetch is only called when the meter needs to be fetched again from the registry
+	template <typename Fetch>
+	auto Get(Fetch&& fetch) noexcept -> M*
+	{
+		auto* meter = current_.load(std::memory_order_acquire);
+		if (meter->IsRemoved())
+		{
+			return refresh(std::forward<Fetch>(fetch));
+		}
+		return meter;
+	}
+
+   private:
+	std::atomic<M*> current_;
+	const std::atomic<uint64_t>* expirations_;
+	absl::Mutex mutex_;
+	std::shared_ptr<M> owner_ ABSL_GUARDED_BY(mutex_);
+	// previous meters, with the number of expiration passes when they were replaced
+	std::vector<std::pair<std::shared_ptr<M>, uint64_t>> retired_ ABSL_GUARDED_BY(mutex_);
+
+	template <typename Fetch>
+	auto refresh(Fetch&& fetch) -> M*
+	{
+		absl::MutexLock lock{&mutex_};
+		if (!owner_->IsRemoved())
+		{
+			// another thread got here first
+			return owner_.get();
+		}
+
+		// a pass that was already running when a meter was retired could end right
+		// after, so wait for the one that started after it to finish
+		auto passes = expirations_->load(std::memory_order_acquire);
+		retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+		                              [passes](const auto& retired) { return passes >= retired.second + 2; }),
+		               retired_.end());
+		retired_.emplace_back(std::move(owner_), passes);
+		owner_ = fetch();
+		current_.store(owner_.get(), std::memory_order_release);
+		return owner_.get();
+	}
+};
+
+}  // namespace spectator
@@ -12,6 +12,7 @@ void MonotonicCounter::Set(double amount) noexcept
 {
 	Update();
 	value_.store(amount, std::memory_order_relaxed);
+	MarkDirty();
 }
 
 auto MonotonicCounter::Delta() const noexcept -> double
@@ -19,7 +20,8 @@ auto MonotonicCounter::Delta() const noexcept -> double
 	return value_.load(std::memory_order_relaxed) - prev_value_.load(std::memory_order_relaxed);
 }
 
-void MonotonicCounter::Measure(Measurements* results) const noexcept
+template <typename Results>
+void MonotonicCounter::Measure(Results* results) const noexcept
 {
 	auto delta = Delta();
 	prev_value_.store(value_.load(std::memory_order_relaxed), std::memory_order_relaxed);
@@ -33,4 +35,7 @@ void MonotonicCounter::Measure(Measurements* results) const noexcept
 	}
 }
 
+template void MonotonicCounter::Measure(Measurements* results) const noexcept;
+template void MonotonicCounter::Measure(MeasurementColumns* results) const noexcept;
+
 }  // namespace spectator
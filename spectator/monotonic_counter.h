@@ -9,7 +9,8 @@ class MonotonicCounter : public Meter
 {
    public:
 	explicit MonotonicCounter(Id id) noexcept;
-	void Measure(Measurements* results) const noexcept;
+	template <typename Results>
+	void Measure(Results* results) const noexcept;
 
 	void Set(double amount) noexcept;
 	auto Delta() const noexcept -> double;
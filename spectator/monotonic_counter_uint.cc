@@ -17,6 +17,7 @@ void MonotonicCounterUint::Set(uint64_t amount) noexcept
 {
 	Update();
 	value_.store(amount, std::memory_order_relaxed);
+	MarkDirty();
 }
 
 auto MonotonicCounterUint::Delta() const noexcept -> double
@@ -36,7 +37,8 @@ auto MonotonicCounterUint::Delta() const noexcept -> double
 	}
 }
 
-void MonotonicCounterUint::Measure(Measurements* results) const noexcept
+template <typename Results>
+void MonotonicCounterUint::Measure(Results* results) const noexcept
 {
 	auto delta = Delta();
 	prev_value_.store(value_.load(std::memory_order_relaxed), std::memory_order_relaxed);
@@ -60,4 +62,7 @@ void MonotonicCounterUint::Measure(Measurements* results) const noexcept
 	}
 }
 
+template void MonotonicCounterUint::Measure(Measurements* results) const noexcept;
+template void MonotonicCounterUint::Measure(MeasurementColumns* results) const noexcept;
+
 }  // namespace spectator
@@ -9,7 +9,8 @@ class MonotonicCounterUint : public Meter
 {
    public:
 	explicit MonotonicCounterUint(Id id) noexcept;
-	void Measure(Measurements* results) const noexcept;
+	template <typename Results>
+	void Measure(Results* results) const noexcept;
 
 	void Set(uint64_t amount) noexcept;
 	auto Delta() const noexcept -> double;
@@ -145,7 +145,7 @@ TEST(MonotonicCounterUint, Update)
 	auto t1 = counter.Updated();
 	auto t2 = counter.Updated();
 	EXPECT_EQ(t1, t2);
-	usleep(1);
+	usleep(20000);  // 20ms, longer than a tick of the coarse clock
 	counter.Set(2);
 	EXPECT_TRUE(counter.Updated() > t1);
 }
@@ -28,9 +28,11 @@ void MonotonicSampled::Set(double amount, int64_t ts_nanos) noexcept
 	}
 	value_ = amount;
 	ts_ = ts_nanos;
+	MarkDirty();
 }
 
-void MonotonicSampled::Measure(Measurements* results) const noexcept
+template <typename Results>
+void MonotonicSampled::Measure(Results* results) const noexcept
 {
 	auto sampled_delta = SampledRate();
 	if (std::isnan(sampled_delta))
@@ -61,4 +63,7 @@ auto MonotonicSampled::SampledRate() const noexcept -> double
 	return (value_ - prev_value_) / delta_t;
 }
 
+template void MonotonicSampled::Measure(Measurements* results) const noexcept;
+template void MonotonicSampled::Measure(MeasurementColumns* results) const noexcept;
+
 }  // namespace spectator
@@ -10,7 +10,8 @@ class MonotonicSampled : public Meter
 {
    public:
 	explicit MonotonicSampled(Id id) noexcept;
-	void Measure(Measurements* results) const noexcept;
+	template <typename Results>
+	void Measure(Results* results) const noexcept;
 
 	void Set(double amount, int64_t ts_nanos) noexcept;
 	auto SampledRate() const noexcept -> double;
@@ -115,4 +115,66 @@ TYPED_TEST(PercentileDistributionSummaryTest, Restrict)
 		EXPECT_DOUBLE_EQ(expected_m.second, actual[expected_m.first]) << expected_m.first;
 	}
 }
+
+struct ExpRegistry : public Registry
+{
+	explicit ExpRegistry(std::unique_ptr<spectator::Config> cfg) : Registry(std::move(cfg), spectatord::Logger()) {}
+
+	void expire() { remove_expired_meters(); }
+};
+
+TEST(PercentileDistributionSummary, SingleHistogramMeter)
+{
+	Registry r{GetConfiguration(), spectatord::Logger()};
+	PercentileDistributionSummary ds{&r, Id::Of("ds"), 0, 1000 * 1000};
+	for (auto i = 0; i < 10; ++i)
+	{
+		ds.Record(42);
+	}
+
+	// all the buckets are kept in one meter
+	EXPECT_TRUE(my_counters(r).empty());
+	ASSERT_EQ(my_percentile_histograms(r).size(), 1);
+	EXPECT_EQ(ds.Histogram(), r.GetDistSummaryHistogram(Id::Of("ds")).get());
+	EXPECT_EQ(ds.Histogram()->Count(PercentileBucketIndexOf(42)), 10);
+}
+
+TEST(PercentileDistributionSummary, RecordWeighted)
+{
+	Registry r{GetConfiguration(), spectatord::Logger()};
+	PercentileDistributionSummary ds{&r, Id::Of("ds"), 0, 1000 * 1000};
+	ds.Record(42, 100);
+	ds.Record(43, 0);
+	ds.Record(-1, 10);
+
+	EXPECT_EQ(ds.Count(), 100);
+	EXPECT_DOUBLE_EQ(ds.TotalAmount(), 4200);
+	EXPECT_EQ(ds.Histogram()->Count(PercentileBucketIndexOf(42)), 100);
+	EXPECT_EQ(ds.Histogram()->TotalCount(), 100);
+}
+
+TEST(PercentileDistributionSummary, ExpiredMeters)
+{
+	auto cfg = GetConfiguration();
+	cfg->meter_ttl = absl::Milliseconds(1);
+	ExpRegistry r{std::move(cfg)};
+	PercentileDistributionSummary ds{&r, Id::Of("ds"), 0, 1000 * 1000};
+
+	ds.Record(42);
+	auto* histogram = ds.Histogram();
+	EXPECT_EQ(histogram->Count(PercentileBucketIndexOf(42)), 1);
+
+	// the registry expires the meters, the summary needs to register new ones
+	usleep(2000);  // 2ms
+	r.expire();
+	EXPECT_TRUE(histogram->IsRemoved());
+	EXPECT_EQ(my_meters_size(r), 0);
+	ds.Record(42);
+	EXPECT_EQ(ds.Count(), 1);
+	EXPECT_EQ(my_meters_size(r), 2);
+	auto* refreshed = ds.Histogram();
+	EXPECT_NE(histogram, refreshed);
+	EXPECT_EQ(refreshed, r.GetDistSummaryHistogram(Id::Of("ds")).get());
+	EXPECT_EQ(refreshed->Count(PercentileBucketIndexOf(42)), 1);
+}
 }  // namespace
@@ -126,4 +126,96 @@ TYPED_TEST(PercentileTimerTest, Restrict)
 		EXPECT_DOUBLE_EQ(expected_m.second, actual[expected_m.first]) << expected_m.first;
 	}
 }
+
+struct ExpRegistry : public Registry
+{
+	explicit ExpRegistry(std::unique_ptr<spectator::Config> cfg) : Registry(std::move(cfg), spectatord::Logger()) {}
+
+	void expire() { remove_expired_meters(); }
+};
+
+TEST(PercentileTimer, SingleHistogramMeter)
+{
+	Registry r{GetConfiguration(), spectatord::Logger()};
+	PercentileTimer t{&r, Id::Of("t"), absl::ZeroDuration(), absl::Seconds(100)};
+	for (auto i = 0; i < 10; ++i)
+	{
+		t.Record(absl::Milliseconds(1));
+	}
+
+	// all the buckets are kept in one meter
+	EXPECT_TRUE(my_counters(r).empty());
+	ASSERT_EQ(my_percentile_histograms(r).size(), 1);
+	EXPECT_EQ(t.Histogram(), r.GetTimerHistogram(Id::Of("t")).get());
+	EXPECT_EQ(t.Histogram()->Count(PercentileBucketIndexOf(1000 * 1000)), 10);
+}
+
+TEST(PercentileTimer, RecordWeighted)
+{
+	Registry r{GetConfiguration(), spectatord::Logger()};
+	PercentileTimer t{&r, Id::Of("t"), absl::ZeroDuration(), absl::Seconds(100)};
+	t.Record(absl::Milliseconds(1), 100);
+	t.Record(std::chrono::milliseconds(2), 0);
+
+	EXPECT_EQ(t.Count(), 100);
+	EXPECT_EQ(t.TotalTime(), 100 * 1000 * 1000);
+	EXPECT_EQ(t.Histogram()->Count(PercentileBucketIndexOf(1000 * 1000)), 100);
+	EXPECT_EQ(t.Histogram()->TotalCount(), 100);
+}
+
+TEST(PercentileTimer, ExpiredMeters)
+{
+	auto cfg = GetConfiguration();
+	cfg->meter_ttl = absl::Milliseconds(1);
+	ExpRegistry r{std::move(cfg)};
+	PercentileTimer t{&r, Id::Of("t"), absl::ZeroDuration(), absl::Seconds(100)};
+
+	t.Record(absl::Milliseconds(1));
+	auto* histogram = t.Histogram();
+	EXPECT_EQ(histogram->Count(PercentileBucketIndexOf(1000 * 1000)), 1);
+
+	// the registry expires the meters, the timer needs to register new ones
+	usleep(2000);  // 2ms
+	r.expire();
+	EXPECT_TRUE(histogram->IsRemoved());
+	EXPECT_EQ(my_meters_size(r), 0);
+	t.Record(absl::Milliseconds(1));
+	EXPECT_EQ(t.Count(), 1);
+	EXPECT_EQ(my_meters_size(r), 2);
+	auto* refreshed = t.Histogram();
+	EXPECT_NE(histogram, refreshed);
+	EXPECT_EQ(refreshed, r.GetTimerHistogram(Id::Of("t")).get());
+	EXPECT_EQ(refreshed->Count(PercentileBucketIndexOf(1000 * 1000)), 1);
+}
+
+TEST(PercentileTimer, RefreshedTwiceWhileInUse)
+{
+	auto cfg = GetConfiguration();
+	cfg->meter_ttl = absl::Milliseconds(1);
+	ExpRegistry r{std::move(cfg)};
+	PercentileTimer t{&r, Id::Of("t"), absl::ZeroDuration(), absl::Seconds(100)};
+
+	t.Record(absl::Milliseconds(1));
+	auto* histogram = t.Histogram();
+	std::weak_ptr<PercentileHistogram> first = r.GetTimerHistogram(Id::Of("t"));
+
+	// the meters are removed twice while another thread is still using the first histogram
+	for (auto i = 0; i < 2; ++i)
+	{
+		usleep(2000);  // 2ms
+		r.expire();
+		t.Record(absl::Milliseconds(1));
+	}
+	EXPECT_TRUE(histogram->IsRemoved());
+	EXPECT_EQ(histogram->Count(PercentileBucketIndexOf(1000 * 1000)), 1);
+	EXPECT_EQ(t.Histogram()->Count(PercentileBucketIndexOf(1000 * 1000)), 1);
+
+	// once a full expiration pass went by since it was replaced, nobody can be using it,
+	// and the registry lets go of it when it measures the meters it removed
+	usleep(2000);  // 2ms
+	r.expire();
+	t.Record(absl::Milliseconds(1));
+	r.Measurements();
+	EXPECT_TRUE(first.expired());
+}
 }  // namespace
@@ -3,7 +3,7 @@
 #include <algorithm>
 
 #include "id.h"
-#include "percentile_bucket_tags.inc"
+#include "meter_handle.h"
 #include "percentile_buckets.h"
 #include "registry.h"
 
@@ -18,42 +18,47 @@ class PercentileDistributionSummary
 	      id_{std::move(id)},
 	      min_{min},
 	      max_{max},
-	      dist_summary_{registry->GetDistributionSummary(id_)}
+	      dist_summary_{registry->GetDistributionSummary(id_), &registry->ExpirationPasses()},
+	      histogram_{registry->GetDistSummaryHistogram(id_), &registry->ExpirationPasses()}
 	{
 	}
 
-	auto get_counter(size_t index, const std::string* perc_tags) -> std::shared_ptr<Counter>
-	{
-		using spectator::refs;
-		auto counterId =
-		    id_.WithTags(refs().statistic(), refs().percentile(), refs().percentile(), intern_str(perc_tags[index]));
-		return registry_->GetCounter(std::move(counterId));
-	}
+	void Record(int64_t amount) noexcept { Record(amount, 1); }
 
-	void Record(int64_t amount) noexcept
+	// record the same amount count times, for sampled values
+	void Record(int64_t amount, int64_t count) noexcept
 	{
-		if (amount < 0)
+		if (amount < 0 || count <= 0)
 		{
 			return;
 		}
 
-		dist_summary_->Record(amount);
+		dist_summary()->Record(amount, count);
 		auto restricted = std::clamp(amount, min_, max_);
 		auto index = PercentileBucketIndexOf(restricted);
-		auto c = get_counter(index, kDistTags.begin());
-		c->Increment();
+		Histogram()->Increment(index, count);
 	}
 
 	auto MeterId() const noexcept -> const Id& { return id_; }
-	auto Count() const noexcept -> int64_t { return dist_summary_->Count(); }
-	auto TotalAmount() const noexcept -> double { return dist_summary_->TotalAmount(); }
+	auto Count() const noexcept -> int64_t { return dist_summary()->Count(); }
+	auto TotalAmount() const noexcept -> double { return dist_summary()->TotalAmount(); }
+	auto Histogram() const noexcept -> PercentileHistogram*
+	{
+		return histogram_.Get([this]() { return registry_->GetDistSummaryHistogram(id_); });
+	}
 
    private:
 	Registry* registry_;
 	Id id_;
 	int64_t min_;
 	int64_t max_;
-	std::shared_ptr<DistributionSummary> dist_summary_;
+	mutable MeterHandle<DistributionSummary> dist_summary_;
+	mutable MeterHandle<PercentileHistogram> histogram_;
+
+	auto dist_summary() const noexcept -> DistributionSummary*
+	{
+		return dist_summary_.Get([this]() { return registry_->GetDistributionSummary(id_); });
+	}
 };
 
 }  // namespace spectator
@@ -0,0 +1,103 @@
+#include "percentile_histogram.h"
+#include "common_refs.h"
+
+namespace spectator
+{
+
+PercentileHistogram::PercentileHistogram(Id id, const std::string* perc_tags) noexcept
+    : Meter{std::move(id)}, perc_tags_{perc_tags}
+{
+}
+
+PercentileHistogram::~PercentileHistogram()
+{
+	auto* ids = bucket_ids_.load(std::memory_order_acquire);
+	if (ids == nullptr)
+	{
+		return;
+	}
+	for (auto& id : *ids)
+	{
+		delete id.load(std::memory_order_relaxed);
+	}
+	delete ids;
+}
+
+// Measure can run on more than one thread at a time, so a thread that loses the race
+// to publish a new table or id throws its own away and uses the winner's
+auto PercentileHistogram::bucket_id(size_t index) const noexcept -> const Id&
+{
+	auto* ids = bucket_ids_.load(std::memory_order_acquire);
+	if (ids == nullptr)
+	{
+		auto* fresh = new bucket_ids{};
+		if (bucket_ids_.compare_exchange_strong(ids, fresh, std::memory_order_acq_rel))
+		{
+			ids = fresh;
+		}
+		else
+		{
+			delete fresh;
+		}
+	}
+
+	auto& slot = (*ids)[index];
+	const auto* id = slot.load(std::memory_order_acquire);
+	if (id == nullptr)
+	{
+		const auto* fresh = new Id(MeterId().WithTags(refs().statistic(), refs().percentile(), refs().percentile(),
+		                                              intern_str(perc_tags_[index])));
+		if (slot.compare_exchange_strong(id, fresh, std::memory_order_acq_rel))
+		{
+			id = fresh;
+		}
+		else
+		{
+			delete fresh;
+		}
+	}
+	return *id;
+}
+
+template <typename Results>
+void PercentileHistogram::Measure(Results* results) const noexcept
+{
+	for (size_t i = 0; i < counts_.size(); ++i)
+	{
+		if (counts_[i].load(std::memory_order_relaxed) == 0)
+		{
+			continue;
+		}
+		auto count = counts_[i].exchange(0, std::memory_order_relaxed);
+		results->emplace_back(bucket_id(i), static_cast<double>(count));
+	}
+}
+
+void PercentileHistogram::Increment(size_t index) noexcept { Increment(index, 1); }
+
+void PercentileHistogram::Increment(size_t index, int64_t count) noexcept
+{
+	Update();
+	counts_[index].fetch_add(count, std::memory_order_relaxed);
+	MarkDirty();
+}
+
+auto PercentileHistogram::Count(size_t index) const noexcept -> int64_t
+{
+	return counts_[index].load(std::memory_order_relaxed);
+}
+
+auto PercentileHistogram::TotalCount() const noexcept -> int64_t
+{
+	int64_t total = 0;
+	for (const auto& count : counts_)
+	{
+		total += count.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+template void PercentileHistogram::Measure(Measurements* results) const noexcept;
+template void PercentileHistogram::Measure(MeasurementColumns* results) const noexcept;
+
+}  // namespace spectator
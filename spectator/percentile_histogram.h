@@ -0,0 +1,40 @@
+#pragma once
+
+#include "meter.h"
+#include "percentile_buckets.h"
+#include <array>
+#include <atomic>
+
+namespace spectator
+{
+
+// Counts for each percentile bucket of a percentile timer or distribution
+// summary, kept as a single meter. It reports one percentile measurement for
+// each bucket that was updated, with the tag values from perc_tags.
+class PercentileHistogram : public Meter
+{
+   public:
+	PercentileHistogram(Id id, const std::string* perc_tags) noexcept;
+	PercentileHistogram(const PercentileHistogram&) = delete;
+	auto operator=(const PercentileHistogram&) -> PercentileHistogram& = delete;
+	~PercentileHistogram();
+	template <typename Results>
+	auto Measure(Results* results) const noexcept -> void;
+	auto Increment(size_t index) noexcept -> void;
+	auto Increment(size_t index, int64_t count) noexcept -> void;
+	[[nodiscard]] auto Count(size_t index) const noexcept -> int64_t;
+	[[nodiscard]] auto TotalCount() const noexcept -> int64_t;
+
+   private:
+	// ids of the buckets that were measured, built the first time each one is needed.
+	// Measurements keep pointers to them, so they live as long as the histogram
+	using bucket_ids = std::array<std::atomic<const Id*>, PercentileBucketsLength()>;
+
+	const std::string* perc_tags_;
+	mutable std::atomic<bucket_ids*> bucket_ids_{nullptr};
+	mutable std::array<std::atomic<int64_t>, PercentileBucketsLength()> counts_{};
+
+	auto bucket_id(size_t index) const noexcept -> const Id&;
+};
+
+}  // namespace spectator
@@ -0,0 +1,54 @@
+#include "../spectator/percentile_histogram.h"
+#include "percentile_bucket_tags.inc"
+#include "test_utils.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+using spectator::Id;
+using spectator::kTimerTags;
+using spectator::Measurements;
+using spectator::PercentileHistogram;
+
+TEST(PercentileHistogram, Increment)
+{
+	PercentileHistogram h{Id::Of("h"), kTimerTags.begin()};
+	EXPECT_EQ(h.TotalCount(), 0);
+
+	h.Increment(1);
+	h.Increment(1);
+	h.Increment(275);
+	EXPECT_EQ(h.Count(0), 0);
+	EXPECT_EQ(h.Count(1), 2);
+	EXPECT_EQ(h.Count(275), 1);
+	EXPECT_EQ(h.TotalCount(), 3);
+}
+
+TEST(PercentileHistogram, Measure)
+{
+	PercentileHistogram h{Id::Of("h", {{"id", "foo"}}), kTimerTags.begin()};
+	h.Increment(1);
+	h.Increment(1);
+	h.Increment(42);
+
+	Measurements ms;
+	h.Measure(&ms);
+	auto actual = measurements_to_map(ms);
+	auto expected = std::map<std::string, double>{
+	    {"h|id=foo|percentile=T0001|statistic=percentile", 2},
+	    {"h|id=foo|percentile=T002A|statistic=percentile", 1},
+	};
+	EXPECT_EQ(actual, expected);
+
+	// counts are reset after being measured
+	EXPECT_EQ(h.TotalCount(), 0);
+	ms.clear();
+	h.Measure(&ms);
+	EXPECT_TRUE(ms.empty());
+
+	h.Increment(1);
+	h.Measure(&ms);
+	ASSERT_EQ(ms.size(), 1);
+	EXPECT_DOUBLE_EQ(ms.front().value, 1);
+}
+}  // namespace
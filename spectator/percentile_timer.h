@@ -3,7 +3,7 @@
 #include <algorithm>
 
 #include "id.h"
-#include "percentile_bucket_tags.inc"
+#include "meter_handle.h"
 #include "percentile_buckets.h"
 #include "registry.h"
 
@@ -14,38 +14,52 @@ class PercentileTimer
 {
    public:
 	PercentileTimer(Registry* registry, Id id, absl::Duration min, absl::Duration max) noexcept
-	    : registry_{registry}, id_{std::move(id)}, min_{min}, max_{max}, timer_{registry->GetTimer(id_)}
+	    : registry_{registry},
+	      id_{std::move(id)},
+	      min_{min},
+	      max_{max},
+	      timer_{registry->GetTimer(id_), &registry->ExpirationPasses()},
+	      histogram_{registry->GetTimerHistogram(id_), &registry->ExpirationPasses()}
 	{
 	}
 
-	auto get_counter(size_t index, const std::string* perc_tags) -> std::shared_ptr<Counter>
-	{
-		using spectator::refs;
-		auto counterId =
-		    id_.WithTags(refs().statistic(), refs().percentile(), refs().percentile(), intern_str(perc_tags[index]));
-		return registry_->GetCounter(std::move(counterId));
-	}
+	void Record(absl::Duration amount) noexcept { Record(amount, 1); }
 
-	void Record(absl::Duration amount) noexcept
+	// record the same amount count times, for sampled values
+	void Record(absl::Duration amount, int64_t count) noexcept
 	{
-		timer_->Record(amount);
+		if (count <= 0)
+		{
+			return;
+		}
+		timer()->Record(amount, count);
 		auto restricted = std::clamp(amount, min_, max_);
 		auto index = PercentileBucketIndexOf(absl::ToInt64Nanoseconds(restricted));
-		auto c = get_counter(index, kTimerTags.begin());
-		c->Increment();
+		Histogram()->Increment(index, count);
 	}
 
-	void Record(std::chrono::nanoseconds amount) noexcept { Record(absl::FromChrono(amount)); }
+	void Record(std::chrono::nanoseconds amount) noexcept { Record(absl::FromChrono(amount), 1); }
+	void Record(std::chrono::nanoseconds amount, int64_t count) noexcept { Record(absl::FromChrono(amount), count); }
 	auto MeterId() const noexcept -> const Id& { return id_; }
-	auto Count() const noexcept -> int64_t { return timer_->Count(); }
-	auto TotalTime() const noexcept -> int64_t { return timer_->TotalTime(); }
+	auto Count() const noexcept -> int64_t { return timer()->Count(); }
+	auto TotalTime() const noexcept -> int64_t { return timer()->TotalTime(); }
+	auto Histogram() const noexcept -> PercentileHistogram*
+	{
+		return histogram_.Get([this]() { return registry_->GetTimerHistogram(id_); });
+	}
 
    private:
 	Registry* registry_;
 	Id id_;
 	absl::Duration min_;
 	absl::Duration max_;
-	std::shared_ptr<Timer> timer_;
+	mutable MeterHandle<Timer> timer_;
+	mutable MeterHandle<PercentileHistogram> histogram_;
+
+	auto timer() const noexcept -> Timer*
+	{
+		return timer_.Get([this]() { return registry_->GetTimer(id_); });
+	}
 };
 
 }  // namespace spectator
@@ -1,16 +1,15 @@
 #pragma once
 
 #include "../metatron/metatron_config.h"
-#include "../ska/flat_hash_map.hpp"
 #include "../util/logger.h"
-#include "absl/synchronization/blocking_counter.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
-#include "common_refs.h"
+#include "async_http_client.h"
+#include "batch_encoder.h"
 #include "config.h"
 #include "counter.h"
-#include "http_client.h"
 #include "measurement.h"
-#include "smile.h"
+#include "string_pool.h"
 
 #include <asio/post.hpp>
 #include <asio/thread_pool.hpp>
@@ -50,13 +49,25 @@ class Publisher
 	      droppedHttp_{detail::get_counter(registry, Tags{{"id", "dropped"}, {"error", "http-error"}})},
 	      droppedOther_{detail::get_counter(registry, Tags{{"id", "dropped"}, {"error", "other"}})},
 	      num_sender_threads_{std::min(8U, std::thread::hardware_concurrency())},
+	      max_pending_{2 * std::max(num_sender_threads_, registry->GetConfig().publish_connections)},
 	      pool_{num_sender_threads_}
 	{
-		buffers_.resize(num_sender_threads_);
 		for (const auto& kv : registry_->GetConfig().common_tags)
 		{
 			common_tags_.add(kv.first, kv.second);
 		}
+		// the payload of a batch lives in its encoder until the request completes
+		const auto& cfg = registry_->GetConfig();
+		Executor executor;
+		if (cfg.parallel_compression)
+		{
+			executor = [this](std::function<void()> task) { asio::post(pool_, std::move(task)); };
+		}
+		encoders_.reserve(max_pending_);
+		for (size_t i = 0; i < max_pending_; ++i)
+		{
+			encoders_.emplace_back(common_tags_, cfg.compression, executor);
+		}
 	}
 
 	Publisher(const Publisher&) = delete;
@@ -96,6 +107,8 @@ class Publisher
 			throw std::invalid_argument("Invalid batch_size: " + std::to_string(cfg.batch_size));
 		}
 
+		auto max_connections = std::max(cfg.publish_connections, size_t{1});
+		http_client_ = std::make_unique<AsyncHttpClient>(registry_, get_http_config(cfg), max_connections);
 		sender_thread_ = std::thread(&Publisher::sender, this);
 	}
 
@@ -119,6 +132,7 @@ class Publisher
 			{
 				logger->error("Exception while flushing metrics during shutdown: {}", e.what());
 			}
+			http_client_.reset();
 		}
 
 		if (http_initialized_.exchange(false))
@@ -142,8 +156,23 @@ class Publisher
 	std::shared_ptr<Counter> droppedOther_;
 	Tags common_tags_;
 	size_t num_sender_threads_;
+	size_t max_pending_;
 	asio::thread_pool pool_;
-	std::vector<SmilePayload> buffers_;
+	std::vector<BatchEncoder> encoders_;
+	std::unique_ptr<AsyncHttpClient> http_client_;
+
+	// what the batches of a publish share. The callbacks own it too, since the http client
+	// can still be running the last one after send_metrics saw pending drop to 0
+	struct send_state
+	{
+		absl::Mutex responses_mutex;
+		std::vector<std::pair<int, HttpResponse>> responses;
+		absl::Mutex encoders_mutex;
+		std::vector<BatchEncoder*> avail_encoders;
+		std::mutex pending_mutex;
+		std::condition_variable pending_cv;
+		size_t pending = 0;
+	};
 
 	void sender() noexcept
 	{
@@ -180,123 +209,6 @@ class Publisher
 		logger->info("Stopping Publisher");
 	}
 
-	// for testing
-   protected:
-	using StrTable = ska::flat_hash_map<StrRef, int>;
-	auto build_str_table(SmilePayload* payload, std::vector<Measurement>::const_iterator first,
-	                     std::vector<Measurement>::const_iterator last) -> StrTable
-	{
-		StrTable strings{static_cast<StrTable::size_type>((last - first) * 7)};
-		for (const auto& tag : common_tags_)
-		{
-			strings[tag.key] = 0;
-			strings[tag.value] = 0;
-		}
-		strings[refs().name()] = 0;
-		for (auto it = first; it != last; ++it)
-		{
-			const auto& m = *it;
-			strings[m.id.Name()] = 0;
-			for (const auto& tag : m.id.GetTags())
-			{
-				strings[tag.key] = 0;
-				strings[tag.value] = 0;
-			}
-		}
-		auto idx = 0;
-		for (auto& kv : strings)
-		{
-			kv.second = idx++;
-		}
-
-		payload->Append(strings.size());
-		for (const auto& s : strings)
-		{
-			payload->Append(s.first.Get());
-		}
-		return strings;
-	}
-
-	enum class Op
-	{
-		Add = 0,
-		Max = 10
-	};
-
-	auto op_from_tags(const Tags& tags) -> Op
-	{
-		auto stat = tags.at(refs().statistic());
-		if (stat == refs().count() || stat == refs().totalAmount() || stat == refs().totalTime() ||
-		    stat == refs().totalOfSquares() || stat == refs().percentile())
-		{
-			return Op::Add;
-		}
-		return Op::Max;
-	}
-
-	template <typename T>
-	void add_tags(SmilePayload* payload, const StrTable& strings, const T& tags)
-	{
-		for (const auto& tag : tags)
-		{
-			auto k_pair = strings.find(tag.key);
-			auto v_pair = strings.find(tag.value);
-			assert(k_pair != strings.end());
-			assert(v_pair != strings.end());
-			payload->Append(k_pair->second);
-			payload->Append(v_pair->second);
-		}
-	}
-
-	void append_measurement(SmilePayload* payload, const StrTable& strings, const std::vector<int>& common_ids,
-	                        const Measurement& m)
-	{
-		auto op = op_from_tags(m.id.GetTags());
-		auto common_tags_size = common_ids.size() / 2;
-		auto total_tags = m.id.GetTags().size() + 1 + common_tags_size;
-		payload->Append(total_tags);
-		for (auto i : common_ids)
-		{
-			payload->Append(i);
-		}
-		add_tags(payload, strings, m.id.GetTags());
-		auto name_idx = strings.find(refs().name())->second;
-		auto name_value_idx = strings.find(m.id.Name())->second;
-		payload->Append(name_idx);
-		payload->Append(name_value_idx);
-		auto op_num = static_cast<int>(op);
-		payload->Append(op_num);
-		payload->Append(m.value);
-	}
-
-	auto get_common_ids(const StrTable& strings) -> std::vector<int>
-	{
-		std::vector<int> ids;
-		ids.reserve(common_tags_.size() * 2);
-		for (const auto& tag : common_tags_)
-		{
-			auto key_pair = strings.find(tag.key);
-			auto val_pair = strings.find(tag.value);
-			assert(key_pair != strings.end());
-			assert(val_pair != strings.end());
-			ids.emplace_back(key_pair->second);
-			ids.emplace_back(val_pair->second);
-		}
-		return ids;
-	}
-
-	void measurements_to_json(SmilePayload* payload, std::vector<Measurement>::const_iterator first,
-	                          std::vector<Measurement>::const_iterator last)
-	{
-		payload->Init();
-		auto strings = build_str_table(payload, first, last);
-		auto common_ids = get_common_ids(strings);
-		for (auto it = first; it != last; ++it)
-		{
-			append_measurement(payload, strings, common_ids, *it);
-		}
-	}
-
 	static auto get_http_config(const Config& cfg) -> HttpClientConfig
 	{
 		auto read_timeout = cfg.read_timeout;
@@ -400,107 +312,128 @@ class Publisher
 	{
 		auto logger = registry_->GetLogger();
 		const auto& cfg = registry_->GetConfig();
-		auto http_cfg = get_http_config(cfg);
 		auto start = absl::Now();
-		HttpClient client{registry_, std::move(http_cfg)};
-		auto batch_size = static_cast<std::vector<Measurement>::difference_type>(cfg.batch_size);
-		auto measurements = registry_->Measurements();
+		auto batch_size = static_cast<size_t>(cfg.batch_size);
 
-		if (!cfg.is_enabled() || measurements.empty())
+		if (!cfg.is_enabled())
 		{
+			// still take the measurements, so the next interval only reports its own activity
+			registry_->MeasureBatches(batch_size, [](MeasurementColumns&&) {});
 			if (logger->should_log(spdlog::level::trace))
 			{
-				logger->trace("Skip sending metrics: ATLAS_DISABLED_FILE exists or measurements is empty");
+				logger->trace("Skip sending metrics: ATLAS_DISABLED_FILE exists");
 			}
 			return;
 		}
 
-		if (logger->should_log(spdlog::level::trace))
+		// the strings of meters removed after they are measured must not be reclaimed
+		// until every batch is encoded
+		StringPool::Pin pin{&the_str_pool()};
+		auto state = std::make_shared<send_state>();
+		std::transform(encoders_.begin(), encoders_.end(), std::back_inserter(state->avail_encoders),
+		               [](auto& e) { return &e; });
+
+		// batches are sent as soon as they are measured, while the rest of the registry is
+		// still being walked. Limit the number in flight, so we don't end up holding the
+		// measurements for the whole registry when the aggregator is slow
+		auto max_pending = max_pending_;
+
+		// encoding happens on the sender pool, the requests are then handed to the http
+		// client, which calls us back from its event loop once they complete
+		auto send_batch = [&](MeasurementColumns&& measurements)
 		{
-			logger->trace("Sending {} measurements to {}", measurements.size(), registry_->GetConfig().uri);
-			for (const auto& m : measurements)
+			if (logger->should_log(spdlog::level::trace))
 			{
-				logger->trace("{}", m);
+				logger->trace("Sending {} measurements to {}", measurements.size(), cfg.uri);
+				for (size_t i = 0; i < measurements.size(); ++i)
+				{
+					logger->trace("{}", measurements[i]);
+				}
+			}
+			{
+				std::unique_lock<std::mutex> lock{state->pending_mutex};
+				state->pending_cv.wait(lock, [&state, max_pending]() { return state->pending < max_pending; });
+				++state->pending;
 			}
-		}
-
-		auto from = measurements.begin();
-		auto end = measurements.end();
-		std::vector<std::pair<int, HttpResponse>> responses;
-
-		absl::Mutex responses_mutex;
-		absl::Mutex buffers_mutex;
-		std::vector<SmilePayload*> avail_buffers;
-		std::transform(buffers_.begin(), buffers_.end(), std::back_inserter(avail_buffers), [](auto& b) { return &b; });
-		std::vector<std::pair<Measurements::const_iterator, Measurements::const_iterator>> batches;
 
-		// If batch_size is 0, the batching loop will create infinite empty batches:
-		while (from != end)
+			auto batch = std::make_shared<MeasurementColumns>(std::move(measurements));
+			asio::post(pool_,
+			           [this, batch, state]() mutable
+			           {
+				           BatchEncoder* encoder = nullptr;
+				           {
+					           absl::MutexLock lock(&state->encoders_mutex);
+					           encoder = state->avail_encoders.back();
+					           state->avail_encoders.pop_back();
+				           }
+
+				           auto payload = encoder->Encode(*batch);
+				           auto batch_size = static_cast<int>(batch->size());
+				           // the batch must not outlive send_metrics
+				           batch.reset();
+				           auto on_response = [this, batch_size, encoder, state](HttpResponse response)
+				           {
+					           {
+						           absl::MutexLock lock(&state->responses_mutex);
+						           if (response.status / 100 == 2)
+						           {
+							           last_successful_send_ = absl::GetCurrentTimeNanos();
+						           }
+						           state->responses.emplace_back(batch_size, std::move(response));
+					           }
+					           {
+						           absl::MutexLock lock(&state->encoders_mutex);
+						           state->avail_encoders.emplace_back(encoder);
+					           }
+					           std::lock_guard<std::mutex> lock{state->pending_mutex};
+					           --state->pending;
+					           state->pending_cv.notify_all();
+				           };
+				           http_client_->Post(registry_->GetConfig().uri, HttpClient::kSmileJson, payload,
+				                              std::move(on_response));
+			           });
+		};
+
+		auto total = registry_->MeasureBatches(batch_size, send_batch);
 		{
-			auto to_end = std::distance(from, end);
-			auto to_advance = std::min(batch_size, to_end);
-			auto to = from;
-			std::advance(to, to_advance);
-			batches.emplace_back(from, to);
-			from = to;
+			std::unique_lock<std::mutex> lock{state->pending_mutex};
+			state->pending_cv.wait(lock, [&state]() { return state->pending == 0; });
 		}
-		absl::BlockingCounter batches_to_do{static_cast<int>(batches.size())};
 
-		for (const auto& batch : batches)
+		if (total == 0)
 		{
-			asio::post(
-			    pool_,
-			    [this, batch, &batches_to_do, &client, &responses, &buffers_mutex, &avail_buffers, &responses_mutex]()
-			    {
-				    const auto& uri = this->registry_->GetConfig().uri;
-				    SmilePayload* payload = nullptr;
-				    {
-					    absl::MutexLock lock(&buffers_mutex);
-					    payload = avail_buffers.back();
-					    avail_buffers.pop_back();
-				    }
-
-				    measurements_to_json(payload, batch.first, batch.second);
-				    auto response = client.Post(uri, HttpClient::kSmileJson, payload->Result());
-				    {
-					    absl::MutexLock lock(&responses_mutex);
-					    auto batch_size = batch.second - batch.first;
-					    if (response.status / 100 == 2)
-					    {
-						    last_successful_send_ = absl::GetCurrentTimeNanos();
-					    }
-					    responses.emplace_back(batch_size, std::move(response));
-				    }
-				    {
-					    absl::MutexLock lock(&buffers_mutex);
-					    avail_buffers.emplace_back(payload);
-				    }
-				    batches_to_do.DecrementCount();
-			    });
+			if (logger->should_log(spdlog::level::trace))
+			{
+				logger->trace("Skip sending metrics: measurements is empty");
+			}
+			return;
 		}
-		batches_to_do.Wait();
 
 		auto num_err = 0U;
 		auto num_sent = 0U;
 		tsl::hopscotch_set<std::string> err_messages;
-		for (const auto& resp_pair : responses)
 		{
-			size_t batch_sent = 0;
-			size_t batch_err = 0;
-			std::tie(batch_sent, batch_err) = handle_aggr_response(resp_pair.second, resp_pair.first, &err_messages);
-			num_sent += batch_sent;
-			num_err += batch_err;
+			absl::MutexLock lock(&state->responses_mutex);
+			for (const auto& resp_pair : state->responses)
+			{
+				size_t batch_sent = 0;
+				size_t batch_err = 0;
+				std::tie(batch_sent, batch_err) =
+				    handle_aggr_response(resp_pair.second, resp_pair.first, &err_messages);
+				num_sent += batch_sent;
+				num_err += batch_err;
+			}
 		}
 
 		auto elapsed = absl::Now() - start;
 		if (num_err > 0)
 		{
-			logger->info("Sent: {} Dropped: {} Total: {}. Elapsed {:.3f}s", num_sent, num_err, measurements.size(),
+			logger->info("Sent: {} Dropped: {} Total: {}. Elapsed {:.3f}s", num_sent, num_err, total,
 			             absl::ToDoubleSeconds(elapsed));
 		}
 		else
 		{
-			logger->debug("Sent: {} Dropped: {} Total: {}. Elapsed {:.3f}s", num_sent, num_err, measurements.size(),
+			logger->debug("Sent: {} Dropped: {} Total: {}. Elapsed {:.3f}s", num_sent, num_err, total,
 			              absl::ToDoubleSeconds(elapsed));
 		}
 		for (const auto& m : err_messages)
@@ -0,0 +1,58 @@
+#include "gzip.h"
+#include "http_server.h"
+#include "registry.h"
+#include "test_utils.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+using spectator::GetConfiguration;
+using spectator::Registry;
+
+TEST(Publisher, SendsBatches)
+{
+	http_server server;
+	server.start();
+	auto port = server.get_port();
+	ASSERT_TRUE(port > 0) << "Port = " << port;
+
+	auto cfg = GetConfiguration();
+	cfg->uri = fmt::format("http://localhost:{}/foo", port);
+	cfg->batch_size = 10;
+	cfg->frequency = absl::Seconds(60);
+	Registry r{std::move(cfg), spectatord::Logger()};
+	for (auto i = 0; i < 25; ++i)
+	{
+		r.GetCounter(fmt::format("counter.{}", i))->Increment();
+	}
+
+	// stopping flushes the measurements if the first interval has not been sent yet
+	r.Start();
+	r.Stop();
+	server.stop();
+
+	// each batch is posted on its own
+	const auto& requests = server.get_requests();
+	ASSERT_GE(requests.size(), 3);
+	std::string bodies;
+	for (const auto& req : requests)
+	{
+		EXPECT_EQ(req.path(), "/foo");
+		EXPECT_EQ(req.get_header("Content-Type"), "application/x-jackson-smile");
+
+		char dest[8192];
+		size_t dest_len = sizeof dest;
+		ASSERT_EQ(spectator::gzip_uncompress(dest, &dest_len, req.body(), req.size()), Z_OK);
+		bodies.append(dest, dest_len);
+	}
+
+	// all the counters made it, prefixed by their smile tiny ascii token
+	for (auto i = 0; i < 25; ++i)
+	{
+		auto name = fmt::format("counter.{}", i);
+		auto token = static_cast<char>(0x40 + name.length() - 1);
+		EXPECT_NE(bodies.find(token + name), std::string::npos) << name;
+	}
+}
+
+}  // namespace
@@ -1,4 +1,5 @@
 #include "registry.h"
+#include "percentile_bucket_tags.inc"
 
 #include <fmt/ostream.h>
 #include <utility>
@@ -147,6 +148,16 @@ auto Registry::GetTimer(std::string_view name, Tags tags) noexcept -> std::share
 	return GetTimer(Id::Of(name, std::move(tags)));
 }
 
+auto Registry::GetTimerHistogram(Id id) noexcept -> std::shared_ptr<PercentileHistogram>
+{
+	return all_meters_.insert_timer_histogram(std::move(id), kTimerTags.begin());
+}
+
+auto Registry::GetDistSummaryHistogram(Id id) noexcept -> std::shared_ptr<PercentileHistogram>
+{
+	return all_meters_.insert_dist_histogram(std::move(id), kDistTags.begin());
+}
+
 void Registry::Start() noexcept
 {
 	publisher_.Start();
@@ -184,6 +195,56 @@ auto Registry::Measurements() const noexcept -> std::vector<Measurement>
 	return res;
 }
 
+auto Registry::MeasureBatches(size_t batch_size, const batch_callback& on_batch) const noexcept -> size_t
+{
+	size_t total = 0;
+	auto send = [&](MeasurementColumns&& batch)
+	{
+		total += batch.size();
+		if (!ms_callbacks_.empty())
+		{
+			auto ms = batch.ToMeasurements();
+			for (const auto& callback : ms_callbacks_)
+			{
+				callback(ms);
+			}
+		}
+		on_batch(std::move(batch));
+	};
+
+	// copy the full batches out and keep the rest
+	auto on_stripe = [&](MeasurementColumns* ms)
+	{
+		if (ms->size() < batch_size)
+		{
+			return;
+		}
+		size_t from = 0;
+		while (ms->size() - from >= batch_size)
+		{
+			send(MeasurementColumns(*ms, from, from + batch_size));
+			from += batch_size;
+		}
+		MeasurementColumns rest(*ms, from, ms->size());
+		rest.reserve(batch_size);
+		*ms = std::move(rest);
+	};
+
+	MeasurementColumns res;
+	res.reserve(batch_size);
+	all_meters_.measure(&res, meter_ttl_, on_stripe);
+	if (!res.empty())
+	{
+		send(std::move(res));
+	}
+
+	if (config_->status_metrics_enabled)
+	{
+		registry_size_->Record(total);
+	}
+	return total;
+}
+
 void Registry::UpdateCommonTag(const std::string& k, const std::string& v)
 {
 	auto it = config_->common_tags.find(k);
@@ -226,9 +287,27 @@ void Registry::DeleteAllMeters(const std::string& type)
 
 void Registry::remove_expired_meters() noexcept
 {
-	int total = 0, expired = 0;
-	std::tie(expired, total) = all_meters_.remove_expired(meter_ttl_);
-	logger_->debug("Removed {} expired meters out of {} total", expired, total);
+	auto start = absl::Now();
+	auto stats = all_meters_.remove_expired(meter_ttl_);
+	auto elapsed = absl::Now() - start;
+	logger_->debug("Removed {} expired meters out of {} total in {}s, holding a lock for at most {}s", stats.expired,
+	               stats.total, absl::ToDoubleSeconds(elapsed), absl::ToDoubleSeconds(stats.max_hold));
+	if (config_->status_metrics_enabled)
+	{
+		Tags tags{{"nf.process", config_->process_name}};
+		GetTimer("spectator.expirationScanTime", tags)->Record(elapsed);
+		GetMaxGauge("spectator.expirationLockTime", tags)->Update(absl::ToDoubleSeconds(stats.max_hold));
+		GetCounter("spectator.expiredMeters", tags)->Add(stats.expired);
+	}
+	expiration_passes_.fetch_add(1, std::memory_order_release);
+}
+
+void Registry::reclaim_strings() noexcept
+{
+	StrRefSet live;
+	all_meters_.add_strings(&live);
+	auto freed = the_str_pool().Reclaim(live);
+	logger_->debug("Reclaimed {} unused strings, {} strings in use by meters", freed, live.size());
 }
 
 void Registry::expirer() noexcept
@@ -253,6 +332,10 @@ void Registry::expirer() noexcept
 	{
 		auto start = absl::Now();
 		remove_expired_meters();
+		if (config_->reclaim_strings)
+		{
+			reclaim_strings();
+		}
 		auto elapsed = absl::Now() - start;
 		if (elapsed < frequency)
 		{
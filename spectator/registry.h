@@ -12,12 +12,17 @@
 #include "monotonic_counter.h"
 #include "monotonic_counter_uint.h"
 #include "monotonic_sampled.h"
+#include "percentile_histogram.h"
 #include "publisher.h"
+#include "string_pool.h"
 #include "timer.h"
 
+#include <algorithm>
+#include <array>
 #include <condition_variable>
 #include <iostream>
 #include <mutex>
+#include <optional>
 #include <spdlog/spdlog.h>
 #include <tsl/hopscotch_map.h>
 
@@ -46,115 +51,284 @@ inline auto is_meter_expired<Gauge>(int64_t now, const Gauge& m, int64_t /* mete
 	return m.HasExpired(now);
 }
 
+// what a pass of the expirer did
+struct expire_stats
+{
+	int expired{0};
+	int total{0};
+	// the longest a stripe lock was held
+	absl::Duration max_hold{};
+};
+
+inline void add_id_strings(const Id& id, StrRefSet* live)
+{
+	live->insert(id.Name());
+	for (const auto& tag : id.GetTags())
+	{
+		live->insert(tag.key);
+		live->insert(tag.value);
+	}
+}
+
+// Meters are spread over a number of stripes, each one with its own lock, so
+// threads getting different meters, and the publisher or the expirer walking
+// the table, don't serialize on a single mutex.
 template <typename M>
 struct meter_map
 {
-	mutable absl::Mutex meters_mutex_{};
+	static constexpr size_t kStripeBits = 4;
+	static constexpr size_t kStripes = size_t{1} << kStripeBits;
+	static constexpr size_t kExpireSlice = 1024;
 	using table_t = tsl::hopscotch_map<Id, std::shared_ptr<M>>;
-	table_t meters_ ABSL_GUARDED_BY(meters_mutex_);
+
+	struct alignas(64) stripe
+	{
+		mutable absl::Mutex mutex{};
+		table_t meters ABSL_GUARDED_BY(mutex);
+		// meters removed while in the dirty list stay in it, and are kept alive by it
+		// until the list is measured
+		std::shared_ptr<DirtyMeters> dirty{std::make_shared<DirtyMeters>()};
+	};
+	std::array<stripe, kStripes> stripes_;
+
+	meter_map() = default;
+	meter_map(const meter_map&) = delete;
+	meter_map(meter_map&&) = delete;
+	auto operator=(const meter_map&) -> meter_map& = delete;
+	auto operator=(meter_map&&) -> meter_map& = delete;
+	// meters can outlive the registry, so they must stop adding themselves to the dirty lists
+	~meter_map() { remove_all(); }
+
+	// the id hash is built from interned string pointers, so mix it before
+	// picking a stripe, and use the high bits which the tables do not use
+	auto stripe_for(const Id& id) noexcept -> stripe&
+	{
+		auto h = static_cast<uint64_t>(std::hash<Id>()(id)) * UINT64_C(0x9E3779B97F4A7C15);
+		return stripes_[h >> (64 - kStripeBits)];
+	}
 
 	auto size() const noexcept
 	{
-		absl::MutexLock lock(&meters_mutex_);
-		return meters_.size();
+		size_t total = 0;
+		for (const auto& s : stripes_)
+		{
+			absl::ReaderMutexLock lock(&s.mutex);
+			total += s.meters.size();
+		}
+		return total;
 	}
 
 	auto contains(const Id& id) -> bool
 	{
-		absl::MutexLock lock(&meters_mutex_);
-		return meters_.contains(id);
+		auto& s = stripe_for(id);
+		absl::ReaderMutexLock lock(&s.mutex);
+		return s.meters.contains(id);
 	}
 
-	// only insert if it doesn't exist, otherwise return the existing meter
-	auto insert(std::shared_ptr<M> meter) -> std::shared_ptr<M>
+	// return the existing meter, only creating a new one if it doesn't exist
+	template <typename... Args>
+	auto insert(Id id, Args&&... args) -> std::shared_ptr<M>
 	{
-		absl::MutexLock lock(&meters_mutex_);
-		const auto& id = meter->MeterId();
-		auto insert_result = meters_.emplace(id, std::move(meter));
+		auto& s = stripe_for(id);
+		{
+			absl::ReaderMutexLock lock(&s.mutex);
+			auto it = s.meters.find(id);
+			if (it != s.meters.end())
+			{
+				return it->second;
+			}
+		}
+
+		auto meter = std::make_shared<M>(id, std::forward<Args>(args)...);
+		absl::MutexLock lock(&s.mutex);
+		auto insert_result = s.meters.emplace(std::move(id), std::move(meter));
+		if constexpr (!M::kMeasureWhenIdle)
+		{
+			if (insert_result.second)
+			{
+				insert_result.first->second->TrackUpdates(s.dirty);
+			}
+		}
 		return insert_result.first->second;
 	}
 
 	auto at(const Id& id) -> std::shared_ptr<M>
 	{
-		absl::MutexLock lock(&meters_mutex_);
-		return meters_.at(id);
+		auto& s = stripe_for(id);
+		absl::ReaderMutexLock lock(&s.mutex);
+		return s.meters.at(id);
 	}
 
-	void measure(std::vector<Measurement>* res, int64_t meter_ttl) const
+	// on_stripe is called with the measurements taken so far after each stripe is
+	// released, so it can hand them off, or block, without stalling the writers.
+	// Only the meters updated since they were last measured are visited, unless the
+	// meter type reports values when idle
+	template <typename Results, typename F>
+	void measure(Results* res, int64_t meter_ttl, F&& on_stripe) const
 	{
-		absl::MutexLock lock(&meters_mutex_);
 		auto now = absl::GetCurrentTimeNanos();
-
-		for (const auto& pair : meters_)
+		std::vector<Meter*> dirty;
+		std::vector<std::shared_ptr<Meter>> removed;
+		for (const auto& s : stripes_)
 		{
-			const auto& m = pair.second;
-			if (!is_meter_expired(now, *m, meter_ttl))
 			{
-				m->Measure(res);
+				absl::ReaderMutexLock lock(&s.mutex);
+				if constexpr (M::kMeasureWhenIdle)
+				{
+					for (const auto& pair : s.meters)
+					{
+						const auto& m = pair.second;
+						if (!is_meter_expired(now, *m, meter_ttl))
+						{
+							m->Measure(res);
+						}
+					}
+				}
+				else
+				{
+					{
+						absl::MutexLock dirty_lock(&s.dirty->mutex);
+						dirty.swap(s.dirty->meters);
+						removed.swap(s.dirty->removed);
+					}
+					for (auto* meter : dirty)
+					{
+						auto* m = static_cast<M*>(meter);
+						if (m->IsRemoved())
+						{
+							continue;
+						}
+						m->ClearDirty();
+						if (!is_meter_expired(now, *m, meter_ttl))
+						{
+							m->Measure(res);
+						}
+					}
+					dirty.clear();
+					removed.clear();
+				}
 			}
+			on_stripe(res);
 		}
 	}
 
-	auto remove_expired(int64_t meter_ttl) noexcept -> std::pair<int, int>
+	template <typename Results>
+	void measure(Results* res, int64_t meter_ttl) const
 	{
-		auto now = absl::GetCurrentTimeNanos();
-		auto expired = 0;
-		auto total = 0;
+		measure(res, meter_ttl, [](Results*) {});
+	}
 
+	// The stripe lock is released after checking kExpireSlice meters, so threads looking
+	// up meters only wait for a slice instead of a whole stripe. The scan resumes from
+	// the next meter, or if it was removed in the meantime, from as many meters into the
+	// stripe as were kept so far. Meters missed because the table changed are expired on
+	// the next pass. on_slice is called with the next meter while the stripe is released
+	template <typename F>
+	void remove_expired(int64_t meter_ttl, expire_stats* stats, F&& on_slice) noexcept
+	{
+		auto now = absl::GetCurrentTimeNanos();
+		for (auto& s : stripes_)
 		{
-			absl::MutexLock lock{&meters_mutex_};
-			auto it = meters_.begin();
-			auto end = meters_.end();
-			while (it != end)
+			std::optional<Id> next;
+			size_t kept = 0;
+			for (;;)
 			{
-				++total;
-				if (is_meter_expired(now, *it->second, meter_ttl))
+				absl::ReleasableMutexLock lock{&s.mutex};
+				auto start = absl::Now();
+				auto it = s.meters.begin();
+				if (next)
 				{
-					it = meters_.erase(it);
-					++expired;
+					it = s.meters.find(*next);
+					if (it == s.meters.end())
+					{
+						it = s.meters.begin();
+						std::advance(it, std::min(kept, s.meters.size()));
+					}
 				}
-				else
+				for (size_t n = 0; it != s.meters.end() && n < kExpireSlice; ++n)
+				{
+					++stats->total;
+					if (is_meter_expired(now, *it->second, meter_ttl))
+					{
+						forget(&s, it->second);
+						it = s.meters.erase(it);
+						++stats->expired;
+					}
+					else
+					{
+						++it;
+						++kept;
+					}
+				}
+				stats->max_hold = std::max(stats->max_hold, absl::Now() - start);
+				if (it == s.meters.end())
 				{
-					++it;
+					break;
 				}
+				next = it->first;
+				lock.Release();
+				on_slice(*next);
 			}
 		}
-		return {expired, total};
+	}
+
+	void remove_expired(int64_t meter_ttl, expire_stats* stats) noexcept
+	{
+		remove_expired(meter_ttl, stats, [](const Id&) {});
 	}
 
 	auto remove_one(Id id) noexcept -> bool
 	{
-		if (contains(id))
-		{
-			absl::MutexLock lock{&meters_mutex_};
-			meters_.erase(id);
-			return true;
-		}
-		else
+		auto& s = stripe_for(id);
+		absl::MutexLock lock{&s.mutex};
+		auto it = s.meters.find(id);
+		if (it == s.meters.end())
 		{
 			return false;
 		}
+		forget(&s, it->second);
+		s.meters.erase(it);
+		return true;
 	}
 
 	void remove_all() noexcept
 	{
-		absl::MutexLock lock{&meters_mutex_};
-		auto it = meters_.begin();
-		auto end = meters_.end();
-		while (it != end)
+		for (auto& s : stripes_)
+		{
+			absl::MutexLock lock{&s.mutex};
+			absl::MutexLock dirty_lock(&s.dirty->mutex);
+			for (const auto& pair : s.meters)
+			{
+				pair.second->MarkRemoved();
+				pair.second->StopTracking();
+			}
+			s.dirty->meters.clear();
+			s.dirty->removed.clear();
+			s.meters.clear();
+		}
+	}
+
+	// mark a meter as removed, while holding the stripe lock for writing. If it is in
+	// the dirty list, it stays there until measured, which skips it
+	static void forget(stripe* s, const std::shared_ptr<M>& meter) noexcept
+	{
+		absl::MutexLock dirty_lock(&s->dirty->mutex);
+		meter->MarkRemoved();
+		if (meter->IsDirty())
 		{
-			meters_.erase(it->first);
-			++it;
+			s->dirty->removed.push_back(meter);
 		}
+		meter->StopTracking();
 	}
 
 	auto get_ids() const -> std::vector<Id>
 	{
 		std::vector<Id> res;
+		res.reserve(size());
+		for (const auto& s : stripes_)
 		{
-			absl::MutexLock lock(&meters_mutex_);
-			res.reserve(meters_.size());
-			for (const auto& pair : meters_)
+			absl::ReaderMutexLock lock(&s.mutex);
+			for (const auto& pair : s.meters)
 			{
 				res.emplace_back(pair.first);
 			}
@@ -162,13 +336,26 @@ struct meter_map
 		return res;
 	}
 
+	void add_strings(StrRefSet* live) const
+	{
+		for (const auto& s : stripes_)
+		{
+			absl::ReaderMutexLock lock{&s.mutex};
+			for (const auto& pair : s.meters)
+			{
+				add_id_strings(pair.first, live);
+			}
+		}
+	}
+
 	auto get_values() const -> std::vector<const M*>
 	{
 		std::vector<const M*> res;
+		res.reserve(size());
+		for (const auto& s : stripes_)
 		{
-			absl::MutexLock lock{&meters_mutex_};
-			res.reserve(meters_.size());
-			for (const auto& pair : meters_)
+			absl::ReaderMutexLock lock{&s.mutex};
+			for (const auto& pair : s.meters)
 			{
 				res.emplace_back(pair.second.get());
 			}
@@ -188,81 +375,98 @@ struct all_meters
 	meter_map<MonotonicCounterUint> mono_counters_uint_;
 	meter_map<MonotonicSampled> mono_sampled_;
 	meter_map<Timer> timers_;
+	meter_map<PercentileHistogram> timer_histograms_;
+	meter_map<PercentileHistogram> dist_histograms_;
 
 	auto size() const -> size_t
 	{
 		return age_gauges_.size() + counters_.size() + dist_sums_.size() + gauges_.size() + max_gauges_.size() +
-		       mono_counters_.size() + mono_counters_uint_.size() + timers_.size();
+		       mono_counters_.size() + mono_counters_uint_.size() + timers_.size() + timer_histograms_.size() +
+		       dist_histograms_.size();
+	}
+
+	template <typename Results, typename F>
+	void measure(Results* res, int64_t meter_ttl, F&& on_stripe) const
+	{
+		age_gauges_.measure(res, meter_ttl, on_stripe);
+		counters_.measure(res, meter_ttl, on_stripe);
+		dist_sums_.measure(res, meter_ttl, on_stripe);
+		gauges_.measure(res, meter_ttl, on_stripe);
+		max_gauges_.measure(res, meter_ttl, on_stripe);
+		mono_counters_.measure(res, meter_ttl, on_stripe);
+		mono_counters_uint_.measure(res, meter_ttl, on_stripe);
+		timers_.measure(res, meter_ttl, on_stripe);
+		timer_histograms_.measure(res, meter_ttl, on_stripe);
+		dist_histograms_.measure(res, meter_ttl, on_stripe);
 	}
 
 	auto measure(int64_t meter_ttl) const -> std::vector<Measurement>
 	{
 		std::vector<Measurement> res;
 		res.reserve(size() * 2);
-		age_gauges_.measure(&res, meter_ttl);
-		counters_.measure(&res, meter_ttl);
-		dist_sums_.measure(&res, meter_ttl);
-		gauges_.measure(&res, meter_ttl);
-		max_gauges_.measure(&res, meter_ttl);
-		mono_counters_.measure(&res, meter_ttl);
-		mono_counters_uint_.measure(&res, meter_ttl);
-		timers_.measure(&res, meter_ttl);
+		measure(&res, meter_ttl, [](std::vector<Measurement>*) {});
 		return res;
 	}
 
-	auto remove_expired(int64_t meter_ttl) -> std::pair<int, int>
+	auto remove_expired(int64_t meter_ttl) -> expire_stats
 	{
-		int total_expired = 0;
-		int expired = 0;
-		int count = 0;
-
+		expire_stats stats;
 		// age gauges don't expire
-		int total_count = age_gauges_.size();
-
-		std::tie(expired, count) = counters_.remove_expired(meter_ttl);
-		total_expired += expired;
-		total_count += count;
-		std::tie(expired, count) = dist_sums_.remove_expired(meter_ttl);
-		total_expired += expired;
-		total_count += count;
-		std::tie(expired, count) = gauges_.remove_expired(meter_ttl);
-		total_expired += expired;
-		total_count += count;
-		std::tie(expired, count) = max_gauges_.remove_expired(meter_ttl);
-		total_expired += expired;
-		total_count += count;
-		std::tie(expired, count) = mono_counters_.remove_expired(meter_ttl);
-		total_expired += expired;
-		total_count += count;
-		std::tie(expired, count) = mono_counters_uint_.remove_expired(meter_ttl);
-		total_expired += expired;
-		total_count += count;
-		std::tie(expired, count) = timers_.remove_expired(meter_ttl);
-		total_expired += expired;
-		total_count += count;
-		return {total_expired, total_count};
+		stats.total = age_gauges_.size();
+		counters_.remove_expired(meter_ttl, &stats);
+		dist_sums_.remove_expired(meter_ttl, &stats);
+		gauges_.remove_expired(meter_ttl, &stats);
+		max_gauges_.remove_expired(meter_ttl, &stats);
+		mono_counters_.remove_expired(meter_ttl, &stats);
+		mono_counters_uint_.remove_expired(meter_ttl, &stats);
+		timers_.remove_expired(meter_ttl, &stats);
+		timer_histograms_.remove_expired(meter_ttl, &stats);
+		dist_histograms_.remove_expired(meter_ttl, &stats);
+		return stats;
 	}
 
-	auto insert_age_gauge(Id id) { return age_gauges_.insert(std::make_shared<AgeGauge>(std::move(id))); }
+	void add_strings(StrRefSet* live) const
+	{
+		age_gauges_.add_strings(live);
+		counters_.add_strings(live);
+		dist_sums_.add_strings(live);
+		gauges_.add_strings(live);
+		max_gauges_.add_strings(live);
+		mono_counters_.add_strings(live);
+		mono_counters_uint_.add_strings(live);
+		mono_sampled_.add_strings(live);
+		timers_.add_strings(live);
+		timer_histograms_.add_strings(live);
+		dist_histograms_.add_strings(live);
+	}
+
+	auto insert_age_gauge(Id id) { return age_gauges_.insert(std::move(id)); }
+
+	auto insert_counter(Id id) { return counters_.insert(std::move(id)); }
+
+	auto insert_dist_sum(Id id) { return dist_sums_.insert(std::move(id)); }
 
-	auto insert_counter(Id id) { return counters_.insert(std::make_shared<Counter>(std::move(id))); }
+	auto insert_gauge(Id id, absl::Duration ttl) { return gauges_.insert(std::move(id), ttl); }
 
-	auto insert_dist_sum(Id id) { return dist_sums_.insert(std::make_shared<DistributionSummary>(std::move(id))); }
+	auto insert_max_gauge(Id id) { return max_gauges_.insert(std::move(id)); }
 
-	auto insert_gauge(Id id, absl::Duration ttl) { return gauges_.insert(std::make_shared<Gauge>(std::move(id), ttl)); }
+	auto insert_mono_counter(Id id) { return mono_counters_.insert(std::move(id)); }
 
-	auto insert_max_gauge(Id id) { return max_gauges_.insert(std::make_shared<MaxGauge>(std::move(id))); }
+	auto insert_mono_counter_uint(Id id) { return mono_counters_uint_.insert(std::move(id)); }
 
-	auto insert_mono_counter(Id id) { return mono_counters_.insert(std::make_shared<MonotonicCounter>(std::move(id))); }
+	auto insert_mono_sampled(Id id) { return mono_sampled_.insert(std::move(id)); }
 
-	auto insert_mono_counter_uint(Id id)
+	auto insert_timer(Id id) { return timers_.insert(std::move(id)); }
+
+	auto insert_timer_histogram(Id id, const std::string* perc_tags)
 	{
-		return mono_counters_uint_.insert(std::make_shared<MonotonicCounterUint>(std::move(id)));
+		return timer_histograms_.insert(std::move(id), perc_tags);
 	}
 
-	auto insert_mono_sampled(Id id) { return mono_sampled_.insert(std::make_shared<MonotonicSampled>(std::move(id))); }
-
-	auto insert_timer(Id id) { return timers_.insert(std::make_shared<Timer>(std::move(id))); }
+	auto insert_dist_histogram(Id id, const std::string* perc_tags)
+	{
+		return dist_histograms_.insert(std::move(id), perc_tags);
+	}
 };
 
 }  // namespace detail
@@ -272,6 +476,7 @@ class Registry
    public:
 	using logger_ptr = std::shared_ptr<spdlog::logger>;
 	using measurements_callback = std::function<void(const std::vector<Measurement>&)>;
+	using batch_callback = std::function<void(MeasurementColumns&&)>;
 
 	Registry(std::unique_ptr<Config> config, logger_ptr logger) noexcept;
 	Registry(const Registry&) = delete;
@@ -313,8 +518,18 @@ class Registry
 	auto GetTimer(Id id) noexcept -> std::shared_ptr<Timer>;
 	auto GetTimer(std::string_view name, Tags tags = {}) noexcept -> std::shared_ptr<Timer>;
 
+	// bucket counts for percentile timers and distribution summaries
+	auto GetTimerHistogram(Id id) noexcept -> std::shared_ptr<PercentileHistogram>;
+	auto GetDistSummaryHistogram(Id id) noexcept -> std::shared_ptr<PercentileHistogram>;
+
 	auto Measurements() const noexcept -> std::vector<Measurement>;
 
+	// Take the measurements for all meters, handing them to on_batch in batches of
+	// batch_size while the meter tables are walked, instead of collecting them all
+	// first. The measurement callbacks are called for each batch. Returns the number
+	// of measurements taken.
+	auto MeasureBatches(size_t batch_size, const batch_callback& on_batch) const noexcept -> size_t;
+
 	auto Size() const noexcept -> std::size_t { return all_meters_.size(); }
 
 	void Start() noexcept;
@@ -346,11 +561,21 @@ class Registry
 		return all_meters_.mono_counters_uint_.get_values();
 	}
 	auto Timers() const -> std::vector<const Timer*> { return all_meters_.timers_.get_values(); }
+	auto PercentileHistograms() const -> std::vector<const PercentileHistogram*>
+	{
+		auto res = all_meters_.timer_histograms_.get_values();
+		auto dist_histograms = all_meters_.dist_histograms_.get_values();
+		res.insert(res.end(), dist_histograms.begin(), dist_histograms.end());
+		return res;
+	}
 	auto GetLastSuccessTime() const -> int64_t { return publisher_.GetLastSuccessTime(); }
+	// number of expiration passes completed, used to know when a removed meter can no longer be in use
+	auto ExpirationPasses() const noexcept -> const std::atomic<uint64_t>& { return expiration_passes_; }
 
    private:
 	std::atomic<bool> should_stop_;
 	std::atomic<bool> age_gauge_first_warn_;
+	std::atomic<uint64_t> expiration_passes_{0};
 	std::mutex cv_mutex_;
 	std::condition_variable cv_;
 	std::thread expirer_thread_;
@@ -371,6 +596,7 @@ class Registry
    protected:
 	// for testing
 	void remove_expired_meters() noexcept;
+	void reclaim_strings() noexcept;
 };
 
 }  // namespace spectator
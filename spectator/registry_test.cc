@@ -1,7 +1,9 @@
+#include "batch_encoder.h"
 #include "registry.h"
 #include "test_utils.h"
 #include <fmt/ostream.h>
 #include <gtest/gtest.h>
+#include <numeric>
 
 namespace
 {
@@ -132,13 +134,15 @@ struct ExpRegistry : public Registry
 	explicit ExpRegistry(std::unique_ptr<spectator::Config> cfg) : Registry(std::move(cfg), spectatord::Logger()) {}
 
 	void expire() { remove_expired_meters(); }
+	void reclaim() { reclaim_strings(); }
 };
 
 TEST(Registry, Expiration)
 {
 	auto cfg = GetConfiguration();
 	cfg->expiration_frequency = absl::Milliseconds(1);
-	cfg->meter_ttl = absl::Milliseconds(1);
+	// meters take their timestamps from a coarse clock
+	cfg->meter_ttl = absl::Milliseconds(50);
 	ExpRegistry r{std::move(cfg)};
 
 	auto c = r.GetCounter("c");
@@ -150,7 +154,7 @@ TEST(Registry, Expiration)
 	auto my_size = my_meters_size(r);
 	ASSERT_EQ(my_size, 5);
 
-	usleep(2000);  // 2ms
+	usleep(100000);  // 100ms
 	c->Increment();
 	// gauge is tricky because we enforce a min 5s TTL
 	g->Set(1.0);
@@ -159,6 +163,135 @@ TEST(Registry, Expiration)
 	ASSERT_EQ(my_meters_size(r), 2);
 }
 
+TEST(Registry, ExpirationInSlices)
+{
+	auto cfg = GetConfiguration();
+	cfg->meter_ttl = absl::Milliseconds(200);
+	ExpRegistry r{std::move(cfg)};
+
+	// enough meters for each stripe to be scanned in a few slices
+	std::vector<std::shared_ptr<spectator::Counter>> counters;
+	for (auto i = 0; i < 50000; ++i)
+	{
+		counters.emplace_back(r.GetCounter(fmt::format("c.{}", i)));
+	}
+	usleep(300000);  // 300ms
+	for (auto i = 0; i < 50000; i += 2)
+	{
+		counters[i]->Increment();
+	}
+	counters.clear();
+	r.expire();
+	EXPECT_EQ(my_meters_size(r), 25000);
+
+	Tags tags{{"nf.process", "spectatord"}};
+	EXPECT_EQ(r.GetTimer("spectator.expirationScanTime", tags)->Count(), 1);
+	EXPECT_GT(r.GetMaxGauge("spectator.expirationLockTime", tags)->Get(), 0.0);
+	EXPECT_GE(r.GetCounter("spectator.expiredMeters", tags)->Count(), 25000);
+}
+
+TEST(Registry, ExpirationResumesAfterRemovedMeter)
+{
+	spectator::detail::meter_map<spectator::Counter> counters;
+	for (auto i = 0; i < 50000; ++i)
+	{
+		counters.insert(Id::Of(fmt::format("c.{}", i)));
+	}
+	usleep(20000);  // 20ms
+
+	// the meter where each slice stops is removed before the scan resumes from it
+	spectator::detail::expire_stats stats;
+	auto slices = 0;
+	counters.remove_expired(absl::ToInt64Nanoseconds(absl::Milliseconds(1)), &stats, [&](const Id& next) {
+		++slices;
+		counters.remove_one(next);
+	});
+	EXPECT_GT(slices, 0);
+	EXPECT_EQ(counters.size(), 0);
+	EXPECT_EQ(stats.expired + slices, 50000);
+}
+
+TEST(Registry, ReclaimStrings)
+{
+	using spectator::intern_reclaimable_str;
+	auto cfg = GetConfiguration();
+	cfg->meter_ttl = absl::Milliseconds(50);
+	ExpRegistry r{std::move(cfg)};
+	// get rid of strings left behind by other tests
+	r.reclaim();
+	r.reclaim();
+
+	auto name = intern_reclaimable_str("reclaim.counter");
+	Tags live_tags;
+	live_tags.add(intern_reclaimable_str("id"), intern_reclaimable_str("live"));
+	Tags expired_tags;
+	expired_tags.add(intern_reclaimable_str("id"), intern_reclaimable_str("expired"));
+	auto live = r.GetCounter(Id{name, live_tags});
+	r.GetCounter(Id{name, expired_tags});
+
+	usleep(100000);  // 100ms
+	live->Increment();
+	r.expire();
+	ASSERT_EQ(my_counters(r).size(), 1);
+
+	// the strings were interned during this epoch
+	auto before = spectator::string_pool_stats();
+	r.reclaim();
+	EXPECT_EQ(spectator::string_pool_stats().table_size, before.table_size);
+
+	r.reclaim();
+	auto after = spectator::string_pool_stats();
+	EXPECT_EQ(before.table_size - after.table_size, 1);
+	EXPECT_EQ(after.reclaimed - before.reclaimed, 1);
+	EXPECT_EQ(live->MeterId(), Id::Of("reclaim.counter", {{"id", "live"}}));
+}
+
+TEST(Registry, EncodeAfterReclaim)
+{
+	using spectator::intern_reclaimable_str;
+	auto cfg = GetConfiguration();
+	cfg->meter_ttl = absl::Milliseconds(50);
+	ExpRegistry r{std::move(cfg)};
+	r.reclaim();
+	r.reclaim();
+
+	auto counter = r.GetCounter(Id{intern_reclaimable_str("reclaim.publish"), Tags{}});
+	counter->Increment();
+	counter.reset();
+
+	std::string payload;
+	auto before = spectator::string_pool_stats();
+	{
+		// a publish measures the counter, which expires and has its strings reclaimed
+		// before the batch is encoded
+		spectator::StringPool::Pin pin{&spectator::the_str_pool()};
+		std::vector<spectator::MeasurementColumns> batches;
+		r.MeasureBatches(100, [&](spectator::MeasurementColumns&& batch) { batches.push_back(std::move(batch)); });
+		usleep(100000);  // 100ms
+		r.expire();
+		r.reclaim();
+		r.reclaim();
+		EXPECT_EQ(spectator::string_pool_stats().table_size, before.table_size);
+
+		spectator::BatchEncoder encoder{Tags{{"nf.app", "foo"}}};
+		for (const auto& batch : batches)
+		{
+			auto res = encoder.Encode(batch);
+			std::vector<uint8_t> uncompressed(1024 * 1024);
+			auto size = uncompressed.size();
+			ASSERT_EQ(spectator::gzip_uncompress(uncompressed.data(), &size, res.data, res.size), 0);
+			payload.append(reinterpret_cast<const char*>(uncompressed.data()), size);
+		}
+	}
+	EXPECT_NE(payload.find("reclaim.publish"), std::string::npos);
+
+	// once the batches are encoded, the strings can go. Pinned calls don't start a new
+	// epoch, so the first one only does that
+	r.reclaim();
+	r.reclaim();
+	EXPECT_EQ(before.table_size - spectator::string_pool_stats().table_size, 1);
+}
+
 TEST(Registry, Size)
 {
 	Registry r{GetConfiguration(), spectatord::Logger()};
@@ -193,6 +326,38 @@ TEST(Registry, OnMeasurements)
 	ASSERT_TRUE(found);
 }
 
+TEST(Registry, MeasureBatches)
+{
+	Registry r{GetConfiguration(), spectatord::Logger()};
+	for (auto i = 0; i < 25; ++i)
+	{
+		r.GetCounter(fmt::format("counter.{}", i))->Increment();
+	}
+	auto callbacks = 0;
+	r.OnMeasurements([&callbacks](const std::vector<spectator::Measurement>&) { ++callbacks; });
+
+	std::vector<size_t> sizes;
+	auto found = 0;
+	auto on_batch = [&](spectator::MeasurementColumns&& ms)
+	{
+		sizes.push_back(ms.size());
+		for (size_t i = 0; i < ms.size(); ++i)
+		{
+			found += strncmp(ms.Name(i).Get(), "counter.", 8) == 0;
+		}
+	};
+	auto total = r.MeasureBatches(10, on_batch);
+	EXPECT_EQ(found, 25);
+	EXPECT_EQ(total, std::accumulate(sizes.begin(), sizes.end(), size_t{0}));
+	ASSERT_GE(sizes.size(), 3);
+	for (auto i = 0u; i < sizes.size() - 1; ++i)
+	{
+		EXPECT_EQ(sizes[i], 10);
+	}
+	EXPECT_LE(sizes.back(), 10);
+	EXPECT_EQ(callbacks, sizes.size());
+}
+
 TEST(Registry, DistSummary_Size)
 {
 	Registry r{GetConfiguration(), spectatord::Logger()};
@@ -237,4 +402,132 @@ TEST(Registry, DeleteMeters)
 	EXPECT_DOUBLE_EQ(r.AgeGauges().size(), 0.0);
 }
 
+TEST(Registry, OnlyUpdatedMeters)
+{
+	Registry r{GetConfiguration(), spectatord::Logger()};
+	auto c = r.GetCounter("c");
+	auto g = r.GetGauge("g");
+	g->Set(1.0);
+	auto count_named = [&r](const char* name)
+	{
+		auto ms = r.Measurements();
+		return std::count_if(ms.begin(), ms.end(),
+		                     [name](const spectator::Measurement& m) { return strcmp(m.id.Name().Get(), name) == 0; });
+	};
+
+	c->Increment();
+	EXPECT_EQ(count_named("c"), 1);
+	// idle counters are skipped, but gauges are reported every time
+	EXPECT_EQ(count_named("c"), 0);
+	EXPECT_EQ(count_named("g"), 1);
+	c->Add(2.0);
+	EXPECT_EQ(count_named("c"), 1);
+}
+
+TEST(Registry, RemoveUpdatedMeters)
+{
+	auto cfg = GetConfiguration();
+	cfg->meter_ttl = absl::Milliseconds(1);
+	ExpRegistry r{std::move(cfg)};
+
+	// expire a meter while it is in the list of updated meters
+	auto c = r.GetCounter("c");
+	c->Increment();
+	std::weak_ptr<spectator::Counter> removed = c;
+	c.reset();
+	usleep(2000);  // 2ms
+	r.expire();
+	EXPECT_EQ(my_meters_size(r), 0);
+	// the list keeps it alive until it is measured
+	EXPECT_FALSE(removed.expired());
+	auto ms = r.Measurements();
+	EXPECT_TRUE(std::none_of(ms.begin(), ms.end(),
+	                         [](const spectator::Measurement& m) { return strcmp(m.id.Name().Get(), "c") == 0; }));
+	EXPECT_TRUE(removed.expired());
+
+	// updates to a removed meter are not reported
+	auto t = r.GetTimer("t");
+	r.Measurements();
+	usleep(2000);
+	r.expire();
+	t->Record(std::chrono::seconds{1});
+	ms = r.Measurements();
+	EXPECT_TRUE(std::none_of(ms.begin(), ms.end(),
+	                         [](const spectator::Measurement& m) { return strcmp(m.id.Name().Get(), "t") == 0; }));
+}
+
+TEST(Registry, UpdateAfterRegistryDestroyed)
+{
+	std::shared_ptr<spectator::Counter> idle;
+	std::shared_ptr<spectator::Counter> measured;
+	std::shared_ptr<spectator::Timer> updated;
+	auto r = std::make_unique<Registry>(GetConfiguration(), spectatord::Logger());
+	idle = r->GetCounter("idle");
+	measured = r->GetCounter("measured");
+	measured->Increment();
+	r->Measurements();
+	// still in the list of updated meters when the registry goes away
+	updated = r->GetTimer("updated");
+	updated->Record(std::chrono::seconds{1});
+	r.reset();
+
+	// users can keep updating meters they hold on to
+	for (auto i = 0; i < 2; ++i)
+	{
+		idle->Increment();
+		measured->Increment();
+		updated->Record(std::chrono::seconds{1});
+	}
+	EXPECT_TRUE(idle->IsRemoved());
+	EXPECT_EQ(idle->Count(), 2);
+	EXPECT_EQ(updated->Count(), 3);
+}
+
+TEST(Registry, ConcurrentUpdates)
+{
+	Registry r{GetConfiguration(), spectatord::Logger()};
+	constexpr auto kThreads = 4;
+	constexpr auto kIncrements = 20000;
+	constexpr auto kCounters = 64;
+
+	auto total = 0.0;
+	auto add_counts = [&total](spectator::MeasurementColumns&& ms)
+	{
+		for (size_t i = 0; i < ms.size(); ++i)
+		{
+			if (strncmp(ms.Name(i).Get(), "c.", 2) == 0)
+			{
+				total += ms.Value(i);
+			}
+		}
+	};
+
+	std::atomic_int running{kThreads};
+	std::vector<std::thread> threads;
+	for (auto i = 0; i < kThreads; ++i)
+	{
+		threads.emplace_back(
+		    [&r, &running, i]()
+		    {
+			    for (auto j = 0; j < kIncrements; ++j)
+			    {
+				    r.GetCounter(fmt::format("c.{}", (i + j) % kCounters))->Increment();
+			    }
+			    --running;
+		    });
+	}
+	while (running > 0)
+	{
+		r.MeasureBatches(100, add_counts);
+	}
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+	r.MeasureBatches(100, add_counts);
+
+	// no increments are lost or reported twice
+	EXPECT_DOUBLE_EQ(total, kThreads * kIncrements);
+}
+
 }  // namespace
@@ -1,4 +1,5 @@
 #include "smile.h"
+
 namespace spectator
 {
 
@@ -29,43 +30,68 @@ void SmilePayload::Append(int n)
 }
 
 void SmilePayload::Append(size_t n)
+{
+	auto* p = buffer_.Reserve(kMaxIntSize);
+	buffer_.Commit(EncodeInt(p, n));
+}
+
+void SmilePayload::Append(double value)
+{
+	auto* p = buffer_.Reserve(kDoubleSize);
+	buffer_.Commit(EncodeDouble(p, value));
+}
+
+auto SmilePayload::EncodeInt(uint8_t* p, size_t n) -> uint8_t*
 {
 	auto i = zigzagEncode(n);
 	if (i <= 0x3F)
 	{
 		if (i <= 0x1F)
 		{  // tiny
-			buffer_.Append(static_cast<uint8_t>(kTokenPrefixSmallInt + i));
-			return;
+			*p++ = static_cast<uint8_t>(kTokenPrefixSmallInt + i);
+			return p;
 		}
 		// not tiny, just small
-		buffer_.Append(kByteInt32, static_cast<uint8_t>(0x80 + i));
-		return;
+		*p++ = kByteInt32;
+		*p++ = static_cast<uint8_t>(0x80 + i);
+		return p;
 	}
 	auto b0 = static_cast<uint8_t>(0x80 + (i & 0x3FU));
 	i >>= 6U;
+	*p++ = kByteInt32;
 	if (i <= 0x7F)
 	{  // 13 bits is enough (== 3 bytes total encoding)
-		buffer_.Append(kByteInt32, static_cast<uint8_t>(i), b0);
-		return;
+		*p++ = static_cast<uint8_t>(i);
+		*p++ = b0;
+		return p;
 	}
 	auto b1 = static_cast<uint8_t>(i & 0x7FU);
 	i >>= 7U;
 	if (i <= 0x7F)
 	{
-		buffer_.Append(kByteInt32, static_cast<uint8_t>(i), b1, b0);
-		return;
+		*p++ = static_cast<uint8_t>(i);
+		*p++ = b1;
+		*p++ = b0;
+		return p;
 	}
 	auto b2 = static_cast<uint8_t>(i & 0x7FU);
 	i >>= 7U;
 	if (i <= 0x7F)
 	{
-		buffer_.Append(kTokenInt32, static_cast<uint8_t>(i), b2, b1, b0);
-		return;
+		*p++ = static_cast<uint8_t>(i);
+		*p++ = b2;
+		*p++ = b1;
+		*p++ = b0;
+		return p;
 	}
 	// no, need all 5 bytes
 	auto b3 = static_cast<uint8_t>(i & 0x7FU);
-	buffer_.Append(kByteInt32, static_cast<uint8_t>(i >> 7U), b3, b2, b1, b0);
+	*p++ = static_cast<uint8_t>(i >> 7U);
+	*p++ = b3;
+	*p++ = b2;
+	*p++ = b1;
+	*p++ = b0;
+	return p;
 }
 
 union LongDouble
@@ -74,41 +100,38 @@ union LongDouble
 	uint64_t l;
 };
 
-void SmilePayload::Append(double value)
+auto SmilePayload::EncodeDouble(uint8_t* p, double value) -> uint8_t*
 {
-	buffer_.Append(kByteFloat64);
+	*p++ = kByteFloat64;
 	LongDouble ld{value};
 	auto l = ld.l;
 
 	// Handle first 29 bits (single bit first, then 4 x 7 bits)
 	auto hi5 = static_cast<uint32_t>(l >> 35U);
-	auto b4 = static_cast<uint8_t>(hi5 & 0x7FU);
+	p[4] = static_cast<uint8_t>(hi5 & 0x7FU);
 	hi5 >>= 7U;
-	auto b3 = static_cast<uint8_t>(hi5 & 0x7FU);
+	p[3] = static_cast<uint8_t>(hi5 & 0x7FU);
 	hi5 >>= 7U;
-	auto b2 = static_cast<uint8_t>(hi5 & 0x7FU);
+	p[2] = static_cast<uint8_t>(hi5 & 0x7FU);
 	hi5 >>= 7U;
-	auto b1 = static_cast<uint8_t>(hi5 & 0x7FU);
+	p[1] = static_cast<uint8_t>(hi5 & 0x7FU);
 	hi5 >>= 7U;
-	auto b0 = static_cast<uint8_t>(hi5);
-	buffer_.Append(b0, b1, b2, b3, b4);
+	p[0] = static_cast<uint8_t>(hi5);
 
 	// Then split byte (one that crosses lo/hi int boundary), 7 bits
-	{
-		auto mid = static_cast<uint32_t>(l >> 28U);
-		buffer_.Append(static_cast<uint8_t>(mid & 0x7FU));
-	}
+	auto mid = static_cast<uint32_t>(l >> 28U);
+	p[5] = static_cast<uint8_t>(mid & 0x7FU);
 
 	// and then last 4 bytes (28 bits)
 	auto lo4 = static_cast<uint32_t>(l);
-	b3 = static_cast<uint8_t>(lo4 & 0x7FU);
+	p[9] = static_cast<uint8_t>(lo4 & 0x7FU);
 	lo4 >>= 7U;
-	b2 = static_cast<uint8_t>(lo4 & 0x7FU);
+	p[8] = static_cast<uint8_t>(lo4 & 0x7FU);
 	lo4 >>= 7U;
-	b1 = static_cast<uint8_t>(lo4 & 0x7FU);
+	p[7] = static_cast<uint8_t>(lo4 & 0x7FU);
 	lo4 >>= 7U;
-	b0 = static_cast<uint8_t>(lo4 & 0x7FU);
-	buffer_.Append(b0, b1, b2, b3);
+	p[6] = static_cast<uint8_t>(lo4 & 0x7FU);
+	return p + 10;
 }
 
 void SmilePayload::Append(std::string_view s)
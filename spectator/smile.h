@@ -11,6 +11,12 @@ namespace spectator
 class SmilePayload
 {
    public:
+	explicit SmilePayload(Codec codec = Codec::Gzip, Executor executor = {})
+	    : buffer_{CompressedBuffer::kDefaultChunkSizeInput, CompressedBuffer::kDefaultOutSize,
+	              CompressedBuffer::kDefaultChunkSizeOutput, codec, std::move(executor)}
+	{
+	}
+
 	void Init()
 	{
 		buffer_.Init();
@@ -27,6 +33,20 @@ class SmilePayload
 		return buffer_.Result();
 	}
 
+	// Encoding a record with many values can reserve room for all of them at once,
+	// write them with the functions below, and then Commit the end of the record.
+	static constexpr size_t kMaxIntSize = 6;
+	static constexpr size_t kDoubleSize = 11;
+	static constexpr size_t kMaxReserve = CompressedBuffer::kMaxReserve;
+	auto Reserve(size_t n) -> uint8_t* { return buffer_.Reserve(n); }
+	void Commit(const uint8_t* end) { buffer_.Commit(end); }
+	// bytes produced by the functions below
+	void AppendEncoded(std::string_view bytes) { buffer_.Append(bytes); }
+
+	// write the value at p, and return the end of what was written
+	static auto EncodeInt(uint8_t* p, size_t n) -> uint8_t*;
+	static auto EncodeDouble(uint8_t* p, double value) -> uint8_t*;
+
    private:
 	CompressedBuffer buffer_;
 
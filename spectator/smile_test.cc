@@ -40,4 +40,18 @@ TEST(SmilePayload, Encode)
 	    0x61, 0x61, 0x61, 0xFC, 0x29, 0x0,  0x40, 0x22, 0x4D, 0x38, 0x28, 0x7A, 0x70, 0x51, 0x76, 0xF9};
 	EXPECT_TRUE(memcmp(expected.data(), uncompressed, res.size) == 0);
 }
-}  // namespace
\ No newline at end of file
+
+TEST(SmilePayload, EncodeInt)
+{
+	uint8_t buf[SmilePayload::kMaxIntSize];
+	auto encode = [&buf](size_t n) { return std::vector<uint8_t>(buf, SmilePayload::EncodeInt(buf, n)); };
+
+	EXPECT_EQ(encode(0), std::vector<uint8_t>({0xC0}));
+	EXPECT_EQ(encode(15), std::vector<uint8_t>({0xDE}));
+	EXPECT_EQ(encode(16), std::vector<uint8_t>({0x24, 0xA0}));
+	EXPECT_EQ(encode(1000), std::vector<uint8_t>({0x24, 0x1F, 0x90}));
+	EXPECT_EQ(encode(100000), std::vector<uint8_t>({0x24, 0x18, 0x35, 0x80}));
+	EXPECT_EQ(encode(size_t{1} << 20), std::vector<uint8_t>({0x24, 0x02, 0x00, 0x00, 0x80}));
+	EXPECT_EQ(encode(size_t{1} << 30), std::vector<uint8_t>({0x24, 0x10, 0x00, 0x00, 0x00, 0x80}));
+}
+}  // namespace
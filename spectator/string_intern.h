@@ -11,10 +11,14 @@ class StringPool;
 
 struct StringPoolStats
 {
-	size_t alloc_size;
+	size_t alloc_size;  // bytes used by the interned strings, including their null terminators
+	size_t arena_size;  // bytes reserved for them, the difference is the allocation overhead
 	size_t table_size;
 	uint64_t hits;
 	uint64_t misses;
+	uint64_t cache_hits;    // lookups served by the per-thread caches, without touching the pool
+	uint64_t cache_misses;  // lookups the per-thread caches had to forward to the pool
+	uint64_t reclaimed;     // strings freed because nothing was using them anymore
 };
 
 class StrRef
@@ -38,6 +42,9 @@ class StrRef
 auto intern_str(const char* string) -> StrRef;
 auto intern_str(const std::string& string) -> StrRef;
 auto intern_str(std::string_view string) -> StrRef;
+// intern a string that can be freed once no meter in the registry uses it, used
+// for the names and tags coming from clients. See StringPool
+auto intern_reclaimable_str(std::string_view string) -> StrRef;
 auto string_pool_stats() -> StringPoolStats;
 
 }  // namespace spectator
@@ -1,10 +1,12 @@
-#include "string_intern.h"
+#include "string_pool.h"
 #include <gtest/gtest.h>
 #include <fmt/format.h>
+#include <thread>
 
 namespace
 {
 
+using spectator::intern_reclaimable_str;
 using spectator::intern_str;
 using spectator::StrRef;
 
@@ -47,4 +49,76 @@ TEST(StringIntern, Hash)
 	std::string s("hash2");
 	EXPECT_EQ(std::hash<spectator::StrRef>{}(intern_str(s)), h3);
 }
-}  // namespace
\ No newline at end of file
+
+TEST(StringIntern, ThreadCache)
+{
+	auto before = spectator::string_pool_stats();
+	StrRef first;
+	StrRef second;
+	std::thread t{[&]()
+	              {
+		              first = intern_str("thread-cache");
+		              second = intern_str(std::string("thread-cache"));
+	              }};
+	t.join();
+	EXPECT_EQ(first, second);
+
+	// the counters of a thread that is gone are kept
+	auto after = spectator::string_pool_stats();
+	EXPECT_EQ(after.cache_hits - before.cache_hits, 1);
+	EXPECT_EQ(after.cache_misses - before.cache_misses, 1);
+	EXPECT_EQ(first, intern_str("thread-cache"));
+}
+
+TEST(StringIntern, ThreadCacheInvalidChars)
+{
+	auto before = spectator::string_pool_stats();
+	StrRef first;
+	StrRef second;
+	std::thread t{[&]()
+	              {
+		              first = intern_str("thread@cache");
+		              second = intern_str("thread@cache");
+	              }};
+	t.join();
+
+	// strings that had to be rewritten are not cached, the pool handles them
+	EXPECT_STREQ(first.Get(), "thread_cache");
+	EXPECT_EQ(first, second);
+	auto after = spectator::string_pool_stats();
+	EXPECT_EQ(after.cache_hits - before.cache_hits, 0);
+	EXPECT_EQ(after.cache_misses - before.cache_misses, 2);
+}
+TEST(StringIntern, ReclaimThreadCache)
+{
+	auto& pool = spectator::the_str_pool();
+	auto ref = intern_reclaimable_str("reclaim-me");
+	EXPECT_EQ(intern_reclaimable_str("reclaim-me"), ref);
+	pool.Reclaim({});
+	pool.Reclaim({});
+
+	// the cached entry is from an older epoch, so the string has to be interned again
+	auto before = spectator::string_pool_stats();
+	EXPECT_STREQ(intern_reclaimable_str("reclaim-me").Get(), "reclaim-me");
+	auto after = spectator::string_pool_stats();
+	EXPECT_EQ(after.cache_hits - before.cache_hits, 0);
+	EXPECT_EQ(after.misses - before.misses, 1);
+}
+
+TEST(StringIntern, KeepReclaimable)
+{
+	auto& pool = spectator::the_str_pool();
+	auto ref = intern_reclaimable_str("keep-me");
+
+	// the cached entry can't be used, the pool has to know the string is kept
+	auto before = spectator::string_pool_stats();
+	EXPECT_EQ(intern_str("keep-me"), ref);
+	auto after = spectator::string_pool_stats();
+	EXPECT_EQ(after.cache_misses - before.cache_misses, 1);
+
+	pool.Reclaim({});
+	pool.Reclaim({});
+	EXPECT_EQ(intern_reclaimable_str("keep-me"), ref);
+	EXPECT_EQ(intern_str("keep-me"), ref);
+}
+}  // namespace
@@ -1,54 +1,175 @@
 #include "string_pool.h"
 #include "valid_chars.inc"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
 
 namespace spectator
 {
 
 #include "valid_chars.inc"
 
-auto StringPool::Intern(const char* string, size_t len) noexcept -> StrRef
+// aligned_alloc wants the size to be a multiple of the alignment
+static constexpr auto round_to_page(size_t size) -> size_t
 {
-	absl::MutexLock lock(&table_mutex_);
-	String s{string, len};
-	auto it = table_.find(s);
-	if (it != table_.end())
+	return (size + StringArena::kPageSize - 1) & ~(StringArena::kPageSize - 1);
+}
+
+auto StringArena::new_chunk(size_t size) -> char*
+{
+	auto chunk_size = round_to_page(size);
+	auto* chunk = static_cast<char*>(std::aligned_alloc(kPageSize, chunk_size));
+	if (chunk == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	chunks_.push_back(chunk);
+	reserved_ += chunk_size;
+	return chunk;
+}
+
+auto StringArena::Allocate(size_t size) -> char*
+{
+	if (size > kMaxSharedSize)
 	{
-		stats_.hits++;
-		return it->second;
+		return new_chunk(size);
 	}
-	auto* copy = static_cast<char*>(malloc(len + 1));
-	for (auto i = 0u; i < len; ++i)
+	if (size < free_lists_.size() && free_lists_[size] != nullptr)
 	{
-		auto ch = static_cast<uint_fast8_t>(string[i]);
-		copy[i] = kAtlasChars[ch];
+		// the next block in the list is stored in the first bytes of the free block
+		auto* result = free_lists_[size];
+		std::memcpy(&free_lists_[size], result, sizeof(char*));
+		return result;
 	}
-	copy[len] = '\0';
+	if (size > available_)
+	{
+		cur_ = new_chunk(kChunkSize);
+		available_ = kChunkSize;
+	}
+	auto* result = cur_;
+	cur_ += size;
+	available_ -= size;
+	return result;
+}
 
-	StrRef ref{copy};
-	s.s = copy;
-	auto added = table_.insert({s, ref});
-	if (added.second)
+void StringArena::Free(char* ptr, size_t size) noexcept
+{
+	if (size > kMaxSharedSize)
+	{
+		free(ptr);
+		chunks_.erase(std::find(chunks_.begin(), chunks_.end(), ptr));
+		reserved_ -= round_to_page(size);
+		return;
+	}
+	if (ptr + size == cur_)
 	{
-		stats_.alloc_size += len + 1;  // null terminator
-		stats_.misses++;
-		stats_.table_size++;
+		cur_ = ptr;
+		available_ += size;
+		return;
 	}
-	else
+	if (size < sizeof(char*))
 	{
-		// it's a cache hit (invalid chars made the first lookup fail)
-		stats_.hits++;
-		free(copy);
+		return;
 	}
-	return added.first->second;
+	if (free_lists_.empty())
+	{
+		free_lists_.resize(kMaxSharedSize + 1);
+	}
+	std::memcpy(ptr, &free_lists_[size], sizeof(char*));
+	free_lists_[size] = ptr;
 }
 
-StringPool::~StringPool()
+StringArena::~StringArena()
+{
+	for (auto* chunk : chunks_)
+	{
+		free(chunk);
+	}
+}
+
+static constexpr auto reclaimable_size(size_t len) -> size_t
+{
+	return (len + sizeof(char*)) & ~(sizeof(char*) - 1);  // len + 1 rounded up
+}
+
+auto StringPool::Lookup(const char* string, size_t len, bool reclaimable) noexcept -> Entry
+{
+	absl::MutexLock lock(&table_mutex_);
+	auto epoch = epoch_.load(std::memory_order_relaxed);
+	auto it = table_.find(String{string, len});
+	if (it == table_.end())
+	{
+		auto& arena = reclaimable ? reclaimable_arena_ : arena_;
+		auto size = reclaimable ? reclaimable_size(len) : len + 1;
+		auto* copy = arena.Allocate(size);
+		for (auto i = 0u; i < len; ++i)
+		{
+			auto ch = static_cast<uint_fast8_t>(string[i]);
+			copy[i] = kAtlasChars[ch];
+		}
+		copy[len] = '\0';
+
+		// strings with invalid chars are stored after replacing them, so the
+		// fixed version might be in the table already
+		if (std::memcmp(copy, string, len) != 0)
+		{
+			it = table_.find(String{copy, len});
+		}
+		if (it == table_.end())
+		{
+			stats_.alloc_size += len + 1;  // null terminator
+			stats_.misses++;
+			stats_.table_size++;
+			Entry entry{StrRef{copy}, epoch, reclaimable};
+			table_.insert({String{copy, len}, entry});
+			return entry;
+		}
+		arena.Free(copy, size);
+	}
+
+	stats_.hits++;
+	auto& entry = it.value();
+	entry.epoch = epoch;
+	// once something interns a string to keep it, it can't be freed
+	entry.reclaimable = entry.reclaimable && reclaimable;
+	return entry;
+}
+
+auto StringPool::Reclaim(const StrRefSet& live) noexcept -> size_t
 {
 	absl::MutexLock lock(&table_mutex_);
-	for (const auto& kv : table_)
+	// a pin taken after this check only protects strings of meters that were in the
+	// live set, or were interned since, neither of which this call frees
+	if (pins_.load() > 0)
 	{
-		free(const_cast<char*>(kv.first.s));
+		return 0;
 	}
+	auto epoch = epoch_.load(std::memory_order_relaxed);
+	auto freed = size_t{0};
+	auto it = table_.begin();
+	while (it != table_.end())
+	{
+		const auto& entry = it->second;
+		if (entry.reclaimable && entry.epoch < epoch && !live.contains(entry.ref))
+		{
+			auto len = it->first.len;
+			reclaimable_arena_.Free(const_cast<char*>(it->first.s), reclaimable_size(len));
+			stats_.alloc_size -= len + 1;
+			stats_.table_size--;
+			it = table_.erase(it);
+			++freed;
+		}
+		else
+		{
+			++it;
+		}
+	}
+	stats_.reclaimed += freed;
+	epoch_.store(epoch + 1, std::memory_order_release);
+	return freed;
 }
 
 auto the_str_pool() noexcept -> StringPool&
@@ -57,12 +178,135 @@ auto the_str_pool() noexcept -> StringPool&
 	return *the_pool;
 }
 
-auto intern_str(const char* string) -> StrRef { return the_str_pool().Intern(string); }
+namespace
+{
 
-auto intern_str(const std::string& string) -> StrRef { return the_str_pool().Intern(string.c_str(), string.length()); }
+class InternCache;
 
-auto intern_str(std::string_view string) -> StrRef { return the_str_pool().Intern(string.data(), string.length()); }
+// Keeps track of the live per-thread caches so their counters can be added to the
+// pool stats, and keeps the counters of the caches whose threads are gone
+class InternCaches
+{
+   public:
+	void Add(const InternCache* cache) noexcept
+	{
+		absl::MutexLock lock(&mutex_);
+		caches_.push_back(cache);
+	}
+
+	void Remove(const InternCache* cache, uint64_t hits, uint64_t misses) noexcept
+	{
+		absl::MutexLock lock(&mutex_);
+		caches_.erase(std::remove(caches_.begin(), caches_.end(), cache), caches_.end());
+		retired_hits_ += hits;
+		retired_misses_ += misses;
+	}
+
+	void AddStats(StringPoolStats* stats) noexcept;
+
+   private:
+	absl::Mutex mutex_;
+	std::vector<const InternCache*> caches_ ABSL_GUARDED_BY(mutex_);
+	uint64_t retired_hits_ ABSL_GUARDED_BY(mutex_){0};
+	uint64_t retired_misses_ ABSL_GUARDED_BY(mutex_){0};
+};
+
+auto the_intern_caches() noexcept -> InternCaches&
+{
+	static auto* the_caches = new InternCaches();
+	return *the_caches;
+}
+
+// A small direct-mapped cache in front of the global pool, so each ingest thread can
+// intern the names and tags it sees over and over without taking the pool mutex.
+// Only strings that were valid to begin with are cached, which lets a hit be verified
+// by comparing the bytes against the interned copy. Entries are only used during the
+// pool epoch in which they were looked up, since reclaimed strings are freed when a
+// new epoch starts.
+class InternCache
+{
+   public:
+	InternCache() noexcept { the_intern_caches().Add(this); }
+	~InternCache() { the_intern_caches().Remove(this, Hits(), Misses()); }
+	InternCache(const InternCache&) = delete;
+	auto operator=(const InternCache&) -> InternCache& = delete;
+
+	auto Intern(const char* string, size_t len, bool reclaimable) noexcept -> StrRef
+	{
+		auto& pool = the_str_pool();
+		auto hash = XXH3_64bits(string, len);
+		auto& entry = entries_[hash & (kEntries - 1)];
+		if (entry.hash == hash && entry.len == len && entry.epoch == pool.Epoch() && entry.ref.Get() != nullptr &&
+		    (reclaimable || !entry.reclaimable) && std::memcmp(entry.ref.Get(), string, len) == 0)
+		{
+			// only this thread writes the counters, no need for a read-modify-write
+			hits_.store(hits_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return entry.ref;
+		}
+
+		misses_.store(misses_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		auto pool_entry = pool.Lookup(string, len, reclaimable);
+		if (std::memcmp(pool_entry.ref.Get(), string, len) == 0)
+		{
+			entry = Entry{hash, len, pool_entry.ref, pool_entry.epoch, pool_entry.reclaimable};
+		}
+		return pool_entry.ref;
+	}
+
+	[[nodiscard]] auto Hits() const noexcept -> uint64_t { return hits_.load(std::memory_order_relaxed); }
+	[[nodiscard]] auto Misses() const noexcept -> uint64_t { return misses_.load(std::memory_order_relaxed); }
+
+   private:
+	static constexpr size_t kEntries = 2048;  // must be a power of 2
+	struct Entry
+	{
+		uint64_t hash;
+		size_t len;
+		StrRef ref;
+		uint32_t epoch;
+		bool reclaimable;
+	};
+	std::array<Entry, kEntries> entries_{};
+	std::atomic<uint64_t> hits_{0};
+	std::atomic<uint64_t> misses_{0};
+};
+
+void InternCaches::AddStats(StringPoolStats* stats) noexcept
+{
+	absl::MutexLock lock(&mutex_);
+	stats->cache_hits = retired_hits_;
+	stats->cache_misses = retired_misses_;
+	for (const auto* cache : caches_)
+	{
+		stats->cache_hits += cache->Hits();
+		stats->cache_misses += cache->Misses();
+	}
+}
+
+auto intern_cached(const char* string, size_t len, bool reclaimable) noexcept -> StrRef
+{
+	thread_local InternCache cache;
+	return cache.Intern(string, len, reclaimable);
+}
 
-auto string_pool_stats() -> StringPoolStats { return the_str_pool().Stats(); }
+}  // namespace
+
+auto intern_str(const char* string) -> StrRef { return intern_cached(string, std::strlen(string), false); }
+
+auto intern_str(const std::string& string) -> StrRef { return intern_cached(string.c_str(), string.length(), false); }
+
+auto intern_str(std::string_view string) -> StrRef { return intern_cached(string.data(), string.length(), false); }
+
+auto intern_reclaimable_str(std::string_view string) -> StrRef
+{
+	return intern_cached(string.data(), string.length(), true);
+}
+
+auto string_pool_stats() -> StringPoolStats
+{
+	auto stats = the_str_pool().Stats();
+	the_intern_caches().AddStats(&stats);
+	return stats;
+}
 
 }  // namespace spectator
@@ -4,7 +4,10 @@
 #include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
 #include "tsl/hopscotch_map.h"
+#include "tsl/hopscotch_set.h"
 #include "xxh3.h"
+#include <atomic>
+#include <vector>
 
 namespace spectator
 {
@@ -29,32 +32,124 @@ struct StringComparer
 	}
 };
 
+// Hands out the memory for the interned strings, carving them out of large page aligned
+// chunks instead of doing a malloc per string. Strings are packed back to back, and the
+// memory given back with Free is kept in a free list per size to be reused by strings
+// of the same size. Not thread safe.
+class StringArena
+{
+   public:
+	static constexpr size_t kPageSize = 4096;
+	static constexpr size_t kChunkSize = 64 * 1024;
+	// strings bigger than this get a chunk of their own instead of wasting
+	// what's left of the current one
+	static constexpr size_t kMaxSharedSize = kChunkSize / 8;
+
+	StringArena() = default;
+	~StringArena();
+	StringArena(const StringArena&) = delete;
+	auto operator=(const StringArena&) -> StringArena& = delete;
+
+	auto Allocate(size_t size) -> char*;
+
+	// give back memory from Allocate. Only blocks of at least the size of a
+	// pointer can be reused, unless it is the last block that was allocated
+	void Free(char* ptr, size_t size) noexcept;
+
+	// bytes reserved from the system, including the unused tails of the chunks
+	[[nodiscard]] auto Reserved() const noexcept -> size_t { return reserved_; }
+
+   private:
+	auto new_chunk(size_t size) -> char*;
+
+	std::vector<char*> chunks_;
+	std::vector<char*> free_lists_;  // indexed by size, created on the first Free
+	char* cur_{nullptr};
+	size_t available_{0};
+	size_t reserved_{0};
+};
+
+using StrRefSet = tsl::hopscotch_set<StrRef>;
+
 // A String Pool used for interning Atlas tags
 // This class will enforce the atlas charset restrictions
 // by setting invalid chars to _
+//
+// Strings are kept forever, unless they are interned with InternReclaimable and
+// never with Intern. Those can be freed by Reclaim once nothing uses them. Each
+// call to Reclaim starts a new epoch, and it only frees strings that were not
+// interned during the epoch that is ending, so a StrRef that was just handed out
+// survives the next call to Reclaim, giving its user a whole period between calls
+// to store it somewhere the live set is built from. Strings copied out of meters,
+// like the measurements being encoded by the publisher, are protected with a Pin.
 class StringPool
 {
    public:
 	StringPool() = default;
-	~StringPool();
+	~StringPool() = default;
 	StringPool(const StringPool&) = delete;
 	auto operator=(const StringPool&) -> StringPool& = delete;
 
 	auto Intern(const char* string) noexcept -> StrRef { return Intern(string, std::strlen(string)); };
 
-	auto Intern(const char* string, size_t len) noexcept -> StrRef;
+	auto Intern(const char* string, size_t len) noexcept -> StrRef { return Lookup(string, len, false).ref; }
+
+	auto InternReclaimable(const char* string, size_t len) noexcept -> StrRef { return Lookup(string, len, true).ref; }
+
+	struct Entry
+	{
+		StrRef ref;
+		uint32_t epoch;  // the last epoch in which the string was interned
+		bool reclaimable;
+	};
+
+	// intern a string, returning its entry in the table
+	auto Lookup(const char* string, size_t len, bool reclaimable) noexcept -> Entry;
+
+	// free the reclaimable strings that are not in the live set, and
+	// have not been interned since the last call. Returns the number
+	// of strings that were freed, which is 0 while the pool is pinned
+	auto Reclaim(const StrRefSet& live) noexcept -> size_t;
+
+	// Keeps Reclaim from freeing any string while it is held. Measurements can outlive
+	// the meters they were taken from, and the live set only has the strings of the
+	// meters in the registry, so the publisher holds one until its batches are encoded
+	class Pin
+	{
+	   public:
+		explicit Pin(StringPool* pool) noexcept : pool_{pool} { pool_->pins_.fetch_add(1); }
+		~Pin() { pool_->pins_.fetch_sub(1); }
+		Pin(const Pin&) = delete;
+		auto operator=(const Pin&) -> Pin& = delete;
+
+	   private:
+		StringPool* pool_;
+	};
+
+	[[nodiscard]] auto Epoch() const noexcept -> uint32_t { return epoch_.load(std::memory_order_acquire); }
 
 	auto Stats() noexcept -> StringPoolStats
 	{
 		absl::MutexLock lock(&table_mutex_);
-		return stats_;
+		auto stats = stats_;
+		stats.arena_size = arena_.Reserved() + reclaimable_arena_.Reserved();
+		return stats;
 	}
 
    private:
 	absl::Mutex table_mutex_;
-	using table_t = tsl::hopscotch_map<String, StrRef, StringHasher, StringComparer>;
+	using table_t = tsl::hopscotch_map<String, Entry, StringHasher, StringComparer>;
 	table_t table_ ABSL_GUARDED_BY(table_mutex_);
+	StringArena arena_ ABSL_GUARDED_BY(table_mutex_);
+	// reclaimable strings are rounded up to a multiple of the pointer size,
+	// so the space they leave behind can be reused by similar strings
+	StringArena reclaimable_arena_ ABSL_GUARDED_BY(table_mutex_);
 	StringPoolStats stats_ ABSL_GUARDED_BY(table_mutex_){};
+	std::atomic<uint32_t> epoch_{0};
+	std::atomic<int> pins_{0};
 };
 
+// the global pool used by intern_str
+auto the_str_pool() noexcept -> StringPool&;
+
 }  // namespace spectator
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "string_pool.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using spectator::StringArena;
+using spectator::StringPool;
+
+TEST(StringArena, Packed)
+{
+	StringArena arena;
+	EXPECT_EQ(arena.Reserved(), 0);
+
+	auto* a = arena.Allocate(4);
+	auto* b = arena.Allocate(10);
+	EXPECT_EQ(b, a + 4);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(a) % StringArena::kPageSize, 0);
+	EXPECT_EQ(arena.Reserved(), StringArena::kChunkSize);
+
+	arena.Free(b, 10);
+	EXPECT_EQ(arena.Allocate(2), b);
+}
+
+TEST(StringArena, FreeList)
+{
+	StringArena arena;
+	auto* a = arena.Allocate(16);
+	auto* b = arena.Allocate(16);
+	auto* c = arena.Allocate(24);
+	arena.Allocate(8);
+
+	arena.Free(a, 16);
+	arena.Free(c, 24);
+	arena.Free(b, 16);
+	EXPECT_EQ(arena.Allocate(16), b);
+	EXPECT_EQ(arena.Allocate(16), a);
+	EXPECT_EQ(arena.Allocate(24), c);
+	EXPECT_EQ(arena.Reserved(), StringArena::kChunkSize);
+}
+
+TEST(StringArena, NewChunk)
+{
+	StringArena arena;
+	for (auto i = 0u; i < StringArena::kChunkSize / StringArena::kMaxSharedSize; ++i)
+	{
+		arena.Allocate(StringArena::kMaxSharedSize);
+	}
+	EXPECT_EQ(arena.Reserved(), StringArena::kChunkSize);
+
+	// the first chunk is full
+	auto* b = arena.Allocate(1);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(b) % StringArena::kPageSize, 0);
+	EXPECT_EQ(arena.Reserved(), 2 * StringArena::kChunkSize);
+}
+
+TEST(StringArena, Big)
+{
+	StringArena arena;
+	auto* a = arena.Allocate(1);
+	auto* big = arena.Allocate(StringArena::kChunkSize + 1);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(big) % StringArena::kPageSize, 0);
+	EXPECT_EQ(arena.Reserved(), 2 * StringArena::kChunkSize + StringArena::kPageSize);
+
+	// big strings do not take the space left in the current chunk
+	EXPECT_EQ(arena.Allocate(1), a + 1);
+
+	arena.Free(big, StringArena::kChunkSize + 1);
+	EXPECT_EQ(arena.Reserved(), StringArena::kChunkSize);
+}
+
+TEST(StringPool, Stats)
+{
+	StringPool pool;
+	auto foo = pool.Intern("foo");
+	auto bar = pool.Intern("bar");
+	EXPECT_EQ(pool.Intern("foo"), foo);
+	EXPECT_EQ(bar.Get(), foo.Get() + 4);
+
+	auto stats = pool.Stats();
+	EXPECT_EQ(stats.table_size, 2);
+	EXPECT_EQ(stats.alloc_size, 8);
+	EXPECT_EQ(stats.arena_size, StringArena::kChunkSize);
+	EXPECT_EQ(stats.hits, 1);
+	EXPECT_EQ(stats.misses, 2);
+}
+
+TEST(StringPool, InvalidChars)
+{
+	StringPool pool;
+	auto valid = pool.Intern("foo_bar");
+	EXPECT_EQ(pool.Intern("foo@bar"), valid);
+	EXPECT_EQ(pool.Intern("foo#bar"), valid);
+
+	// the fixed copies were given back to the arena
+	auto baz = pool.Intern("baz");
+	EXPECT_EQ(baz.Get(), valid.Get() + 8);
+
+	auto stats = pool.Stats();
+	EXPECT_EQ(stats.table_size, 2);
+	EXPECT_EQ(stats.alloc_size, 12);
+	EXPECT_EQ(stats.hits, 2);
+	EXPECT_EQ(stats.misses, 2);
+}
+
+TEST(StringPool, Reclaim)
+{
+	StringPool pool;
+	auto live = pool.InternReclaimable("live", 4);
+	auto dead = pool.InternReclaimable("dead", 4);
+	auto kept = pool.InternReclaimable("kept", 4);
+	EXPECT_EQ(pool.Intern("kept"), kept);
+	pool.Intern("forever");
+
+	// strings interned during the current epoch are not freed
+	spectator::StrRefSet live_set{live};
+	EXPECT_EQ(pool.Reclaim(live_set), 0);
+	EXPECT_EQ(pool.Epoch(), 1);
+
+	EXPECT_EQ(pool.Reclaim(live_set), 1);
+	EXPECT_STREQ(live.Get(), "live");
+	EXPECT_STREQ(kept.Get(), "kept");
+	auto stats = pool.Stats();
+	EXPECT_EQ(stats.table_size, 3);
+	EXPECT_EQ(stats.alloc_size, 5 + 5 + 8);
+	EXPECT_EQ(stats.reclaimed, 1);
+
+	// the space is reused by the next string of the same size
+	auto again = pool.InternReclaimable("DEAD", 4);
+	EXPECT_EQ(again.Get(), dead.Get());
+	EXPECT_EQ(pool.Stats().table_size, 4);
+}
+
+TEST(StringPool, ReclaimRecentlyUsed)
+{
+	StringPool pool;
+	auto ref = pool.InternReclaimable("recent", 6);
+	pool.Reclaim({});
+
+	// interning it again during this epoch keeps it for one more
+	EXPECT_EQ(pool.InternReclaimable("recent", 6), ref);
+	EXPECT_EQ(pool.Reclaim({}), 0);
+	EXPECT_EQ(pool.Reclaim({}), 1);
+	EXPECT_EQ(pool.Stats().table_size, 0);
+}
+
+}  // namespace
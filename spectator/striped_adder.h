@@ -0,0 +1,206 @@
+#pragma once
+
+#include "atomicnumber.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <type_traits>
+
+namespace spectator
+{
+
+namespace detail
+{
+// the most cells a contended adder grows to, a power of two with room for every cpu
+inline auto striped_cells() -> size_t
+{
+	static const size_t cells = []()
+	{
+		size_t n = 2;
+		while (n < std::thread::hardware_concurrency() && n < 64)
+		{
+			n *= 2;
+		}
+		return n;
+	}();
+	return cells;
+}
+
+// threads are spread over the cells in the order they first update a contended adder
+inline auto striped_probe() -> size_t
+{
+	static std::atomic<size_t> next{0};
+	thread_local size_t probe = next.fetch_add(1, std::memory_order_relaxed);
+	return probe;
+}
+
+template <typename T>
+inline auto add_number(std::atomic<T>* n, T delta) -> void
+{
+	if constexpr (std::is_integral_v<T>)
+	{
+		n->fetch_add(delta, std::memory_order_relaxed);
+	}
+	else
+	{
+		add_double(n, delta);
+	}
+}
+}  // namespace detail
+
+// A number many threads add to, that is only read when it is measured. It starts as
+// a single atomic, and when an update loses a race with another thread, it switches
+// to two cells, each on its own cache line, with each thread adding to one of them.
+// Like Java's LongAdder, the cells double when threads keep colliding on them, up to
+// one per cpu, so only meters that stay contended use more than a couple of cache
+// lines. Reading the value adds up all the cells.
+template <typename T>
+class StripedAdder
+{
+   public:
+	StripedAdder() = default;
+	StripedAdder(const StripedAdder&) = delete;
+	StripedAdder(StripedAdder&&) = delete;
+	auto operator=(const StripedAdder&) -> StripedAdder& = delete;
+	auto operator=(StripedAdder&&) -> StripedAdder& = delete;
+
+	~StripedAdder()
+	{
+		auto* cells = cells_.load(std::memory_order_relaxed);
+		if (cells == nullptr)
+		{
+			return;
+		}
+		// the biggest table has every cell
+		for (auto* cell : cells->cells)
+		{
+			delete cell;
+		}
+		while (cells != nullptr)
+		{
+			auto* smaller = cells->smaller;
+			delete cells;
+			cells = smaller;
+		}
+	}
+
+	void Add(T delta) noexcept
+	{
+		auto* cells = cells_.load(std::memory_order_acquire);
+		if (cells == nullptr)
+		{
+			auto current = base_.load(std::memory_order_relaxed);
+			if (base_.compare_exchange_strong(current, current + delta, std::memory_order_relaxed))
+			{
+				return;
+			}
+			cells = create_cells();
+		}
+		auto size = cells->cells.size();
+		auto& value = cells->cells[detail::striped_probe() & (size - 1)]->value;
+		auto current = value.load(std::memory_order_relaxed);
+		if (value.compare_exchange_strong(current, current + delta, std::memory_order_relaxed))
+		{
+			return;
+		}
+		// another thread is adding to the same cell
+		detail::add_number(&value, delta);
+		if (size < detail::striped_cells() && collisions_.fetch_add(1, std::memory_order_relaxed) + 1 >= size)
+		{
+			collisions_.store(0, std::memory_order_relaxed);
+			grow(cells);
+		}
+	}
+
+	[[nodiscard]] auto Sum() const noexcept -> T
+	{
+		auto sum = base_.load(std::memory_order_relaxed);
+		const auto* cells = cells_.load(std::memory_order_acquire);
+		if (cells != nullptr)
+		{
+			for (const auto* cell : cells->cells)
+			{
+				sum += cell->value.load(std::memory_order_relaxed);
+			}
+		}
+		return sum;
+	}
+
+	// the value so far, starting again from zero
+	auto SumThenReset() noexcept -> T
+	{
+		auto sum = base_.exchange(T{}, std::memory_order_relaxed);
+		auto* cells = cells_.load(std::memory_order_acquire);
+		if (cells != nullptr)
+		{
+			for (auto* cell : cells->cells)
+			{
+				sum += cell->value.exchange(T{}, std::memory_order_relaxed);
+			}
+		}
+		return sum;
+	}
+
+	// number of cells in use, 0 until the adder is contended
+	[[nodiscard]] auto NumCells() const noexcept -> size_t
+	{
+		const auto* cells = cells_.load(std::memory_order_acquire);
+		return cells == nullptr ? 0 : cells->cells.size();
+	}
+
+   private:
+	struct alignas(64) Cell
+	{
+		std::atomic<T> value{};
+	};
+
+	// A bigger table keeps the cells of the one it replaced, and adds new ones. Threads
+	// could still be adding through the smaller tables, so they are kept until the end
+	struct Cells
+	{
+		Cells* smaller;
+		std::vector<Cell*> cells;
+	};
+
+	std::atomic<T> base_{};
+	std::atomic<Cells*> cells_{nullptr};
+	std::atomic<size_t> collisions_{0};
+
+	auto create_cells() noexcept -> Cells*
+	{
+		auto* cells = new Cells{nullptr, {new Cell, new Cell}};
+		Cells* expected = nullptr;
+		if (!cells_.compare_exchange_strong(expected, cells, std::memory_order_acq_rel))
+		{
+			// another thread created them first
+			delete cells->cells[0];
+			delete cells->cells[1];
+			delete cells;
+			return expected;
+		}
+		return cells;
+	}
+
+	void grow(Cells* current) noexcept
+	{
+		auto size = current->cells.size();
+		auto* bigger = new Cells{current, current->cells};
+		bigger->cells.reserve(size * 2);
+		for (size_t i = 0; i < size; ++i)
+		{
+			bigger->cells.push_back(new Cell);
+		}
+		if (!cells_.compare_exchange_strong(current, bigger, std::memory_order_acq_rel))
+		{
+			// another thread grew them first
+			for (size_t i = size; i < bigger->cells.size(); ++i)
+			{
+				delete bigger->cells[i];
+			}
+			delete bigger;
+		}
+	}
+};
+
+}  // namespace spectator
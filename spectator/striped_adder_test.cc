@@ -0,0 +1,61 @@
+#include "striped_adder.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using spectator::StripedAdder;
+
+TEST(StripedAdder, Add)
+{
+	StripedAdder<double> adder;
+	EXPECT_DOUBLE_EQ(adder.Sum(), 0.0);
+	adder.Add(1.5);
+	adder.Add(2.0);
+	EXPECT_DOUBLE_EQ(adder.Sum(), 3.5);
+	EXPECT_DOUBLE_EQ(adder.SumThenReset(), 3.5);
+	EXPECT_DOUBLE_EQ(adder.Sum(), 0.0);
+	// never contended, so it never allocated any cells
+	EXPECT_EQ(adder.NumCells(), 0);
+}
+
+TEST(StripedAdder, Threads)
+{
+	constexpr auto kThreads = 8;
+	constexpr auto kAdds = 100000;
+	StripedAdder<int64_t> adder;
+	int64_t measured = 0;
+	std::atomic_int running{kThreads};
+	std::vector<std::thread> threads;
+	for (auto i = 0; i < kThreads; ++i)
+	{
+		threads.emplace_back(
+		    [&adder, &running]()
+		    {
+			    for (auto j = 0; j < kAdds; ++j)
+			    {
+				    adder.Add(1);
+			    }
+			    --running;
+		    });
+	}
+	// resetting while the threads add does not lose or repeat any of the values
+	while (running > 0)
+	{
+		measured += adder.SumThenReset();
+	}
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+	measured += adder.SumThenReset();
+	EXPECT_EQ(measured, kThreads * kAdds);
+	// the cells only grow with contention, and never past one per cpu
+	auto cells = adder.NumCells();
+	EXPECT_LE(cells, spectator::detail::striped_cells());
+	EXPECT_EQ(cells & (cells - 1), 0) << cells;
+}
+
+}  // namespace
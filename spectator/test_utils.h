@@ -57,9 +57,15 @@ inline auto my_mono_counters(const spectator::Registry& registry) -> std::vector
 	return filter_my_meters(registry.MonotonicCounters());
 }
 
+inline auto my_percentile_histograms(const spectator::Registry& registry)
+    -> std::vector<const spectator::PercentileHistogram*>
+{
+	return filter_my_meters(registry.PercentileHistograms());
+}
+
 inline auto my_meters_size(const spectator::Registry& registry) -> size_t
 {
 	return my_timers(registry).size() + my_counters(registry).size() + my_gauges(registry).size() +
 	       my_age_gauges(registry).size() + my_max_gauges(registry).size() + my_ds(registry).size() +
-	       my_mono_counters(registry).size();
+	       my_mono_counters(registry).size() + my_percentile_histograms(registry).size();
 }
@@ -5,11 +5,12 @@
 namespace spectator
 {
 
-Timer::Timer(Id id) noexcept : Meter(std::move(id)), count_(0), total_(0), totalSq_(0.0), max_(0) {}
+Timer::Timer(Id id) noexcept : Meter(std::move(id)), max_(0) {}
 
-void Timer::Measure(Measurements* results) const noexcept
+template <typename Results>
+void Timer::Measure(Results* results) const noexcept
 {
-	auto cnt = count_.exchange(0, std::memory_order_relaxed);
+	auto cnt = count_.SumThenReset();
 	if (cnt == 0)
 	{
 		return;
@@ -20,9 +21,9 @@ void Timer::Measure(Measurements* results) const noexcept
 		st = std::make_unique<DistStats>(MeterId(), refs().totalTime());
 	}
 
-	auto total = total_.exchange(0, std::memory_order_relaxed);
+	auto total = total_.SumThenReset();
 	auto total_secs = total / 1e9;
-	auto t_sq = totalSq_.exchange(0.0, std::memory_order_relaxed);
+	auto t_sq = totalSq_.SumThenReset();
 	auto t_sq_secs = t_sq / 1e18;
 	auto mx = max_.exchange(0, std::memory_order_relaxed);
 	auto mx_secs = mx / 1e9;
@@ -32,23 +33,47 @@ void Timer::Measure(Measurements* results) const noexcept
 	results->emplace_back(st->max, mx_secs);
 }
 
-void Timer::Record(absl::Duration amount) noexcept
+void Timer::Record(absl::Duration amount) noexcept { Record(amount, 1); }
+
+void Timer::Record(absl::Duration amount, int64_t count) noexcept
 {
 	Update();
 	int64_t ns = amount / absl::Nanoseconds(1);
-	if (ns >= 0)
+	if (ns >= 0 && count > 0)
 	{
-		count_.fetch_add(1, std::memory_order_relaxed);
-		total_.fetch_add(ns, std::memory_order_relaxed);
-		add_double(&totalSq_, static_cast<double>(ns) * ns);
+		count_.Add(count);
+		total_.Add(ns * count);
+		totalSq_.Add(static_cast<double>(ns) * ns * count);
 		update_max(&max_, ns);
+		MarkDirty();
 	}
 }
 
-void Timer::Record(std::chrono::nanoseconds amount) noexcept { Record(absl::FromChrono(amount)); }
+void Timer::RecordTotals(int64_t count, int64_t total, double total_sq, int64_t max) noexcept
+{
+	Update();
+	if (count > 0)
+	{
+		count_.Add(count);
+		total_.Add(total);
+		totalSq_.Add(total_sq);
+		update_max(&max_, max);
+		MarkDirty();
+	}
+}
+
+void Timer::Record(std::chrono::nanoseconds amount) noexcept { Record(absl::FromChrono(amount), 1); }
+
+void Timer::Record(std::chrono::nanoseconds amount, int64_t count) noexcept
+{
+	Record(absl::FromChrono(amount), count);
+}
+
+auto Timer::Count() const noexcept -> int64_t { return count_.Sum(); }
 
-auto Timer::Count() const noexcept -> int64_t { return count_.load(std::memory_order_relaxed); }
+auto Timer::TotalTime() const noexcept -> int64_t { return total_.Sum(); }
 
-auto Timer::TotalTime() const noexcept -> int64_t { return total_.load(std::memory_order_relaxed); }
+template void Timer::Measure(Measurements* results) const noexcept;
+template void Timer::Measure(MeasurementColumns* results) const noexcept;
 
 }  // namespace spectator
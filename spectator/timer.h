@@ -2,6 +2,7 @@
 #include "absl/time/time.h"
 #include "dist_stats.h"
 #include "meter.h"
+#include "striped_adder.h"
 #include <atomic>
 #include <chrono>
 
@@ -12,18 +13,25 @@ class Timer : public Meter
 {
    public:
 	explicit Timer(Id id) noexcept;
-	void Measure(Measurements* result) const noexcept;
+	template <typename Results>
+	void Measure(Results* result) const noexcept;
 
 	void Record(std::chrono::nanoseconds amount) noexcept;
 	void Record(absl::Duration amount) noexcept;
+	// record the same amount count times, for sampled values
+	void Record(std::chrono::nanoseconds amount, int64_t count) noexcept;
+	void Record(absl::Duration amount, int64_t count) noexcept;
+	// record count values that were added up beforehand, totaling total nanoseconds,
+	// with the given sum of squares and max. Nothing is recorded when count <= 0
+	void RecordTotals(int64_t count, int64_t total, double total_sq, int64_t max) noexcept;
 	auto Count() const noexcept -> int64_t;
 	auto TotalTime() const noexcept -> int64_t;
 
    private:
 	mutable std::unique_ptr<DistStats> st;
-	mutable std::atomic<int64_t> count_;
-	mutable std::atomic<int64_t> total_;
-	mutable std::atomic<double> totalSq_;
+	mutable StripedAdder<int64_t> count_;
+	mutable StripedAdder<int64_t> total_;
+	mutable StripedAdder<double> totalSq_;
 	mutable std::atomic<int64_t> max_;
 };
 
@@ -73,6 +73,16 @@ TEST(Timer, Measure)
 	expect_timer(t, 2, 300, 100 * 100 + 200 * 200, 200);
 }
 
+TEST(Timer, RecordWeighted)
+{
+	auto t = getTimer();
+	t.Record(std::chrono::nanoseconds(100), 10);
+	t.Record(std::chrono::nanoseconds(200), 1);
+	t.Record(std::chrono::nanoseconds(300), 0);
+	t.Record(std::chrono::nanoseconds(-1), 10);
+	expect_timer(t, 11, 1200, 100 * 100 * 10 + 200 * 200, 200);
+}
+
 TEST(Timer, Updated)
 {
 	auto timer = getTimer();
@@ -82,7 +92,7 @@ TEST(Timer, Updated)
 	auto t2 = timer.Updated();
 	EXPECT_EQ(t1, t2);
 
-	usleep(1);
+	usleep(20000);  // 20ms, longer than a tick of the coarse clock
 	timer.Record(std::chrono::nanoseconds(1));
 	EXPECT_TRUE(timer.Updated() > t1);
 }